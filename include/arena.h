@@ -0,0 +1,158 @@
+// include/arena.h
+#pragma once
+#include <memory>
+#include <memory_resource>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// ---------------------------------------------------------------------------
+// Линейная арена: выделение — сдвиг указателя, освобождения по одному нет.
+// Reset() возвращает всю память разом и оставляет блоки для следующего задания,
+// так что после прогрева арена не обращается к куче. Не потокобезопасна:
+// заводится на поток (например, на рабочий поток Unzip) и сбрасывается на каждой записи.
+// ---------------------------------------------------------------------------
+class BumpArena : public std::pmr::memory_resource {
+public:
+    explicit BumpArena(size_t blockSize = 16 * 1024);
+    ~BumpArena() override = default;
+
+    BumpArena(const BumpArena&) = delete;
+    BumpArena& operator=(const BumpArena&) = delete;
+
+    void* Allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+    // Всё выделенное становится недействительным; блоки остаются за ареной
+    void Reset();
+
+    size_t Used() const { return used_; }
+    size_t Capacity() const;
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override { return Allocate(bytes, align); }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+    };
+    size_t blockSize_;
+    std::vector<Block> blocks_;
+    size_t current_ = 0;          // индекс блока, из которого выделяем
+    size_t offset_ = 0;           // занято в текущем блоке
+    size_t used_ = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Пул буферов фиксированного размера (например, 64 КБ под чтение из zip).
+// Acquire берёт свободный буфер или выделяет новый; буфер возвращается в пул
+// деструктором PooledBuffer. Сверх maxRetained буферы освобождаются.
+// ---------------------------------------------------------------------------
+class BufferPool;
+
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    PooledBuffer(BufferPool* pool, std::unique_ptr<char[]> data, size_t size)
+        : pool_(pool), data_(std::move(data)), size_(size) {}
+    PooledBuffer(PooledBuffer&& other) noexcept = default;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    ~PooledBuffer();
+
+    char* Data() const { return data_.get(); }
+    size_t Size() const { return size_; }
+
+private:
+    BufferPool* pool_ = nullptr;
+    std::unique_ptr<char[]> data_;
+    size_t size_ = 0;
+};
+
+class BufferPool {
+public:
+    BufferPool(size_t bufferSize, size_t maxRetained);
+
+    PooledBuffer Acquire();
+
+    // Общий пул 64 КБ-буферов для потоковых чтения/записи
+    static BufferPool& Shared64K();
+
+private:
+    friend class PooledBuffer;
+    void Release(std::unique_ptr<char[]> data);
+
+    const size_t bufferSize_;
+    const size_t maxRetained_;
+    std::mutex mtx_;
+    std::vector<std::unique_ptr<char[]>> free_;
+};
+
+// ---------------------------------------------------------------------------
+// Счётчики аллокаций по подсистемам. Включаются сборкой с X360_COUNT_ALLOCS:
+// тогда глобальный operator new считает выделения в потоке, а AllocScope
+// относит их к подсистеме. Unit() отмечает обработанную единицу (файл, строку лога,
+// ключ локали), поэтому Allocations/Units — аллокаций на единицу.
+// Без флага AllocScope пустой и ничего не стоит.
+// ---------------------------------------------------------------------------
+enum class AllocSite { Unzip, Logger, Locale, Count };
+
+struct AllocSiteStats {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t units = 0;
+};
+
+class AllocStats {
+public:
+    static constexpr bool Enabled() {
+#if defined(X360_COUNT_ALLOCS)
+        return true;
+#else
+        return false;
+#endif
+    }
+    static const char* SiteName(AllocSite site);
+    static AllocSiteStats Get(AllocSite site);
+    static void Reset();
+
+    // Выделения текущего потока с начала его жизни (0 без X360_COUNT_ALLOCS)
+    static uint64_t ThreadAllocations();
+    static uint64_t ThreadBytes();
+
+    static void Add(AllocSite site, uint64_t allocations, uint64_t bytes, uint64_t units);
+};
+
+#if defined(X360_COUNT_ALLOCS)
+class AllocScope {
+public:
+    explicit AllocScope(AllocSite site)
+        : site_(site),
+          allocs_(AllocStats::ThreadAllocations()),
+          bytes_(AllocStats::ThreadBytes()) {}
+    ~AllocScope() {
+        AllocStats::Add(site_, AllocStats::ThreadAllocations() - allocs_,
+                        AllocStats::ThreadBytes() - bytes_, units_);
+    }
+    void Unit(uint64_t n = 1) { units_ += n; }
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    AllocSite site_;
+    uint64_t allocs_;
+    uint64_t bytes_;
+    uint64_t units_ = 0;
+};
+#else
+class AllocScope {
+public:
+    explicit AllocScope(AllocSite) {}
+    void Unit(uint64_t = 1) {}
+};
+#endif
@@ -0,0 +1,67 @@
+// include/bench.h
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Результат одного бенчмарка
+struct BenchResult {
+    std::string name;             // "unzip.many_small.deflated" и т.п.
+    std::string unit;             // единица throughput: "MB/s" или "ops/s"
+    double medianMs = 0;
+    double minMs = 0;
+    double maxMs = 0;
+    double throughput = 0;        // работа за итерацию / медианное время
+    double allocsPerUnit = -1;    // аллокаций на файл/строку (сборка с X360_COUNT_ALLOCS), иначе -1
+    bool skipped = false;         // кейс недоступен на этой платформе/сборке
+    bool failed = false;          // кейс запускался, но фикстура или замер не удались
+    std::string note;             // причина пропуска или ошибки
+};
+
+// Сравнение с сохранённым базовым прогоном
+struct BenchComparison {
+    std::string name;
+    double baselineMs = 0;
+    double currentMs = 0;
+    double deltaPct = 0;          // (current - baseline) / baseline * 100
+    bool regression = false;      // deltaPct выше порога или кейс упал
+    bool failed = false;          // кейс упал в текущем прогоне: сравнивать нечего
+};
+
+struct BenchConfig {
+    std::wstring workDir;         // родитель каталога прогона: внутри создаётся уникальный
+                                  // подкаталог и удаляется после Run
+    int repeats = 5;              // замеров на кейс; в отчёт идёт медиана
+    std::string filter;           // подстрока имени; пусто — все кейсы
+};
+
+// Набор бенчмарков горячих путей: распаковка (много мелких / несколько крупных файлов,
+// stored и deflate), шторм сообщений в логгер, поиск в локали, упаковка ELF.
+// Фикстуры генерируются детерминированно (фиксированный seed), поэтому прогоны
+// на одной машине сравнимы между собой.
+class BenchSuite {
+public:
+    explicit BenchSuite(const BenchConfig& config);
+
+    // Генерирует фикстуры и прогоняет кейсы. false — не удалось подготовить workDir.
+    bool Run();
+
+    const std::vector<BenchResult>& Results() const { return results_; }
+
+    // JSON: {"version":1,"repeats":N,"results":[{...}]}
+    bool WriteJson(const std::wstring& path) const;
+
+    // Сравнивает результаты с baseline-файлом того же формата. Упавший кейс всегда
+    // попадает в out как регрессия. Пропущенные кейсы и кейсы, которых нет в baseline
+    // (или которые в нём пропущены/упали), не сравниваются. false — baseline не читается.
+    static bool Compare(const std::wstring& baselinePath,
+                        const std::vector<BenchResult>& current,
+                        double thresholdPct,
+                        std::vector<BenchComparison>& out);
+
+private:
+    bool Selected(const std::string& name) const;
+
+    BenchConfig config_;
+    std::vector<BenchResult> results_;
+};
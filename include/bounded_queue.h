@@ -0,0 +1,77 @@
+// include/bounded_queue.h
+#pragma once
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+// Ограниченная блокирующая очередь между стадиями конвейера.
+// Push ждёт, пока освободится место (back-pressure), Pop — пока появится элемент.
+// После Close новые элементы не принимаются, а Pop дочитывает остаток и возвращает false.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    // Возвращает false, если очередь закрыта
+    bool Push(T item) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        notFull_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        if (items_.size() > maxDepth_) maxDepth_ = items_.size();
+        lock.unlock();
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // Возвращает false, если очередь закрыта и пуста
+    bool Pop(T& out) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        notEmpty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        out = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // Закрывает очередь: будит всех ждущих
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+    // Закрывает и выбрасывает остаток (при отмене)
+    void Abort() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            closed_ = true;
+            items_.clear();
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+    size_t MaxDepth() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return maxDepth_;
+    }
+
+private:
+    const size_t capacity_;
+    mutable std::mutex mtx_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<T> items_;
+    size_t maxDepth_ = 0;
+    bool closed_ = false;
+};
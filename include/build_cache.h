@@ -0,0 +1,131 @@
+// include/build_cache.h
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+// Описание одного действия сборки (компиляция объекта, линковка ELF)
+struct ActionDesc {
+    std::wstring tool;                       // путь к бинарнику компилятора/линкера
+    std::vector<std::wstring> args;          // флаги в порядке передачи
+    std::vector<std::wstring> inputs;        // исходники/объекты
+    std::vector<std::wstring> extraInputs;   // xex.ld, crt0.S и т.п.
+    std::vector<std::wstring> outputs;       // имена выходов: тот же вход под -o a.o и -o b.o — разные записи
+    std::wstring depFile;                    // -MD depfile, который пишет инструмент: заголовки входят в ключ
+};
+
+// Конфигурация кеша
+struct BuildCacheConfig {
+    std::wstring root;                           // каталог кеша
+    uint64_t maxBytes = 2ull * 1024 * 1024 * 1024;   // предел размера, дальше LRU-вытеснение
+};
+
+// Статистика попаданий
+struct BuildCacheStats {
+    uint64_t hits      = 0;
+    uint64_t misses    = 0;
+    uint64_t stores    = 0;
+    uint64_t evictions = 0;
+    uint64_t bytes     = 0;    // текущий размер кеша
+};
+
+// Локальный кеш выходов действий, адресуемый хешем содержимого входов.
+// Запись: <root>/<2 символа>/<ключ>/<индекс выхода>.
+//
+// Действия с depFile ищутся в два шага, как в direct mode ccache. Ключ манифеста —
+// хеш инструмента, флагов, входов и имён выходов; манифест <root>/manifests/<ключ>
+// хранит списки заголовков из depfile прошлых сборок. Окончательный ключ добавляет
+// содержимое заголовков одного из списков. Так чистому checkout без depfile хватает
+// манифеста, а новый #include даёт новый список и не попадает в старую запись.
+// Порядок работы с таким действием: ComputeKey → Restore; при промахе — сборка и Store(action, ...).
+class BuildCache {
+public:
+    explicit BuildCache(const BuildCacheConfig& config);
+
+    // Создаёт каталог и индексирует уже лежащие в нём записи.
+    // Временные каталоги Store старше часа считаются брошенными и удаляются;
+    // свежие могут принадлежать другому процессу с тем же кешем.
+    bool Open();
+
+    // Ключ = SHA-256 от бинарника инструмента, флагов, путей и содержимого входов,
+    // extraInputs и имён выходов. Для действия с depFile — окончательный ключ первого списка
+    // заголовков из манифеста, чья запись есть в кеше; если такого нет (первая сборка,
+    // изменился заголовок), outKey — ключ манифеста, и Restore промахнётся.
+    // Возвращает false, если не читается инструмент или вход.
+    bool ComputeKey(const ActionDesc& action, std::string& outKey);
+
+    // При попадании восстанавливает outputs (reflink → hardlink → копия) и возвращает true
+    bool Restore(const std::string& key, const std::vector<std::wstring>& outputs);
+
+    // Сохраняет свежесобранные outputs под ключом, затем подрезает кеш до maxBytes
+    bool Store(const std::string& key, const std::vector<std::wstring>& outputs);
+
+    // Store после промаха. Для действия с depFile читает depfile, который только что записал
+    // инструмент, добавляет его список заголовков в манифест и сохраняет outputs под
+    // окончательным ключом этого списка. outKey (если задан) получает этот ключ.
+    bool Store(const ActionDesc& action, const std::vector<std::wstring>& outputs,
+               std::string* outKey = nullptr);
+
+    // Удаляет старые выходы перед запуском инструмента при промахе:
+    // восстановленные файлы — жёсткие ссылки на записи кеша, их нельзя перезаписывать на месте.
+    static void RemoveOutputs(const std::vector<std::wstring>& outputs);
+
+    // Кладёт файл from в to: reflink → hardlink → копия. Общая с SdkStore.
+    static bool Materialize(const std::wstring& from, const std::wstring& to);
+
+    // Как Materialize, но без жёсткой ссылки: to никогда не делит инод с from,
+    // и запись в to (или chmod) не портит источник. Для песочниц и деревьев, куда пишут чужие процессы.
+    static bool CloneFile(const std::wstring& from, const std::wstring& to);
+
+    // Уникальное в пределах машины имя для временных файлов каталога, общего для
+    // нескольких процессов: случайная метка процесса, поток и счётчик. Общее с SdkStore.
+    static std::string TempSuffix();
+
+    // Вытесняет давно использованные записи, пока размер > maxBytes
+    void Trim();
+
+    BuildCacheStats Stats() const;
+
+private:
+    struct Entry {
+        uint64_t size = 0;
+        uint64_t lastUse = 0;      // логические часы: больше — свежее
+    };
+
+    // Хеш файла с мемоизацией по (путь, размер, mtime), чтобы не перечитывать компилятор
+    bool HashFileCached(const std::wstring& path, std::string& outHex);
+    // Зависимости из make-правила depfile (первая цель пропускается)
+    static bool ReadDepFile(const std::wstring& path, std::vector<std::wstring>& deps);
+    // Хеш действия без заголовков: ключ манифеста (или окончательный без depFile)
+    bool ManifestKey(const ActionDesc& action, std::string& outKey);
+    // Окончательный ключ: ключ манифеста + пути и содержимое заголовков (deps отсортированы)
+    bool FinalKey(const std::string& manifestKey, const std::vector<std::wstring>& deps, std::string& outKey);
+    bool ReadManifest(const std::string& manifestKey, std::vector<std::vector<std::wstring>>& lists);
+    bool AddToManifest(const std::string& manifestKey, const std::vector<std::wstring>& deps);
+    std::wstring EntryDir(const std::string& key) const;
+    std::wstring ManifestPath(const std::string& key) const;
+    void TrimLocked();
+
+    BuildCacheConfig config_;
+    mutable std::mutex mtx_;
+    std::unordered_map<std::string, Entry> index_;
+    uint64_t clock_ = 0;
+    uint64_t totalBytes_ = 0;
+
+    struct FileStamp {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        std::string hash;
+    };
+    std::mutex manifestMtx_;    // чтение-изменение-запись манифеста внутри процесса
+    std::mutex hashMtx_;
+    std::unordered_map<std::wstring, FileStamp> hashMemo_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> stores_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
@@ -0,0 +1,116 @@
+// include/build_daemon.h
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <stop_token>
+
+// Запрос на сборку от тонкого клиента
+struct DaemonRequest {
+    bool online = false;          // true → input это URL, false → путь к исходникам
+    std::wstring input;
+    bool force = false;           // собрать даже если дерево не менялось
+};
+
+// Колбэк, выполняющий собственно сборку (обычно CoreBuilder::Start*Build).
+// log вызывается для каждой строки лога, уходящей клиенту.
+using DaemonBuildFn = std::function<bool(const DaemonRequest& request,
+                                         const std::function<void(const std::wstring&)>& log)>;
+
+// Конфигурация демона
+struct BuildDaemonConfig {
+    std::string socketPath;       // путь Unix domain socket
+    DaemonBuildFn build;          // исполнитель сборки
+};
+
+// Долгоживущий сервер сборки: держит тёплое состояние между запросами.
+// Для офлайн-целей дерево исходников отслеживается через inotify, и если с последней
+// успешной сборки в нём ничего не менялось, запрос отвечается сразу без запуска сборки.
+// Запрос к цели, которая сейчас собирается, присоединяется к этой сборке и получает её
+// результат, если дерево не менялось после её старта; иначе ждёт её и собирает заново.
+//
+// Сокет создаётся с правами 0600, а клиент с чужим uid (SO_PEERCRED) отклоняется:
+// сборку и SHUTDOWN может прислать только владелец демона.
+//
+// Протокол (строки UTF-8, по одной команде на соединение):
+//   BUILD <online|offline> [force] <input>\n  → LOG <строка>\n ... затем OK <мс> [up-to-date]\n или FAIL <мс>\n
+//   STATUS\n                                  → TARGETS <n> WATCHES <n>\n
+//   SHUTDOWN\n                                → BYE\n
+//
+// Работает только на Linux (inotify + AF_UNIX); на других платформах Start возвращает false.
+class BuildDaemon {
+public:
+    explicit BuildDaemon(const BuildDaemonConfig& config);
+    ~BuildDaemon();
+
+    // Открывает сокет и запускает потоки приёма и слежения. false при ошибке.
+    bool Start();
+
+    // Блокирует до команды SHUTDOWN, Stop() или запроса остановки stop
+    void Wait(std::stop_token stop = {});
+
+    // Останавливает потоки и удаляет файл сокета
+    void Stop();
+
+private:
+    // Идущая сборка цели: к ней присоединяются запросы, пришедшие во время неё
+    struct RunningBuild {
+        uint64_t changesAtStart = 0;      // Target::changes на момент старта
+        bool done = false;
+        bool ok = false;
+    };
+
+    struct Target {
+        bool dirty = true;                // менялось ли дерево после последней успешной сборки
+        bool watched = true;              // false, если на часть дерева не хватило inotify-watch
+        uint64_t changes = 0;             // счётчик событий inotify по дереву
+        std::shared_ptr<RunningBuild> running;   // непусто, пока сборка цели идёт
+    };
+
+    void AcceptThread();
+    void WatchThread();
+    void HandleClient(int fd);
+    bool RunBuild(int fd, const DaemonRequest& request);
+    void WatchTree(const std::wstring& key, const std::string& root);
+    void AddWatch(const std::wstring& key, const std::string& dir);
+    void MarkDirty(int wd, bool all);
+    void DrainEvents();                   // разбирает очередь inotify; под stateMtx_
+    void RequestStop();
+
+    BuildDaemonConfig config_;
+    int listenFd_ = -1;
+    int inotifyFd_ = -1;
+    std::thread acceptThread_;
+    std::thread watchThread_;
+    std::atomic<bool> running_{false};
+    struct Client {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+        int fd = -1;                      // закрывается после join потока
+    };
+    std::mutex clientsMtx_;
+    std::vector<Client> clients_;
+
+    std::mutex stateMtx_;
+    std::condition_variable stateCv_;                     // завершение RunningBuild; под stateMtx_
+    std::map<std::wstring, Target> targets_;              // ключ — канонический путь исходников
+    std::unordered_map<int, std::wstring> watchOwner_;    // wd → ключ цели
+    std::unordered_map<int, std::string> watchDir_;       // wd → каталог
+
+    std::mutex buildMtx_;                                 // сборки выполняются по одной
+    std::mutex waitMtx_;
+    std::condition_variable waitCv_;
+};
+
+// Тонкий клиент: отправляет запрос демону и печатает лог через onLine.
+// Возвращает 0 при успехе, 1 при провале сборки, 2 если демон недоступен.
+int DaemonSubmit(const std::string& socketPath,
+                 const DaemonRequest& request,
+                 const std::function<void(const std::wstring&)>& onLine);
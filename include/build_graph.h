@@ -0,0 +1,136 @@
+// include/build_graph.h
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stop_token>
+#include <cstddef>
+#include <cstdint>
+#include "resource_governor.h"
+
+// Стадии сборки, которые моделируются узлами графа
+enum class BuildStage { Download, Extract, Compile, Link, Pack };
+
+using NodeId = size_t;
+
+// Узел графа: одно действие сборки и его зависимости
+struct BuildNode {
+    std::wstring name;
+    BuildStage stage = BuildStage::Compile;
+    uint64_t cost = 1;                  // оценка стоимости действия (условные единицы)
+    std::function<bool()> action;       // возвращает true при успехе
+    std::vector<NodeId> deps;           // узлы, которые должны завершиться раньше
+    std::vector<NodeId> dependents;     // обратные рёбра (заполняются AddDependency)
+    uint64_t priority = 0;              // длина критического пути до стока (считает Finalize)
+    ResourceRequest resources;          // резервация памяти/полосы на время действия
+};
+
+// Ациклический граф действий: download → extract → compile → link (xex.ld) → pack
+class BuildGraph {
+public:
+    // Добавляет узел, возвращает его идентификатор
+    NodeId AddNode(BuildStage stage,
+                   const std::wstring& name,
+                   std::function<bool()> action,
+                   uint64_t cost = 1);
+
+    // node начнётся только после успешного завершения dependsOn.
+    // Возвращает false при неверных id или петле на себя.
+    bool AddDependency(NodeId node, NodeId dependsOn);
+
+    // Сколько памяти и полосы ввода-вывода держит действие узла (см. SchedulerConfig::governor).
+    // Возвращает false при неверном id.
+    bool SetResources(NodeId node, const ResourceRequest& resources);
+
+    // Проверяет ацикличность и считает приоритеты по критическому пути.
+    // Возвращает false, если в графе есть цикл.
+    bool Finalize();
+
+    size_t Size() const { return nodes_.size(); }
+    const BuildNode& Node(NodeId id) const { return nodes_[id]; }
+
+private:
+    std::vector<BuildNode> nodes_;
+};
+
+// Конфигурация планировщика
+struct SchedulerConfig {
+    int maxJobs    = 0;       // аналог -j; 0 → std::thread::hardware_concurrency()
+    bool keepGoing = false;   // аналог -k: продолжать независимые узлы после ошибки
+    // Допуск узлов по BuildNode::resources; nullptr — только maxJobs. Воркер берёт из деки
+    // только узел, чья резервация влезает сейчас (TryAcquire), остальные остаются на месте
+    // и ждут освобождения чужой резервации — воркер при этом не блокируется в Acquire.
+    ResourceGovernor* governor = nullptr;
+};
+
+// Итог выполнения графа
+struct SchedulerStats {
+    size_t completed = 0;     // успешно выполненные узлы
+    size_t failed    = 0;     // узлы, чьё действие вернуло false
+    size_t skipped   = 0;     // не запускались (ошибка зависимости или отмена)
+    size_t steals    = 0;     // сколько раз воркер забирал работу у соседа
+};
+
+// Планировщик с work-stealing пулом: каждый воркер держит свою деку готовых узлов,
+// берёт работу с хвоста своей деки и ворует с головы чужих.
+// Готовые узлы кладутся в порядке приоритета, так что первым идёт критический путь.
+class BuildScheduler {
+public:
+    explicit BuildScheduler(const SchedulerConfig& config);
+
+    // Выполняет граф (Finalize должен быть вызван заранее).
+    // Блокирует до завершения. Возвращает true, если все узлы выполнены успешно.
+    // Запрос остановки через stop действует как Cancel.
+    bool Run(const BuildGraph& graph, std::stop_token stop = {});
+
+    // Просит остановиться: запущенные действия дорабатывают, новые не стартуют.
+    // Действует на текущий Run (каждый Run начинается со сброшенным флагом).
+    void Cancel();
+
+    SchedulerStats Stats() const { return stats_; }
+
+private:
+    enum class NodeState : int { Pending, Ready, Running, Done, Failed, Skipped };
+
+    struct WorkerQueue {
+        std::mutex mtx;
+        std::deque<NodeId> items;
+    };
+
+    void WorkerThread(size_t self);
+    bool PopLocal(size_t self, NodeId& out, ResourceLease& lease);
+    bool Steal(size_t self, NodeId& out, ResourceLease& lease);
+    bool Admit(NodeId id, ResourceLease& lease);
+    void PushReady(size_t self, std::vector<NodeId>& ready);
+    void Execute(size_t self, NodeId id, ResourceLease lease);
+    void SkipDependents(NodeId id);
+    void FinishNode();
+    bool Finished() const;
+    void WakeWorkers(bool all);
+
+    SchedulerConfig config_;
+    const BuildGraph* graph_ = nullptr;
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::unique_ptr<std::atomic<int>[]> state_;
+    std::unique_ptr<std::atomic<size_t>[]> depsLeft_;
+    std::unique_ptr<std::chrono::steady_clock::time_point[]> readyAt_;   // пишется и читается под мьютексом деки
+
+    std::atomic<size_t> remaining_{0};    // узлы, ещё не пришедшие в конечное состояние
+    std::atomic<size_t> queued_{0};       // узлы, лежащие в деках
+    std::atomic<size_t> running_{0};      // узлы, выполняющиеся прямо сейчас
+    std::atomic<size_t> completed_{0};
+    std::atomic<size_t> failed_{0};
+    std::atomic<size_t> steals_{0};
+    std::atomic<uint64_t> admissionEpoch_{0};   // растёт, когда допуск мог стать возможным
+    std::atomic<bool> stop_{false};
+
+    std::mutex waitMtx_;
+    std::condition_variable cv_;
+    SchedulerStats stats_;
+};
@@ -0,0 +1,32 @@
+// include/cli.h
+#pragma once
+#include <string>
+#include <vector>
+
+// Коды выхода CLI
+enum CliExitCode {
+    CLI_OK               = 0,   // все цели собраны
+    CLI_BUILD_FAIL       = 1,   // хотя бы одна цель не собралась
+    CLI_USAGE            = 2,   // неверные аргументы
+    CLI_INIT_FAIL        = 3,   // не удалось создать логгер/сборщик
+    CLI_BENCH_REGRESSION = 4,   // --bench: медиана хуже baseline больше порога или кейс упал
+    CLI_CANCELLED        = 130  // прервано по Ctrl+C (как у шелла для SIGINT)
+};
+
+// Запускает сборку без GUI. args — аргументы без имени программы:
+//   [--online|--offline] [-j N] [--ndjson] [--log FILE] [--trace FILE] [--metrics FILE]
+//   [--hot-list FILE [--hot-symbols FILE] [--hot-out FILE]] <target>...
+// С одним --hot-list цели можно не указывать: только генерируется порядок функций.
+//   --bench OUT.json [--baseline FILE] [--threshold PCT] [--bench-repeats N] [--bench-filter TEXT]
+// прогоняет бенчмарки горячих путей вместо сборки (см. bench.h).
+//   --worker PORT --worker-tool NAME... [--worker-bind ADDR] [--worker-root DIR] [--worker-slots N]
+// запускает воркер удалённого исполнения (см. remote_exec.h); секрет hello берётся
+// из переменной окружения X360MAKE_REMOTE_SECRET.
+//   --sdk-store DIR [--sdk-import VERSION ZIP|DIR] [--sdk-use VERSION DIR] [--sdk-gc]
+// импортирует, переключает и чистит версии SDK в хранилище (см. sdk_store.h).
+//   --daemon SOCKET [--log FILE]
+// держит тёплое состояние сборки и обслуживает запросы на Unix-сокете (см. build_daemon.h);
+//   --submit SOCKET [--force] [--ndjson] [--online|--offline] <target>...
+// отправляет цели такому демону.
+// Возвращает код из CliExitCode.
+int RunCLI(const std::vector<std::wstring>& args);
@@ -2,6 +2,7 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <stop_token>
 
 // Интерфейс загрузчика
 class IDownloader {
@@ -9,11 +10,15 @@ public:
     virtual ~IDownloader() = default;
 
     // Загружает URL → outPath с resume, проверкой HTTPS и подписи.
+    // stop проверяется в цикле приёма (на каждом прочитанном блоке) и между повторами;
+    // при отмене недокачанный файл удаляется. Токен передаётся на вызов, поэтому один
+    // загрузчик можно звать из нескольких сборок с разными токенами.
     // Возвращает true при успехе, false иначе.
     virtual bool Download(const std::wstring& url,
                           const std::wstring& outPath,
                           int maxRetries = 3,
-                          int backoffSeconds = 2) = 0;
+                          int backoffSeconds = 2,
+                          std::stop_token stop = {}) = 0;
 };
 
 // WinHTTP-загрузчик
@@ -22,7 +27,8 @@ public:
     bool Download(const std::wstring& url,
                   const std::wstring& outPath,
                   int maxRetries = 3,
-                  int backoffSeconds = 2) override;
+                  int backoffSeconds = 2,
+                  std::stop_token stop = {}) override;
 
 private:
     static uint64_t GetFileSize(const std::wstring& path);
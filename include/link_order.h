@@ -0,0 +1,65 @@
+// include/link_order.h
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// Горячая функция из профиля: имя символа (как в .text.<имя> при -ffunction-sections) и вес
+struct HotFunction {
+    std::string name;
+    uint64_t weight = 0;
+};
+
+// Символ кода из вывода `nm -S --defined-only` (адрес, размер, тип, имя)
+struct CodeSymbol {
+    uint64_t address = 0;
+    uint64_t size = 0;
+};
+
+// Отчёт о локальности горячего набора
+struct LocalityReport {
+    size_t hotFunctions = 0;      // функций в профиле
+    size_t resolved = 0;          // из них найдено в таблице символов
+    uint64_t hotBytes = 0;        // суммарный размер найденных
+    size_t pagesBefore = 0;       // страниц, которые они занимают сейчас
+    size_t pagesAfter = 0;        // страниц после упаковки подряд с границы страницы
+    std::vector<std::string> missing;   // имена из профиля, которых нет в символах
+};
+
+// Профильно-управляемый порядок функций для crt/xex.ld.
+// Читает список горячих функций, генерирует фрагмент линкер-скрипта
+// (включается в .text через INCLUDE hot_text.ld) и считает отчёт о страницах.
+class LinkOrder {
+public:
+    // Профиль: по строке на функцию, '#' — комментарий. Форматы строки:
+    //   "имя"            — вес по порядку (первая строка самая горячая)
+    //   "имя число"      — символ и частота (как в symbol-frequency файлах)
+    //   "число имя"      — вывод `sort | uniq -c` по сэмплам профайлера
+    // Повторы суммируются. Возвращает false, если файл не читается.
+    bool LoadProfile(const std::wstring& path);
+
+    // Таблица символов из `nm -S --defined-only` (берутся только t/T/W).
+    // Нужна только для отчёта; без неё фрагмент генерируется всё равно.
+    bool LoadSymbols(const std::wstring& path);
+
+    // Горячие функции по убыванию веса (при равенстве — в порядке файла)
+    const std::vector<HotFunction>& Hot() const { return hot_; }
+
+    // Текст фрагмента: ALIGN(0x1000), __hot_text_start__ и по одной строке
+    // *(.text.<имя>) на функцию. Имена с символами, недопустимыми в шаблонах ld,
+    // пропускаются; если не осталось ни одного, фрагмент — только комментарий.
+    std::string ScriptFragment() const;
+
+    // Пишет фрагмент в файл (временный файл + rename)
+    bool WriteScript(const std::wstring& outPath) const;
+
+    // Отчёт: страницы горячего набора сейчас и после упаковки.
+    // alignment — выравнивание функций при упаковке (по умолчанию как у PowerPC-кода).
+    LocalityReport Report(uint64_t pageSize = 0x1000, uint64_t alignment = 4) const;
+
+private:
+    std::vector<HotFunction> hot_;
+    std::unordered_map<std::string, CodeSymbol> symbols_;
+};
@@ -22,7 +22,7 @@ protected:
     // Проверяет, что lang_code состоит только из [A-Za-z0-9_-] и длина ≤16
     static bool IsSafeLangCode(const std::string& code);
 
-    // Безопасная конвертация UTF-8 → UTF-16 (MB_ERR_INVALID_CHARS)
+    // Строгая конвертация UTF-8 → wstring без BOM (см. Utf8ToWStringStrict)
     static bool Utf8ToWStringSafe(const std::string& utf8, std::wstring& out);
 
     // Функции, возвращающие ссылки на function-local статические объекты:
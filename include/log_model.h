@@ -0,0 +1,62 @@
+// include/log_model.h
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Платформонезависимая модель лога сборки для GUI/CLI.
+// Хранит последние capacity строк в кольцевом буфере и последний процент прогресса.
+// Каждое изменение увеличивает поколение (Generation). Уведомитель вызывается только
+// при переходе «всё показано» → «есть новое», поэтому между двумя Acknowledge уходит
+// не больше одного сигнала, сколько бы строк ни пришло.
+class LogModel {
+public:
+    explicit LogModel(size_t capacity = 10000);
+
+    // Добавляет строку (потокобезопасно). При переполнении вытесняется самая старая.
+    void Append(std::wstring line);
+
+    // Обновляет прогресс 0–100; промежуточные значения между кадрами схлопываются
+    void SetProgress(int percent);
+
+    // Очищает строки, счётчик TotalAppended и прогресс
+    void Clear();
+
+    // Колбэк «есть что перерисовать» (например, один PostMessage). Вызывается из потока,
+    // изменившего модель; должен быть дешёвым и не обращаться к модели.
+    void SetNotifier(std::function<void()> notify);
+
+    // Представление вызывает перед чтением состояния: следующее изменение снова пошлёт сигнал
+    void Acknowledge();
+
+    uint64_t Generation() const { return generation_.load(std::memory_order_acquire); }
+    int Progress() const { return progress_.load(std::memory_order_acquire); }
+
+    // Сколько строк в буфере сейчас
+    size_t Size() const;
+
+    // Всего строк с последнего Clear (включая вытесненные)
+    uint64_t TotalAppended() const;
+
+    // Строка по индексу от самой старой из хранимых. false, если индекс вне диапазона.
+    bool Line(size_t index, std::wstring& out) const;
+
+private:
+    void Changed();
+
+    const size_t capacity_;
+    mutable std::mutex mtx_;
+    std::vector<std::wstring> ring_;
+    size_t head_ = 0;            // позиция самой старой строки
+    size_t count_ = 0;
+    uint64_t total_ = 0;
+
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<int> progress_{0};
+    std::atomic<bool> pending_{false};   // сигнал послан и ещё не подтверждён
+    std::function<void()> notify_;
+};
@@ -5,7 +5,10 @@
 #include <thread>
 #include <atomic>
 #include <condition_variable>
-#include <queue>
+#include <vector>
+#include <functional>
+#include <fstream>
+#include <ctime>
 #include <cstddef>
 #include <fmt/core.h>
 
@@ -19,6 +22,10 @@ struct LoggerConfig {
     bool consoleOutput      = true;   // выводить ли в консоль
     LogLevel minLevel       = LogLevel::Info;
     size_t maxQueueSize     = 10000;  // ограничение очереди логов
+
+    // Необязательно: получает каждую записанную строку (без метки времени) в потоке записи.
+    // Так CLI пересылает лог сборки в NDJSON, а демон — клиенту.
+    std::function<void(LogLevel level, const std::wstring& message)> sink;
 };
 
 // Асинхронный логгер с ротацией
@@ -27,24 +34,41 @@ public:
     explicit AsyncFileLogger(const LoggerConfig& config);
     ~AsyncFileLogger();
 
-    // Добавить запись (потокобезопасно)
+    // Добавить запись (потокобезопасно). Копия сообщения кладётся в строку из пула
+    // уже записанных, так что после прогрева куча не трогается.
     void Log(LogLevel level, const std::wstring& message);
 
+    // То же, но забирает строку вызывающего без копирования и взамен отдаёт в message
+    // пустую строку из пула: так пул не копит буферы, приходящие этим путём
+    void Log(LogLevel level, std::wstring&& message);
+
     // Закрыть логгер (ждёт завершения потока)
     void Close();
 
 private:
     void WorkerThread();          // основной рабочий поток
     void RotateFileIfNeeded();    // проверка необходимости ротации
-    static std::wstring LevelToString(LogLevel level);
+    void WriteEntry(LogLevel level, const std::wstring& message);
+    void DropIfFull();            // под mtxQueue_: при переполнении очищает очередь
+    void Recycle(std::vector<std::pair<LogLevel, std::wstring>>& batch);
+    void PutSpare(std::wstring&& s);      // под mtxQueue_
+    bool TakeSpare(std::wstring& out);    // под mtxQueue_
+    static const wchar_t* LevelToString(LogLevel level);
     static std::wstring Timestamp();
+    static void FormatTimestamp(std::time_t t, wchar_t (&buf)[64]);
 
     LoggerConfig config_;
-    std::wofstream currentFile_;
+    std::ofstream currentFile_;           // UTF-8 с BOM
     std::atomic<size_t> fileSize_{0};
     std::mutex mtxQueue_;
     std::condition_variable cv_;
-    std::queue<std::pair<LogLevel, std::wstring>> queue_;
+    std::vector<std::pair<LogLevel, std::wstring>> queue_;    // меняется местами с пачкой воркера
+    std::vector<std::wstring> spare_;     // строки записанных сообщений для повторного использования
+    size_t spareBytes_ = 0;               // сколько памяти держит spare_ (под mtxQueue_)
+    std::wstring line_;                   // буфер форматирования строки (только поток воркера)
+    std::string utf8_;                    // line_ в UTF-8 для файла (только поток воркера)
+    std::time_t lastStampTime_ = -1;      // метка времени пересчитывается раз в секунду
+    wchar_t lastStamp_[64] = {};
     std::thread worker_;
     std::atomic<bool> running_{false};
 
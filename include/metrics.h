@@ -0,0 +1,116 @@
+// include/metrics.h
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Монотонный счётчик. Add — одна relaxed-операция, без блокировок.
+class MetricCounter {
+public:
+    void Add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Текущее значение (глубина очереди, занятая память) и его максимум за время жизни
+class MetricGauge {
+public:
+    void Set(int64_t v) {
+        value_.store(v, std::memory_order_relaxed);
+        UpdateMax(v);
+    }
+    void Add(int64_t d) { UpdateMax(value_.fetch_add(d, std::memory_order_relaxed) + d); }
+    int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+    int64_t Max() const { return max_.load(std::memory_order_relaxed); }
+
+private:
+    void UpdateMax(int64_t v) {
+        int64_t m = max_.load(std::memory_order_relaxed);
+        while (v > m && !max_.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+    }
+
+    std::atomic<int64_t> value_{0};
+    std::atomic<int64_t> max_{0};
+};
+
+// Лог-линейная гистограмма в духе HDR: значения 0–7 точные, дальше каждая октава
+// делится на 8 корзин, так что относительная погрешность не больше 12,5% на всём
+// диапазоне uint64 при 496 фиксированных корзинах. Record — три relaxed-операции и CAS максимума.
+class MetricHistogram {
+public:
+    static constexpr int kSubBits = 3;
+    static constexpr size_t kSubBuckets = size_t(1) << kSubBits;
+    static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+    // unit переводит записанные целые в единицы экспорта (1e-6: микросекунды → секунды)
+    explicit MetricHistogram(double unit = 1.0) : unit_(unit) {}
+
+    void Record(uint64_t v);
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t BucketCount(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    double Unit() const { return unit_; }
+
+    // Верхняя граница корзины, в которую попал q-квантиль (0..1); 0 для пустой гистограммы
+    uint64_t Percentile(double q) const;
+
+    static size_t BucketIndex(uint64_t v);
+    static uint64_t BucketUpper(size_t index);   // включительно
+
+private:
+    const double unit_;
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Срез одной метрики для итоговой сводки
+struct MetricSnapshot {
+    std::string name;
+    std::string labels;        // как в экспорте: stage="compile"
+    std::string kind;          // counter | gauge | histogram
+    double value = 0;          // counter/gauge; для histogram — сумма в единицах экспорта
+    double max   = 0;          // gauge/histogram
+    uint64_t count = 0;        // histogram
+    double p50 = 0, p90 = 0, p99 = 0;
+};
+
+// Процессный реестр метрик с экспортом в текстовый формат Prometheus.
+// Метрика создаётся при первом обращении и живёт до конца процесса, поэтому
+// ссылку удобно держать в static у места обновления:
+//   static MetricCounter& entries = Metrics::Counter("x360_unzip_entries_total", "...");
+// Поиск в реестре берёт мьютекс, обновление уже полученной метрики — нет.
+// Запрос серии (имя, метки) с другим типом — ошибка: о ней пишется в stderr,
+// а возвращается метрика вне реестра, которая не экспортируется.
+class Metrics {
+public:
+    // labels — готовая строка меток без фигурных скобок (см. Label)
+    static MetricCounter& Counter(const char* name, const char* help, const std::string& labels = {});
+    static MetricGauge& Gauge(const char* name, const char* help, const std::string& labels = {});
+    static MetricHistogram& Histogram(const char* name, const char* help, double unit,
+                                      const std::string& labels = {});
+
+    // key="value" с экранированием для формата Prometheus
+    static std::string Label(const char* key, const std::string& value);
+    static std::string Label(const char* key, const std::wstring& value);
+
+    static std::string PrometheusText();
+
+    // Пишет PrometheusText во временный файл и переименовывает: читатель
+    // (node_exporter textfile collector, tail) никогда не видит половину файла
+    static bool WritePrometheus(const std::wstring& path);
+
+    // Фоновый экспорт раз в intervalMs, пока не вызван StopExport (он пишет файл последний раз)
+    static void StartExport(const std::wstring& path, int intervalMs = 1000);
+    static void StopExport();
+
+    // Все метрики с данными, отсортированные по имени
+    static std::vector<MetricSnapshot> Snapshot();
+};
@@ -2,18 +2,22 @@
 #pragma once
 #include <string>
 #include <functional>
+#include <stop_token>
 
 // Интерфейс упаковщика
 class IPacker {
 public:
     virtual ~IPacker() = default;
     // Pack: elfPath → xexPath. progressCallback(percent) может быть nullptr.
-    // outStdout/outStderr собирают вывод процесса. Возвращает true при успехе.
+    // outStdout/outStderr собирают вывод процесса. stop проверяется в цикле по блокам
+    // и при ожидании дочернего процесса (ожидание квантами, при отмене процесс завершается).
+    // Возвращает true при успехе.
     virtual bool Pack(const std::wstring& elfPath,
                       const std::wstring& xexPath,
                       std::function<void(double)> progressCallback,
                       std::wstring& outStdout,
-                      std::wstring& outStderr) = 0;
+                      std::wstring& outStderr,
+                      std::stop_token stop = {}) = 0;
 };
 
 class Packer : public IPacker {
@@ -22,5 +26,6 @@ public:
               const std::wstring& xexPath,
               std::function<void(double)> progressCallback,
               std::wstring& outStdout,
-              std::wstring& outStderr) override;
+              std::wstring& outStderr,
+              std::stop_token stop = {}) override;
 };
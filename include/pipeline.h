@@ -0,0 +1,83 @@
+// include/pipeline.h
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <stop_token>
+#include <cstdint>
+#include "bounded_queue.h"
+#include "metrics.h"
+
+// Передаёт элемент (обычно путь к файлу) следующей стадии.
+// Возвращает false, если конвейер отменён — стадии стоит прекратить работу.
+using PipelineEmit = std::function<bool(const std::wstring& item)>;
+
+// Стадия конвейера: extract → compile → link → pack
+struct PipelineStage {
+    std::wstring name;
+    int workers = 1;                  // сколько потоков обрабатывают стадию
+    size_t queueCapacity = 64;        // ёмкость входной очереди (back-pressure)
+
+    // Обрабатывает один элемент; может выдать ноль или несколько элементов дальше
+    std::function<bool(const std::wstring& item, const PipelineEmit& emit)> process;
+
+    // Необязательно: вызывается один раз, когда вход стадии исчерпан.
+    // Нужен стадиям-агрегаторам (например, линковке, ждущей все объекты модуля).
+    std::function<bool(const PipelineEmit& emit)> finish;
+};
+
+// Статистика стадии: по ней видно, какая стадия узкое место
+struct PipelineStageStats {
+    std::wstring name;
+    uint64_t items  = 0;      // обработано элементов
+    uint64_t busyMs = 0;      // суммарное время в process/finish по всем воркерам
+    size_t maxDepth = 0;      // максимальная заполненность входной очереди
+};
+
+// Потоковый конвейер: стадии работают одновременно и соединены ограниченными очередями.
+// Файл, выданный источником, сразу попадает на следующую стадию, не дожидаясь
+// окончания предыдущей; при заполнении очереди производитель блокируется.
+class Pipeline {
+public:
+    // source выдаёт элементы первой стадии (например, Unzip с колбэком на каждый файл)
+    explicit Pipeline(std::function<bool(const PipelineEmit& emit)> source);
+
+    void AddStage(PipelineStage stage);
+
+    // Запускает все стадии и ждёт завершения. true, если источник и все стадии успешны.
+    // Конвейер одноразовый: после Run очереди закрыты.
+    // Запрос остановки через stop действует как Cancel.
+    bool Run(std::stop_token stop = {});
+
+    // Отменяет конвейер: очереди закрываются, ждущие Push/Pop просыпаются
+    void Cancel();
+
+    // Элементы, выданные последней стадией
+    std::vector<std::wstring> Outputs() const;
+
+    std::vector<PipelineStageStats> Stats() const;
+
+private:
+    struct StageRuntime {
+        PipelineStage stage;
+        std::unique_ptr<BoundedQueue<std::wstring>> input;
+        std::atomic<int> activeWorkers{0};
+        std::atomic<uint64_t> items{0};
+        std::atomic<uint64_t> busyUs{0};            // мкс; в мс переводится только в Stats()
+        MetricCounter* itemsTotal = nullptr;        // x360_pipeline_items_total{stage=...}
+        MetricHistogram* itemSeconds = nullptr;     // время process на элемент
+    };
+
+    void StageWorker(size_t index);
+    bool EmitTo(size_t index, const std::wstring& item);
+    void Fail();
+
+    std::function<bool(const PipelineEmit& emit)> source_;
+    std::vector<std::unique_ptr<StageRuntime>> stages_;
+    mutable std::mutex outMtx_;
+    std::vector<std::wstring> outputs_;
+    std::atomic<bool> failed_{false};
+};
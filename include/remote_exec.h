@@ -0,0 +1,206 @@
+// include/remote_exec.h
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <stop_token>
+#include <chrono>
+#include <cstdint>
+
+// Файл действия: name — относительный путь в песочнице воркера,
+// localPath — где он лежит (вход) или куда его положить (выход) у координатора
+struct RemoteFile {
+    std::string name;
+    std::wstring localPath;
+};
+
+// Действие компиляции/упаковки для удалённого исполнения
+struct RemoteAction {
+    std::vector<std::string> argv;        // argv[0] — инструмент (ищется в PATH воркера)
+    std::vector<RemoteFile> inputs;
+    std::vector<RemoteFile> outputs;
+};
+
+struct RemoteResult {
+    bool ok = false;                      // процесс завершился с кодом 0 и все выходы получены
+    int exitCode = -1;
+    bool cached = false;                  // воркер отдал результат из своего кеша действий
+    std::string key;                      // sha256 действия
+    std::string worker;                   // "host:port"
+    uint64_t uploadedBytes = 0;           // сколько входов реально пришлось передать
+    double ms = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Протокол (TCP, управляющие сообщения — JSON по строке, данные — сырые байты):
+//                                                  W: {"nonce":N}          (сразу после accept)
+//   C: {"op":"hello","auth":HMAC-SHA256(secret, N)}
+//                                                  W: {"slots":N,"running":R}
+//                                                     или {"error":"unauthorized"} и разрыв
+//   C: {"op":"exec","key":K,"argv":[..],
+//       "inputs":[{"name","hash","size"}],"outputs":[..]}
+//                                                  W: {"missing":[hash,...]}
+//                                                     или {"error":...}, если argv[0] не в списке
+//                                                     инструментов или K не совпал с ключом воркера
+//   C: {"op":"blob","hash":H,"size":S}\n<S байт>   (по одному на каждый недостающий)
+//                                                  W: {"log":"строка"} ...
+//                                                  W: {"done":true,"exit":E,"cached":B,"running":R,
+//                                                      "outputs":[{"name","hash","size"}]}
+//                                                     затем байты выходов подряд
+// Вход идентифицируется sha256 содержимого, действие — sha256 argv + входов + имён выходов.
+// Воркер считает ключ действия сам и не верит ключу клиента: кеш действий нельзя отравить.
+// exec принимается только после успешного hello на том же соединении.
+// Обрыв соединения во время exec завершает процесс на воркере.
+// ---------------------------------------------------------------------------
+
+struct RemoteWorkerConfig {
+    std::string bindAddress = "127.0.0.1";
+    uint16_t port = 0;                    // 0 → любой свободный (см. Port())
+    std::wstring root;                    // хранилище блобов и песочницы
+    int slots = 0;                        // одновременных процессов; 0 → число ядер
+    std::string secret;                   // общий с координаторами ключ hello; пустой — Start не запустится
+    std::vector<std::string> tools;       // разрешённые argv[0] (точное совпадение); пустой — Start не запустится
+};
+
+// Процесс-исполнитель: принимает действия, докачивает недостающие входы,
+// запускает инструмент в песочнице и отдаёт лог и выходы.
+// Входы попадают в песочницу reflink-копией или копией, а не жёсткой ссылкой на блоб:
+// инструмент может писать в свои входы, не портя хранилище.
+// Работает только на Linux; на других платформах Start возвращает false.
+class RemoteWorker {
+public:
+    explicit RemoteWorker(const RemoteWorkerConfig& config);
+    ~RemoteWorker();
+
+    bool Start();
+    uint16_t Port() const { return port_; }
+
+    // Блокирует до Stop()
+    void Wait();
+    void Stop();
+
+private:
+    struct CachedAction {
+        int exitCode = 0;
+        std::vector<std::pair<std::string, std::string>> outputs;   // имя → hash блоба
+        std::vector<uint64_t> sizes;
+    };
+
+    void AcceptThread();
+    void HandleClient(int fd);
+    bool HandleExec(int fd, std::string& pending, const std::string& request);
+    bool ReceiveBlob(int fd, std::string& pending, const std::string& hash, uint64_t size);
+    bool StoreOutput(const std::string& path, std::string& hash, uint64_t& size);
+    bool SendFile(int fd, const std::string& path);
+    std::string BlobPath(const std::string& hash) const;
+    void AcquireSlot();
+    void ReleaseSlot();
+
+    RemoteWorkerConfig config_;
+    std::string root_;
+    uint16_t port_ = 0;
+    int listenFd_ = -1;
+    std::thread acceptThread_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> sandboxSeq_{0};
+
+    struct Client {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+        int fd = -1;                      // закрывается после join потока
+    };
+    std::mutex clientsMtx_;
+    std::vector<Client> clients_;
+
+    std::mutex slotMtx_;
+    std::condition_variable slotCv_;
+    int freeSlots_ = 0;
+    std::atomic<int> runningCount_{0};
+
+    std::mutex cacheMtx_;
+    std::unordered_map<std::string, CachedAction> actionCache_;
+
+    std::mutex waitMtx_;
+    std::condition_variable waitCv_;
+};
+
+struct RemoteExecConfig {
+    std::vector<std::string> workers;     // "host:port"
+    int retries = 1;                      // повтор на другом воркере при обрыве соединения
+    std::string secret;                   // тот же, что RemoteWorkerConfig::secret
+};
+
+// Координатор: раздаёт действия воркерам с учётом загрузки.
+// Execute потокобезопасен и блокирует, пока действие не выполнится; параллелизм задаёт
+// вызывающий (например, BuildScheduler с maxJobs = TotalSlots()).
+// Воркер, на котором оборвалась связь, выводится из ротации не навсегда: после паузы
+// (0,5 с, удваивается при каждом новом сбое, не больше 30 с) Execute снова шлёт ему hello
+// и при ответе возвращает в ротацию.
+class RemoteExecutor {
+public:
+    explicit RemoteExecutor(const RemoteExecConfig& config);
+
+    // Опрашивает воркеров (hello). false, если ни один не ответил.
+    // Не ответившие будут опрошены повторно после паузы (см. выше).
+    bool Connect();
+
+    // Выполняет действие. onLog получает строки вывода процесса по мере поступления.
+    bool Execute(const RemoteAction& action, RemoteResult& result,
+                 const std::function<void(const std::string&)>& onLog = nullptr,
+                 std::stop_token stop = {});
+
+    size_t WorkerCount() const;
+    int TotalSlots() const;
+
+    // sha256 действия: argv, имена и хеши входов, имена выходов
+    static std::string ActionKey(const RemoteAction& action,
+                                 const std::vector<std::string>& inputHashes);
+
+private:
+    struct Worker {
+        std::string address;
+        std::string host;
+        uint16_t port = 0;
+        int slots = 1;
+        int inflight = 0;                 // наши действия на воркере
+        int external = 0;                 // занятые слоты по последнему ответу воркера (все клиенты)
+        bool alive = false;
+        bool probing = false;             // идёт повторный hello (вне mtx_)
+        int failures = 0;                 // сбоев связи подряд; задаёт паузу до повторного hello
+        std::chrono::steady_clock::time_point retryAt{};
+    };
+
+    // hello одному воркеру: слоты и занятость. false — не ответил или отказал
+    bool Probe(const Worker& w, int& slots, int& running);
+    // Результат hello: жив — в ротацию, иначе следующая попытка после паузы; под mtx_
+    void MarkProbed(Worker& w, bool alive, int slots, int running);
+    // Повторно опрашивает выведенных из ротации воркеров, чья пауза истекла
+    void ReviveWorkers();
+    int PickWorker(const std::vector<int>& exclude, std::stop_token stop);
+    void ReleaseWorker(int index, int reportedRunning);
+    bool HashInput(const std::wstring& path, std::string& hash, uint64_t& size);
+    int RunOn(int index, const RemoteAction& action, const std::vector<std::string>& hashes,
+              const std::vector<uint64_t>& sizes, RemoteResult& result,
+              const std::function<void(const std::string&)>& onLog, std::stop_token stop,
+              int& reportedRunning);
+    int Exchange(int fd, const RemoteAction& action, const std::vector<std::string>& hashes,
+                 const std::vector<uint64_t>& sizes, RemoteResult& result,
+                 const std::function<void(const std::string&)>& onLog, int& reportedRunning);
+
+    RemoteExecConfig config_;
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::vector<Worker> workers_;
+
+    // Кеш хешей входов: путь → (размер, mtime, hash), чтобы не перечитывать файлы
+    struct HashEntry { uint64_t size; int64_t mtime; std::string hash; };
+    std::mutex hashMtx_;
+    std::map<std::wstring, HashEntry> hashCache_;
+};
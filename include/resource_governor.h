@@ -0,0 +1,156 @@
+// include/resource_governor.h
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stop_token>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+
+// Что работа резервирует на время выполнения
+struct ResourceRequest {
+    uint64_t memoryBytes = 0;         // пиковая память задания (оценка)
+    uint64_t ioBytesPerSec = 0;       // ожидаемая дисковая/сетевая полоса
+
+    bool Empty() const { return memoryBytes == 0 && ioBytesPerSec == 0; }
+};
+
+struct ResourceGovernorConfig {
+    uint64_t memoryBudget = 0;        // сумма резерваций; 0 → memoryFraction от MemAvailable при старте
+    double memoryFraction = 0.75;
+    uint64_t minAvailable = 512ull << 20;   // не допускать новую работу, если свободной памяти меньше
+    uint64_t ioBudget = 0;            // байт/с на все резервации; 0 → без ограничения
+    double maxMemoryPressure = 10.0;  // PSI memory "some avg10", %; выше — новая работа ждёт
+    double maxIoPressure = 40.0;      // PSI io "some avg10", %
+    int pollMs = 200;                 // как часто перечитывать состояние системы
+    int starvationMs = 2000;          // после стольких мс ожидания крупный запрос идёт вне очереди
+};
+
+// Состояние системы на момент последнего опроса
+struct SystemResources {
+    bool valid = false;               // удалось прочитать хоть что-то
+    uint64_t totalMemory = 0;
+    uint64_t availableMemory = 0;
+    double memoryPressure = 0;        // PSI avg10, %; 0 там, где PSI нет (Windows, старые ядра)
+    double ioPressure = 0;
+};
+
+struct ResourceGovernorStats {
+    uint64_t reservedMemory = 0;
+    uint64_t reservedIo = 0;
+    uint64_t memoryBudget = 0;
+    int running = 0;                  // активные резервации
+    int waiting = 0;                  // ждут допуска
+    uint64_t admitted = 0;            // всего допущено
+    uint64_t deferred = 0;            // из них пришлось ждать
+    SystemResources system;
+};
+
+class ResourceGovernor;
+
+// Бюджет вложенной работы, вырезанный из резервации родителя (см. ResourceLease::Scope).
+// Поля меняются только под мьютексом governor.
+struct LeaseNest {
+    ResourceGovernor* governor = nullptr;
+    ResourceRequest budget;           // резервация родителя
+    ResourceRequest used;             // сколько из неё держат вложенные резервации
+    int children = 0;
+};
+
+// RAII-резервация: ресурсы возвращаются в деструкторе или Release()
+class ResourceLease {
+public:
+    // Пока Scope жив, Acquire/TryAcquire того же governor в этом потоке берут ресурсы
+    // из резервации родителя, а не из общего бюджета: работа, держащая резервацию
+    // (узел планировщика), не ждёт сама себя, вызвав Unzip или загрузку.
+    // Вложенные запросы не встают в общую очередь и не уступают заждавшимся.
+    class Scope {
+    public:
+        explicit Scope(const ResourceLease& lease);
+        // Для потоков, порождённых вложенной работой: nest из CurrentNest() родительского потока
+        explicit Scope(std::shared_ptr<LeaseNest> nest);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        std::shared_ptr<LeaseNest> prev_;
+    };
+
+    // Бюджет родителя в этом потоке; nullptr вне Scope
+    static std::shared_ptr<LeaseNest> CurrentNest();
+
+    ResourceLease() = default;
+    ResourceLease(ResourceLease&& other) noexcept;
+    ResourceLease& operator=(ResourceLease&& other) noexcept;
+    ~ResourceLease() { Release(); }
+
+    ResourceLease(const ResourceLease&) = delete;
+    ResourceLease& operator=(const ResourceLease&) = delete;
+
+    void Release();
+    explicit operator bool() const { return governor_ != nullptr; }
+
+private:
+    friend class ResourceGovernor;
+    ResourceLease(ResourceGovernor* governor, const ResourceRequest& request,
+                  std::shared_ptr<LeaseNest> nest = nullptr)
+        : governor_(governor), request_(request), nest_(std::move(nest)) {}
+
+    ResourceGovernor* governor_ = nullptr;
+    ResourceRequest request_;
+    std::shared_ptr<LeaseNest> nest_;   // ≠nullptr → резервация вырезана из бюджета родителя
+};
+
+// Допуск работы по бюджетам памяти и полосы ввода-вывода с учётом живого давления
+// системы (/proc/meminfo и PSI на Linux, GlobalMemoryStatusEx на Windows).
+// Новая работа допускается, только если её резервация влезает в бюджет, свободной
+// памяти останется не меньше minAvailable и PSI ниже порогов. Когда активных
+// резерваций нет, допускается любая — иначе слишком крупный запрос ждал бы вечно.
+// Запросы внутри ResourceLease::Scope делят резервацию родителя и общий бюджет не трогают.
+class ResourceGovernor {
+public:
+    explicit ResourceGovernor(const ResourceGovernorConfig& config = {});
+
+    // Блокирует до допуска. Пустая резервация — если запрошена остановка (stop или cancelled()).
+    ResourceLease Acquire(const ResourceRequest& request,
+                          std::stop_token stop = {},
+                          const std::function<bool()>& cancelled = nullptr);
+
+    // Без ожидания: пустая резервация, если сейчас не влезает
+    ResourceLease TryAcquire(const ResourceRequest& request);
+
+    ResourceGovernorStats Stats();
+
+    // Общий экземпляр для распаковки, упаковки и загрузок одного процесса
+    static ResourceGovernor& Shared();
+
+    // Опрос системы без кеширования
+    static SystemResources ReadSystem();
+
+private:
+    friend class ResourceLease;
+    void Release(const ResourceRequest& request, LeaseNest* nest);
+    bool Fits(const ResourceRequest& request, uint64_t ticket);
+    static bool FitsNest(const LeaseNest& nest, const ResourceRequest& request);
+    ResourceLease AcquireNested(const std::shared_ptr<LeaseNest>& nest,
+                                const ResourceRequest& request, bool wait,
+                                std::stop_token stop, const std::function<bool()>& cancelled);
+    void Refresh(bool force);
+
+    ResourceGovernorConfig config_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    uint64_t reservedMemory_ = 0;
+    uint64_t reservedIo_ = 0;
+    int running_ = 0;
+    int waiting_ = 0;
+    uint64_t admitted_ = 0;
+    uint64_t deferred_ = 0;
+    uint64_t nextTicket_ = 1;
+    uint64_t starvingTicket_ = 0;     // ≠0 → допускается только этот ожидающий
+    SystemResources system_;
+    std::chrono::steady_clock::time_point lastRefresh_{};
+};
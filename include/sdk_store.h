@@ -0,0 +1,113 @@
+// include/sdk_store.h
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+#include <stop_token>
+#include <cstdint>
+#include <cstddef>
+
+// Конфигурация хранилища SDK
+struct SdkStoreConfig {
+    std::wstring root;                 // каталог хранилища
+    size_t minChunk = 16 * 1024;       // границы чанков FastCDC
+    size_t avgChunk = 64 * 1024;       // степень двойки
+    size_t maxChunk = 256 * 1024;
+    int threads = 0;                   // потоки импорта и сборки дерева; 0 → по числу ядер
+};
+
+// Итог последнего Import/ImportZip
+struct SdkImportStats {
+    uint64_t files     = 0;
+    uint64_t bytes     = 0;            // логический размер версии
+    uint64_t chunks    = 0;            // чанков в версии (с повторами)
+    uint64_t newChunks = 0;            // из них впервые попали в хранилище
+    uint64_t newBytes  = 0;            // сколько места реально добавилось
+};
+
+// Состояние хранилища
+struct SdkStoreStats {
+    size_t versions    = 0;
+    uint64_t chunks    = 0;
+    uint64_t chunkBytes = 0;           // дедуплицированное содержимое всех версий
+    uint64_t blobs     = 0;            // собранные целые файлы — источники ссылок для деревьев
+    uint64_t blobBytes = 0;
+};
+
+// Локальное хранилище снимков SDK/тулчейна с дедупликацией между версиями.
+//
+// Файлы версии режутся на чанки по содержимому (FastCDC, gear-хеш), так что
+// вставка в середину файла сдвигает границы только рядом с правкой. Чанки лежат
+// один раз по sha256: <root>/chunks/<2>/<hash>. Версия — манифест
+// <root>/manifests/<версия>.json: пути, хеши файлов и списки чанков.
+//
+// Materialize собирает дерево версии: каждый файл один раз склеивается из чанков в
+// <root>/blobs/<2>/<hash>[.x] (только чтение), а в дерево попадает его reflink,
+// жёсткая ссылка или копия — как у BuildCache. Одинаковые файлы разных версий делят
+// один blob, поэтому переключение версии почти не пишет на диск. Через жёсткую ссылку
+// blob могли изменить из дерева, поэтому при публикации его размер, mtime и inode
+// записываются в <root>/stamps/<2>/<hash>[.x]; существующий blob перехешируется по
+// sha256, только если штамп не совпал.
+// CollectGarbage удаляет чанки без манифестов и blobs, на которые не ссылается ни одно дерево.
+//
+// Import/Materialize можно вызывать из разных потоков; CollectGarbage — только
+// когда с хранилищем больше никто не работает.
+class SdkStore {
+public:
+    explicit SdkStore(const SdkStoreConfig& config);
+
+    // Создаёт каталоги, чистит недописанные временные файлы старше часа и индексирует чанки
+    bool Open();
+
+    // Кладёт распакованное дерево как версию. Существующая версия перезаписывается.
+    // Симлинки сохраняются, если указывают внутрь дерева; иначе Import возвращает false.
+    bool Import(const std::wstring& version, const std::wstring& treeDir, std::stop_token stop = {});
+
+    // Распаковывает архив (Unzip) и режет файлы на чанки по мере их извлечения
+    bool ImportZip(const std::wstring& version, const std::wstring& zipPath, std::stop_token stop = {});
+
+    // Собирает дерево версии в outDir. Дерево строится рядом и подменяет outDir
+    // переименованием, так что прерванное переключение не оставляет смеси версий.
+    bool Materialize(const std::wstring& version, const std::wstring& outDir, std::stop_token stop = {});
+
+    bool Has(const std::wstring& version) const;
+    std::vector<std::wstring> Versions() const;
+
+    // Удаляет манифест версии; место освобождает CollectGarbage
+    bool Remove(const std::wstring& version);
+
+    // Удаляет неиспользуемые чанки и blobs. Возвращает число освобождённых байт.
+    uint64_t CollectGarbage();
+
+    SdkImportStats LastImport() const;
+    SdkStoreStats Stats() const;
+
+    // Длина следующего чанка в data[0..size). Если за size есть ещё данные,
+    // size должен быть не меньше maxChunk. Открыто для бенчмарков.
+    static size_t CutPoint(const uint8_t* data, size_t size,
+                           size_t minChunk, size_t avgChunk, size_t maxChunk);
+
+private:
+    struct ImportState;
+
+    // Режет файл и сохраняет новые чанки; заполняет запись манифеста
+    bool AddFile(ImportState& state, const std::wstring& treeDir, const std::wstring& file,
+                 std::stop_token stop);
+    bool WriteChunk(const std::string& hash, const uint8_t* data, size_t size, bool& added);
+    bool BuildBlob(const std::string& fileHash, uint64_t size, bool exec,
+                   const std::vector<std::string>& chunks, std::wstring& outPath);
+    bool CommitManifest(const std::wstring& version, ImportState& state);
+
+    std::wstring ChunkPath(const std::string& hash) const;
+    std::wstring BlobPath(const std::string& hash, bool exec) const;
+    std::wstring StampPath(const std::string& hash, bool exec) const;
+    std::wstring ManifestPath(const std::wstring& version) const;
+    static bool ValidVersion(const std::wstring& version);
+
+    SdkStoreConfig config_;
+    mutable std::mutex mtx_;
+    std::unordered_set<std::string> chunks_;   // хеши чанков на диске
+    uint64_t chunkBytes_ = 0;
+    SdkImportStats lastImport_;
+};
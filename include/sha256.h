@@ -0,0 +1,30 @@
+// include/sha256.h
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Потоковый SHA-256 (FIPS 180-4) без внешних зависимостей
+class Sha256 {
+public:
+    Sha256();
+
+    void Update(const void* data, size_t size);
+    void Update(const std::string& s) { Update(s.data(), s.size()); }
+
+    // Завершает вычисление, возвращает hex-строку из 64 символов.
+    // После вызова объект сбрасывается и готов к новому хешу.
+    std::string FinalHex();
+
+    // Хеширует содержимое файла. Возвращает false, если файл не читается.
+    static bool HashFile(const std::wstring& path, std::string& outHex);
+
+private:
+    void Reset();
+    void Transform(const uint8_t* block);
+
+    uint32_t state_[8];
+    uint8_t buffer_[64];
+    size_t bufferLen_ = 0;
+    uint64_t totalLen_ = 0;
+};
@@ -0,0 +1,67 @@
+// include/trace.h
+#pragma once
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+// Лёгкая трассировка в формате Chrome trace events (chrome://tracing, ui.perfetto.dev).
+// Спаны пишутся в thread-local буфер без общих блокировок; JSON собирается только в Tracer::Write.
+// Пока трассировка выключена, TraceSpan стоит одну relaxed-загрузку атомика.
+class Tracer {
+public:
+    // Включает запись. Буферы, набранные до Write, сохраняются.
+    static void Enable();
+    static void Disable();
+
+    static bool Enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Пишет все накопленные события в path и очищает буферы. false при ошибке записи.
+    static bool Write(const std::wstring& path);
+
+    // Текущее время трассы в микросекундах (steady_clock)
+    static uint64_t NowUs();
+
+    // Записывает завершённый спан (ph = "X")
+    static void Record(const char* category, const char* name,
+                       uint64_t startUs, uint64_t durUs, std::string detail);
+
+    // Имя текущего потока в таймлайне
+    static void SetThreadName(const char* name);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// RAII-спан: от конструктора до деструктора. category и name — строковые литералы.
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name)
+        : category_(category), name_(name),
+          start_(Tracer::Enabled() ? Tracer::NowUs() : 0) {}
+
+    // detail попадает в args.detail (например, имя файла в архиве)
+    TraceSpan(const char* category, const char* name, const std::wstring& detail);
+
+    ~TraceSpan() {
+        if (start_ != 0) {
+            Tracer::Record(category_, name_, start_, Tracer::NowUs() - start_, std::move(detail_));
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* category_;
+    const char* name_;
+    uint64_t start_;
+    std::string detail_;
+};
+
+#define X360_TRACE_CONCAT2(a, b) a##b
+#define X360_TRACE_CONCAT(a, b) X360_TRACE_CONCAT2(a, b)
+// Спан на текущую область видимости
+#define TRACE_SCOPE(category, ...) \
+    TraceSpan X360_TRACE_CONCAT(traceSpan_, __LINE__)(category, __VA_ARGS__)
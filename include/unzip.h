@@ -0,0 +1,22 @@
+// include/unzip.h
+#pragma once
+#include <string>
+#include <functional>
+#include <stop_token>
+
+// Колбэк на каждый извлечённый файл; вызывается из рабочих потоков Unzip сразу после записи.
+// Возврат false останавливает распаковку (Unzip вернёт false).
+using UnzipFileCallback = std::function<bool(const std::wstring& path)>;
+
+// Распаковывает zipPath в outDir не более чем в maxThreads потоков (≤0 → по числу ядер).
+// Каждая запись берёт резервацию у ResourceGovernor::Shared(), так что при нехватке
+// памяти или перегруженном диске одновременно пишут меньше потоков. Внутри
+// ResourceLease::Scope (действие узла BuildScheduler) записи делят резервацию вызывающего.
+// stop проверяется перед каждой записью и после каждого прочитанного блока (64 КБ);
+// при отмене недописанный файл удаляется, а Unzip возвращает false.
+// Возвращает true, если извлечён хотя бы один файл и в архиве нет симлинков.
+bool Unzip(const std::wstring& zipPath,
+           const std::wstring& outDir,
+           int maxThreads = 4,
+           UnzipFileCallback onFile = nullptr,
+           std::stop_token stop = {});
@@ -0,0 +1,24 @@
+// include/utf8.h
+#pragma once
+#include <string>
+#include <string_view>
+#include <memory_resource>
+
+// Перекодировка между wstring и UTF-8 без ICU и без WinAPI.
+// wchar_t — UTF-16 на Windows (суррогатные пары склеиваются) и UTF-32 на Linux.
+
+// Одиночные суррогаты заменяются на U+FFFD
+std::string WStringToUtf8(const std::wstring& in);
+
+// То же в буфер вызывающего: out перезаписывается, его ёмкость переиспользуется
+void WStringToUtf8(std::wstring_view in, std::string& out);
+
+// Некорректные ведущие байты пропускаются, обрезанная последовательность в конце отбрасывается.
+// Для строгой проверки есть Utf8ToWStringStrict.
+std::wstring Utf8ToWString(const std::string& in);
+
+// Строгий вариант (как MultiByteToWideChar с MB_ERR_INVALID_CHARS): false и пустой out
+// на любой некорректной последовательности — лишнем продолжении, overlong-форме,
+// суррогате, коде выше U+10FFFF или обрезанном хвосте. Ёмкость out переиспользуется.
+bool Utf8ToWStringStrict(std::string_view in, std::wstring& out);
+bool Utf8ToWStringStrict(std::string_view in, std::pmr::wstring& out);
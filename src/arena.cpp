@@ -0,0 +1,190 @@
+// src/arena.cpp
+#include "arena.h"
+#include <new>
+#include <cstdlib>
+#include <algorithm>
+
+// ----------------------------- BumpArena -----------------------------
+
+BumpArena::BumpArena(size_t blockSize)
+    : blockSize_(blockSize > 0 ? blockSize : 4096)
+{
+}
+
+void* BumpArena::Allocate(size_t size, size_t align) {
+    if (align == 0 || (align & (align - 1)) != 0) align = alignof(std::max_align_t);
+    while (current_ < blocks_.size()) {
+        Block& b = blocks_[current_];
+        uintptr_t base = (uintptr_t)b.data.get();
+        uintptr_t p = (base + offset_ + align - 1) & ~(uintptr_t)(align - 1);
+        if (p + size <= base + b.size) {
+            offset_ = (size_t)(p - base) + size;
+            used_ += size;
+            return (void*)p;
+        }
+        // Блок кончился — переходим к следующему (после Reset они уже есть)
+        ++current_;
+        offset_ = 0;
+    }
+    // Крупный запрос получает отдельный блок под себя, чтобы не раздувать стандартный
+    Block b;
+    b.size = std::max(blockSize_, size + align);
+    b.data.reset(new char[b.size]);
+    blocks_.push_back(std::move(b));
+    current_ = blocks_.size() - 1;
+    offset_ = 0;
+    return Allocate(size, align);
+}
+
+void BumpArena::Reset() {
+    current_ = 0;
+    offset_ = 0;
+    used_ = 0;
+}
+
+size_t BumpArena::Capacity() const {
+    size_t total = 0;
+    for (const auto& b : blocks_) total += b.size;
+    return total;
+}
+
+// ----------------------------- BufferPool -----------------------------
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept {
+    if (this != &other) {
+        if (pool_ && data_) pool_->Release(std::move(data_));
+        pool_ = other.pool_;
+        data_ = std::move(other.data_);
+        size_ = other.size_;
+        other.pool_ = nullptr;
+    }
+    return *this;
+}
+
+PooledBuffer::~PooledBuffer() {
+    if (pool_ && data_) pool_->Release(std::move(data_));
+}
+
+BufferPool::BufferPool(size_t bufferSize, size_t maxRetained)
+    : bufferSize_(bufferSize), maxRetained_(maxRetained)
+{
+}
+
+PooledBuffer BufferPool::Acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!free_.empty()) {
+            std::unique_ptr<char[]> data = std::move(free_.back());
+            free_.pop_back();
+            return PooledBuffer(this, std::move(data), bufferSize_);
+        }
+    }
+    return PooledBuffer(this, std::unique_ptr<char[]>(new char[bufferSize_]), bufferSize_);
+}
+
+void BufferPool::Release(std::unique_ptr<char[]> data) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (free_.size() < maxRetained_) {
+        free_.push_back(std::move(data));
+    }
+}
+
+BufferPool& BufferPool::Shared64K() {
+    static BufferPool pool(64 * 1024, 64);
+    return pool;
+}
+
+// ----------------------------- AllocStats -----------------------------
+
+namespace {
+
+struct SiteCounters {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> units{0};
+};
+
+SiteCounters g_sites[(size_t)AllocSite::Count];
+
+#if defined(X360_COUNT_ALLOCS)
+thread_local uint64_t t_allocations = 0;
+thread_local uint64_t t_bytes = 0;
+#endif
+
+} // namespace
+
+const char* AllocStats::SiteName(AllocSite site) {
+    switch (site) {
+        case AllocSite::Unzip:  return "unzip";
+        case AllocSite::Logger: return "logger";
+        case AllocSite::Locale: return "locale";
+        default:                return "unknown";
+    }
+}
+
+AllocSiteStats AllocStats::Get(AllocSite site) {
+    AllocSiteStats s;
+    if (site >= AllocSite::Count) return s;
+    const SiteCounters& c = g_sites[(size_t)site];
+    s.allocations = c.allocations.load(std::memory_order_relaxed);
+    s.bytes       = c.bytes.load(std::memory_order_relaxed);
+    s.units       = c.units.load(std::memory_order_relaxed);
+    return s;
+}
+
+void AllocStats::Reset() {
+    for (auto& c : g_sites) {
+        c.allocations.store(0, std::memory_order_relaxed);
+        c.bytes.store(0, std::memory_order_relaxed);
+        c.units.store(0, std::memory_order_relaxed);
+    }
+}
+
+void AllocStats::Add(AllocSite site, uint64_t allocations, uint64_t bytes, uint64_t units) {
+    if (site >= AllocSite::Count) return;
+    SiteCounters& c = g_sites[(size_t)site];
+    c.allocations.fetch_add(allocations, std::memory_order_relaxed);
+    c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    c.units.fetch_add(units, std::memory_order_relaxed);
+}
+
+#if defined(X360_COUNT_ALLOCS)
+
+uint64_t AllocStats::ThreadAllocations() { return t_allocations; }
+uint64_t AllocStats::ThreadBytes() { return t_bytes; }
+
+// Замена глобальных operator new/delete только для диагностических сборок.
+// Выровненные (align_val_t) варианты остаются стандартными и не считаются.
+void* operator new(std::size_t size) {
+    ++t_allocations;
+    t_bytes += size;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#else
+
+uint64_t AllocStats::ThreadAllocations() { return 0; }
+uint64_t AllocStats::ThreadBytes() { return 0; }
+
+#endif
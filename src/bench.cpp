@@ -0,0 +1,418 @@
+// src/bench.cpp
+#include "bench.h"
+#include "unzip.h"
+#include "logger.h"
+#include "locale.h"
+#include "packer.h"
+#include "trace.h"
+#include "arena.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <random>
+#include <cstdio>
+#include <nlohmann/json.hpp>
+#include <zip.h>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+// Детерминированный генератор (SplitMix64): одинаковые фикстуры на каждом прогоне
+class BenchRng {
+public:
+    explicit BenchRng(uint64_t seed) : state_(seed) {}
+    uint64_t Next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+private:
+    uint64_t state_;
+};
+
+// Смесь «текста» (сжимается) и случайных блоков (не сжимается), примерно как в SDK:
+// исходники/заголовки вперемешку с бинарями
+std::string MakePayload(BenchRng& rng, size_t size) {
+    static const char* words[] = {
+        "xenon", "static", "const", "return", "struct", "include", "void",
+        "uint32_t", "buffer", "texture", "shader", "memory", "thread", "{", "}", ";"
+    };
+    std::string out;
+    out.reserve(size);
+    while (out.size() < size) {
+        if ((rng.Next() & 3) == 0) {
+            for (int i = 0; i < 64 && out.size() < size; ++i) {
+                uint64_t v = rng.Next();
+                for (int b = 0; b < 8 && out.size() < size; ++b) {
+                    out.push_back((char)(v >> (b * 8)));
+                }
+            }
+        } else {
+            for (int i = 0; i < 64 && out.size() < size; ++i) {
+                out += words[rng.Next() % (sizeof(words) / sizeof(words[0]))];
+                out.push_back((rng.Next() & 7) == 0 ? '\n' : ' ');
+            }
+        }
+    }
+    out.resize(size);
+    return out;
+}
+
+std::string PathToUtf8(const fs::path& p) {
+    auto s = p.u8string();
+    return std::string(s.begin(), s.end());
+}
+
+// Пишет zip из count файлов по fileSize байт. Буферы живут до zip_close.
+bool MakeZip(const fs::path& path, size_t count, size_t fileSize, bool deflate, uint64_t seed) {
+    int err = 0;
+    zip_t* za = zip_open(PathToUtf8(path).c_str(), ZIP_CREATE | ZIP_TRUNCATE, &err);
+    if (!za) return false;
+
+    BenchRng rng(seed);
+    std::vector<std::string> data;
+    data.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        data.push_back(MakePayload(rng, fileSize));
+        std::string name = "d" + std::to_string(i / 50) + "/f" + std::to_string(i) + ".bin";
+        zip_source_t* src = zip_source_buffer(za, data.back().data(), data.back().size(), 0);
+        if (!src) {
+            zip_discard(za);
+            return false;
+        }
+        zip_int64_t idx = zip_file_add(za, name.c_str(), src, ZIP_FL_OVERWRITE);
+        if (idx < 0) {
+            zip_source_free(src);
+            zip_discard(za);
+            return false;
+        }
+        zip_set_file_compression(za, (zip_uint64_t)idx, deflate ? ZIP_CM_DEFLATE : ZIP_CM_STORE, 0);
+    }
+    return zip_close(za) == 0;
+}
+
+#ifdef _WIN32
+// Минимальный ELF32 big-endian PowerPC: заголовок + один PT_LOAD с payload
+bool MakeElf(const fs::path& path, size_t textSize, uint64_t seed) {
+    auto be16 = [](std::string& s, uint16_t v) { s.push_back((char)(v >> 8)); s.push_back((char)v); };
+    auto be32 = [&](std::string& s, uint32_t v) { be16(s, (uint16_t)(v >> 16)); be16(s, (uint16_t)v); };
+
+    std::string elf = std::string("\x7F" "ELF", 4);
+    elf += std::string("\x01\x02\x01", 3);      // ELFCLASS32, ELFDATA2MSB, EV_CURRENT
+    elf.resize(16, '\0');
+    be16(elf, 2);                               // ET_EXEC
+    be16(elf, 20);                              // EM_PPC
+    be32(elf, 1);
+    be32(elf, 0x82000000u + 0x1000);            // e_entry
+    be32(elf, 52);                              // e_phoff
+    be32(elf, 0);                               // e_shoff
+    be32(elf, 0);                               // e_flags
+    be16(elf, 52); be16(elf, 32); be16(elf, 1); // ehsize, phentsize, phnum
+    be16(elf, 40); be16(elf, 0); be16(elf, 0);  // shentsize, shnum, shstrndx
+    be32(elf, 1);                               // PT_LOAD
+    be32(elf, 0x1000);                          // p_offset
+    be32(elf, 0x82000000u + 0x1000);            // p_vaddr
+    be32(elf, 0x82000000u + 0x1000);            // p_paddr
+    be32(elf, (uint32_t)textSize);
+    be32(elf, (uint32_t)textSize);
+    be32(elf, 5);                               // R|X
+    be32(elf, 0x1000);
+    elf.resize(0x1000, '\0');
+    BenchRng rng(seed);
+    elf += MakePayload(rng, textSize);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(elf.data(), (std::streamsize)elf.size());
+    return (bool)out;
+}
+#endif
+
+// Доступ к защищённой карте и конвертеру Locale без загрузки файла с диска
+class BenchLocale : public Locale {
+public:
+    static void Fill(size_t keys) {
+        std::lock_guard<std::mutex> lock(GetMutex());
+        auto& map = GetLangMap();
+        map.clear();
+        for (size_t i = 0; i < keys; ++i) {
+            map[L"ui.key." + std::to_wstring(i)] = L"Значение строки " + std::to_wstring(i);
+        }
+    }
+    static void Reset() {
+        std::lock_guard<std::mutex> lock(GetMutex());
+        GetLangMap().clear();
+    }
+    static bool Convert(const std::string& utf8, std::wstring& out) {
+        return Utf8ToWStringSafe(utf8, out);
+    }
+};
+
+double Median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+} // namespace
+
+BenchSuite::BenchSuite(const BenchConfig& config)
+    : config_(config)
+{
+    if (config_.repeats < 1) config_.repeats = 1;
+}
+
+bool BenchSuite::Selected(const std::string& name) const {
+    return config_.filter.empty() || name.find(config_.filter) != std::string::npos;
+}
+
+bool BenchSuite::Run() {
+    results_.clear();
+    std::error_code ec;
+    fs::create_directories(fs::path(config_.workDir), ec);
+    if (ec) return false;
+    // Свой подкаталог на прогон: параллельные прогоны не удаляют фикстуры друг друга
+    fs::path root;
+    std::random_device rd;
+    for (int attempt = 0; attempt < 16 && root.empty(); ++attempt) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "run-%08x%08x", (unsigned)rd(), (unsigned)rd());
+        fs::path candidate = fs::path(config_.workDir) / name;
+        if (fs::create_directory(candidate, ec)) root = candidate;
+    }
+    if (root.empty()) return false;
+
+    // setup — вне замера (очистка вывода и т.п.), body — замеряемая работа, work — её объём.
+    // site — подсистема, чьи аллокации на единицу попадут в отчёт (AllocSite::Count — ничья).
+    auto measure = [&](const std::string& name, const std::string& unit, double work,
+                       const std::function<void()>& setup, const std::function<bool()>& body,
+                       AllocSite site = AllocSite::Count)
+    {
+        BenchResult r;
+        r.name = name;
+        r.unit = unit;
+        AllocSiteStats allocBefore = AllocStats::Get(site);
+        std::vector<double> samples;
+        for (int i = 0; i < config_.repeats; ++i) {
+            if (setup) setup();
+            TRACE_SCOPE("bench", "case", std::wstring(name.begin(), name.end()));
+            auto t0 = std::chrono::steady_clock::now();
+            bool ok = body();
+            auto t1 = std::chrono::steady_clock::now();
+            if (!ok) {
+                r.failed = true;
+                r.note = "case failed";
+                break;
+            }
+            samples.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+        }
+        if (!r.failed && !samples.empty()) {
+            r.medianMs = Median(samples);
+            r.minMs = *std::min_element(samples.begin(), samples.end());
+            r.maxMs = *std::max_element(samples.begin(), samples.end());
+            r.throughput = r.medianMs > 0 ? work / (r.medianMs / 1000.0) : 0;
+        }
+        AllocSiteStats allocAfter = AllocStats::Get(site);
+        if (AllocStats::Enabled() && site != AllocSite::Count && allocAfter.units > allocBefore.units) {
+            r.allocsPerUnit = (double)(allocAfter.allocations - allocBefore.allocations) /
+                              (double)(allocAfter.units - allocBefore.units);
+        }
+        results_.push_back(r);
+    };
+
+    // 1) Распаковка: много мелких и несколько крупных файлов, stored и deflate
+    struct ZipCase { const char* name; size_t count; size_t size; bool deflate; };
+    const ZipCase zips[] = {
+        { "unzip.many_small.stored",   2000, 4 * 1024,          false },
+        { "unzip.many_small.deflated", 2000, 4 * 1024,          true  },
+        { "unzip.few_huge.stored",     4,    16 * 1024 * 1024,  false },
+        { "unzip.few_huge.deflated",   4,    16 * 1024 * 1024,  true  },
+    };
+    uint64_t seed = 1;
+    for (const auto& z : zips) {
+        ++seed;
+        if (!Selected(z.name)) continue;
+        fs::path zipPath = root / (std::string(z.name) + ".zip");
+        fs::path outDir = root / (std::string(z.name) + ".out");
+        if (!MakeZip(zipPath, z.count, z.size, z.deflate, seed)) {
+            results_.push_back({ z.name, "MB/s", 0, 0, 0, 0, -1, false, true, "fixture generation failed" });
+            continue;
+        }
+        double mb = (double)(z.count * z.size) / (1024.0 * 1024.0);
+        measure(z.name, "MB/s", mb,
+                [&]() { std::error_code e; fs::remove_all(outDir, e); },
+                [&]() { return Unzip(zipPath.wstring(), outDir.wstring(), 4); },
+                AllocSite::Unzip);
+        fs::remove_all(outDir, ec);
+        fs::remove(zipPath, ec);
+    }
+
+    // 2) Логгер: 8 производителей × 20000 сообщений до полной записи на диск (Close).
+    //    Очередь с запасом, чтобы сообщения не отбрасывались и замер был честным.
+    if (Selected("logger.storm")) {
+        const int producers = 8;
+        const int perProducer = 20000;
+        fs::path logPath = root / "bench.log";
+        measure("logger.storm", "ops/s", (double)producers * perProducer,
+                [&]() { std::error_code e; fs::remove(logPath, e); },
+                [&]() {
+                    LoggerConfig cfg;
+                    cfg.filename      = logPath.wstring();
+                    cfg.maxFileSize   = 1ull << 40;
+                    cfg.consoleOutput = false;
+                    cfg.maxQueueSize  = (size_t)producers * perProducer;
+                    try {
+                        AsyncFileLogger logger(cfg);
+                        std::vector<std::thread> threads;
+                        for (int p = 0; p < producers; ++p) {
+                            threads.emplace_back([&logger, p, perProducer]() {
+                                for (int i = 0; i < perProducer; ++i) {
+                                    logger.Log(LogLevel::Info, L"producer " + std::to_wstring(p) +
+                                                               L" extracted file " + std::to_wstring(i));
+                                }
+                            });
+                        }
+                        for (auto& t : threads) t.join();
+                        logger.Close();
+                    } catch (...) {
+                        return false;
+                    }
+                    return true;
+                },
+                AllocSite::Logger);
+        fs::remove(logPath, ec);
+    }
+
+    // 3) Локаль: 1M обращений к L() по 2000 ключам, каждое десятое — промах
+    if (Selected("locale.lookup")) {
+        const size_t keys = 2000;
+        const int lookups = 1000000;
+        BenchLocale::Fill(keys);
+        std::vector<std::wstring> probe;
+        BenchRng rng(42);
+        for (int i = 0; i < 4096; ++i) {
+            uint64_t k = rng.Next();
+            probe.push_back(k % 10 == 0 ? L"missing." + std::to_wstring(k % keys)
+                                        : L"ui.key." + std::to_wstring(k % keys));
+        }
+        Locale loc;
+        measure("locale.lookup", "ops/s", lookups, nullptr, [&]() {
+            size_t sink = 0;
+            for (int i = 0; i < lookups; ++i) {
+                sink += loc.L(probe[(size_t)i & 4095]).size();
+            }
+            return sink > 0;
+        });
+        BenchLocale::Reset();
+    }
+
+    // 4) Локаль: UTF-8 → wide для 1 МБ кириллицы × 16
+    if (Selected("locale.utf8")) {
+        std::string text;
+        while (text.size() < 1024 * 1024) text += "Сборка завершена успешно. ";
+        measure("locale.utf8", "MB/s", 16.0 * (double)text.size() / (1024.0 * 1024.0), nullptr, [&]() {
+            std::wstring out;
+            for (int i = 0; i < 16; ++i) {
+                if (!BenchLocale::Convert(text, out)) return false;
+            }
+            return !out.empty();
+        });
+    }
+
+    // 5) Упаковка синтетического ELF (8 МБ кода). Внешний упаковщик есть только под Windows
+    if (Selected("pack.elf")) {
+#ifndef _WIN32
+        results_.push_back({ "pack.elf", "MB/s", 0, 0, 0, 0, -1, true, false, "packer unavailable on this platform" });
+#else
+        fs::path elfPath = root / "bench.elf";
+        fs::path xexPath = root / "bench.xex";
+        const size_t textSize = 8 * 1024 * 1024;
+        if (!MakeElf(elfPath, textSize, 7)) {
+            results_.push_back({ "pack.elf", "MB/s", 0, 0, 0, 0, -1, false, true, "fixture generation failed" });
+        } else {
+            Packer packer;
+            measure("pack.elf", "MB/s", (double)textSize / (1024.0 * 1024.0),
+                    [&]() { std::error_code e; fs::remove(xexPath, e); },
+                    [&]() {
+                        std::wstring out, err;
+                        return packer.Pack(elfPath.wstring(), xexPath.wstring(), nullptr, out, err);
+                    });
+            if (results_.back().failed) results_.back().note = "packer failed";
+        }
+#endif
+    }
+
+    fs::remove_all(root, ec);
+    return true;
+}
+
+bool BenchSuite::WriteJson(const std::wstring& path) const {
+    json arr = json::array();
+    for (const auto& r : results_) {
+        json j = { {"name", r.name}, {"unit", r.unit}, {"skipped", r.skipped}, {"failed", r.failed} };
+        if (r.skipped || r.failed) {
+            j["note"] = r.note;
+        } else {
+            j["median_ms"]  = r.medianMs;
+            j["min_ms"]     = r.minMs;
+            j["max_ms"]     = r.maxMs;
+            j["throughput"] = r.throughput;
+            if (r.allocsPerUnit >= 0) j["allocs_per_unit"] = r.allocsPerUnit;
+        }
+        arr.push_back(j);
+    }
+    json doc = { {"version", 1}, {"repeats", config_.repeats}, {"results", arr} };
+    std::ofstream out{ fs::path(path), std::ios::binary | std::ios::trunc };
+    if (!out) return false;
+    out << doc.dump(2) << '\n';
+    return (bool)out;
+}
+
+bool BenchSuite::Compare(const std::wstring& baselinePath,
+                         const std::vector<BenchResult>& current,
+                         double thresholdPct,
+                         std::vector<BenchComparison>& out)
+{
+    out.clear();
+    json doc;
+    try {
+        std::ifstream in{ fs::path(baselinePath) };
+        if (!in) return false;
+        doc = json::parse(in);
+    } catch (...) {
+        return false;
+    }
+    if (!doc.contains("results") || !doc["results"].is_array()) return false;
+
+    for (const auto& r : current) {
+        if (r.skipped) continue;
+        if (r.failed) {
+            BenchComparison c;
+            c.name = r.name;
+            c.failed = true;
+            c.regression = true;
+            out.push_back(c);
+            continue;
+        }
+        for (const auto& b : doc["results"]) {
+            if (!b.is_object() || b.value("name", std::string()) != r.name) continue;
+            if (b.value("skipped", false) || b.value("failed", false) || !b.contains("median_ms")) break;
+            double base = b["median_ms"].get<double>();
+            if (base <= 0) break;
+            BenchComparison c;
+            c.name = r.name;
+            c.baselineMs = base;
+            c.currentMs = r.medianMs;
+            c.deltaPct = (r.medianMs - base) / base * 100.0;
+            c.regression = c.deltaPct > thresholdPct;
+            out.push_back(c);
+            break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,549 @@
+// src/build_cache.cpp
+#include "build_cache.h"
+#include "sha256.h"
+#include "metrics.h"
+#include "utf8.h"
+#include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Временный каталог Store моложе этого может ещё дописываться другим процессом
+static const auto STALE_TMP_AGE = std::chrono::hours(1);
+
+// Сколько списков заголовков помнит манифест действия (самые новые)
+static const size_t MANIFEST_LISTS = 16;
+
+static const wchar_t* MANIFEST_DIR = L"manifests";
+
+// Метрики кеша по всем экземплярам процесса
+struct CacheMetrics {
+    MetricCounter& hits      = Metrics::Counter("x360_cache_lookups_total", "Build cache lookups",
+                                                Metrics::Label("result", std::string("hit")));
+    MetricCounter& misses    = Metrics::Counter("x360_cache_lookups_total", "Build cache lookups",
+                                                Metrics::Label("result", std::string("miss")));
+    MetricCounter& stores    = Metrics::Counter("x360_cache_stores_total", "Entries added to the build cache");
+    MetricCounter& evictions = Metrics::Counter("x360_cache_evictions_total", "Entries evicted by LRU trimming");
+    MetricGauge& bytes       = Metrics::Gauge("x360_cache_bytes", "Current build cache size");
+};
+
+static CacheMetrics& CacheStats() {
+    static CacheMetrics m;
+    return m;
+}
+
+BuildCache::BuildCache(const BuildCacheConfig& config)
+    : config_(config)
+{
+}
+
+// Снимает read-only с файлов записи и удаляет её (на Windows remove_all не трогает read-only)
+static void RemoveEntryDir(const fs::path& dir) {
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        std::error_code ec2;
+        fs::permissions(it->path(), fs::perms::owner_write, fs::perm_options::add, ec2);
+    }
+    fs::remove_all(dir, ec);
+}
+
+std::string BuildCache::TempSuffix() {
+    // Случайная метка процесса: кеш общий, а id потоков в разных процессах совпадают
+    static const uint64_t process = ((uint64_t)std::random_device{}() << 32) ^ std::random_device{}();
+    static std::atomic<uint64_t> counter{0};
+    std::ostringstream s;
+    s << std::hex << process << "-" << std::hash<std::thread::id>{}(std::this_thread::get_id())
+      << "-" << counter.fetch_add(1);
+    return s.str();
+}
+
+std::wstring BuildCache::ManifestPath(const std::string& key) const {
+    return (fs::path(config_.root) / MANIFEST_DIR / std::wstring(key.begin(), key.end())).wstring();
+}
+
+std::wstring BuildCache::EntryDir(const std::string& key) const {
+    std::wstring shard(key.begin(), key.begin() + 2);
+    std::wstring name(key.begin(), key.end());
+    return (fs::path(config_.root) / shard / name).wstring();
+}
+
+bool BuildCache::Open() {
+    std::error_code ec;
+    fs::create_directories(config_.root, ec);
+    if (ec) return false;
+
+    struct Found { std::string key; uint64_t size; fs::file_time_type mtime; };
+    std::vector<Found> found;
+
+    for (auto& shard : fs::directory_iterator(config_.root, ec)) {
+        std::error_code ec2;
+        if (!shard.is_directory(ec2)) continue;
+        std::string shardName = shard.path().filename().string();
+        if (shard.path().filename() == MANIFEST_DIR) continue;
+        // Недописанные временные записи от прерванных Store. Возраст — по самому
+        // свежему файлу внутри: копирование большого выхода не трогает mtime каталога.
+        if (shardName.rfind("tmp-", 0) == 0) {
+            auto newest = fs::last_write_time(shard.path(), ec2);
+            for (auto& f : fs::directory_iterator(shard.path(), ec2)) {
+                std::error_code ec3;
+                newest = std::max(newest, fs::last_write_time(f.path(), ec3));
+            }
+            if (!ec2 && fs::file_time_type::clock::now() - newest > STALE_TMP_AGE) {
+                RemoveEntryDir(shard.path());
+            }
+            continue;
+        }
+        for (auto& entry : fs::directory_iterator(shard.path(), ec2)) {
+            std::error_code ec3;
+            if (!entry.is_directory(ec3)) continue;
+            uint64_t size = 0;
+            for (auto& f : fs::directory_iterator(entry.path(), ec3)) {
+                std::error_code ec4;
+                uint64_t s = f.file_size(ec4);
+                if (!ec4) size += s;
+            }
+            auto mtime = fs::last_write_time(entry.path(), ec3);
+            found.push_back({ entry.path().filename().string(), size, mtime });
+        }
+    }
+    // Восстанавливаем порядок LRU по времени последнего использования записи
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+        return a.mtime < b.mtime;
+    });
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    index_.clear();
+    totalBytes_ = 0;
+    for (auto& f : found) {
+        index_[f.key] = Entry{ f.size, ++clock_ };
+        totalBytes_ += f.size;
+    }
+    TrimLocked();
+    CacheStats().bytes.Set((int64_t)totalBytes_);
+    return true;
+}
+
+bool BuildCache::HashFileCached(const std::wstring& path, std::string& outHex) {
+    std::error_code ec;
+    uint64_t size = fs::file_size(path, ec);
+    if (ec) return false;
+    int64_t mtime = (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+    if (ec) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(hashMtx_);
+        auto it = hashMemo_.find(path);
+        if (it != hashMemo_.end() && it->second.size == size && it->second.mtime == mtime) {
+            outHex = it->second.hash;
+            return true;
+        }
+    }
+    if (!Sha256::HashFile(path, outHex)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(hashMtx_);
+    hashMemo_[path] = FileStamp{ size, mtime, outHex };
+    return true;
+}
+
+bool BuildCache::ReadDepFile(const std::wstring& path, std::vector<std::wstring>& deps) {
+    std::ifstream in(fs::path(path), std::ios::binary);
+    if (!in) return false;
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // Формат make: "obj.o: src.c a.h \<перевод строки> b.h"; пробел в имени — "\ ", "$$" — это "$"
+    std::vector<std::string> tokens;
+    std::string cur;
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '\\' && i + 1 < text.size()) {
+            char n = text[i + 1];
+            if (n == '\n' || n == '\r') {
+                ++i;
+                if (n == '\r' && i + 1 < text.size() && text[i + 1] == '\n') ++i;
+                c = ' ';
+            } else if (n == ' ' || n == '#') {
+                cur.push_back(n);
+                ++i;
+                continue;
+            }
+        } else if (c == '$' && i + 1 < text.size() && text[i + 1] == '$') {
+            cur.push_back('$');
+            ++i;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            if (!cur.empty()) tokens.push_back(std::move(cur));
+            cur.clear();
+        } else {
+            cur.push_back(c);
+        }
+    }
+    if (!cur.empty()) tokens.push_back(std::move(cur));
+
+    // Цели (оканчиваются на ':') пропускаем; "a.h:" из -MP тоже не зависимость
+    for (auto& t : tokens) {
+        if (t.back() == ':') continue;
+        std::u8string u8(t.begin(), t.end());
+        deps.push_back(fs::path(u8).wstring());
+    }
+    return true;
+}
+
+bool BuildCache::ManifestKey(const ActionDesc& action, std::string& outKey) {
+    // Каждое поле пишется с тегом и длиной, чтобы разные наборы не давали одинаковый поток
+    Sha256 h;
+    auto putField = [&h](const char* tag, const void* data, size_t size) {
+        h.Update(tag, 4);
+        uint64_t len = size;
+        h.Update(&len, sizeof(len));
+        h.Update(data, size);
+    };
+    auto putFile = [&](const char* tag, const std::wstring& path) {
+        std::string fileHash;
+        if (!HashFileCached(path, fileHash)) return false;
+        putField(tag, fileHash.data(), fileHash.size());
+        return true;
+    };
+
+    if (!putFile("TOOL", action.tool)) return false;
+    for (const auto& a : action.args) {
+        putField("ARG_", a.data(), a.size() * sizeof(wchar_t));
+    }
+    // Путь входа тоже часть ключа: __FILE__, отладочная информация и поиск
+    // заголовков "рядом с исходником" зависят от него, а не только от содержимого
+    for (const auto& in : action.inputs) {
+        putField("INP_", in.data(), in.size() * sizeof(wchar_t));
+        if (!putFile("IN__", in)) return false;
+    }
+    for (const auto& in : action.extraInputs) {
+        putField("EXP_", in.data(), in.size() * sizeof(wchar_t));
+        if (!putFile("EXT_", in)) return false;
+    }
+    for (const auto& out : action.outputs) {
+        putField("OUT_", out.data(), out.size() * sizeof(wchar_t));
+    }
+    // Действие с depFile и без него — разные пространства ключей
+    if (!action.depFile.empty()) putField("DEPF", action.depFile.data(), action.depFile.size() * sizeof(wchar_t));
+    outKey = h.FinalHex();
+    return true;
+}
+
+bool BuildCache::FinalKey(const std::string& manifestKey, const std::vector<std::wstring>& deps,
+                          std::string& outKey)
+{
+    Sha256 h;
+    h.Update("MANI", 4);
+    h.Update(manifestKey);
+    for (const auto& d : deps) {
+        std::string fileHash;
+        if (!HashFileCached(d, fileHash)) return false;   // заголовок исчез — список не подходит
+        std::string path = WStringToUtf8(d);
+        uint64_t len = path.size();
+        h.Update("HDR_", 4);
+        h.Update(&len, sizeof(len));
+        h.Update(path);
+        h.Update(fileHash);
+    }
+    outKey = h.FinalHex();
+    return true;
+}
+
+// Манифест: UTF-8, путь на строку, списки разделены пустой строкой, новые — первыми
+bool BuildCache::ReadManifest(const std::string& manifestKey, std::vector<std::vector<std::wstring>>& lists) {
+    std::ifstream in(fs::path(ManifestPath(manifestKey)), std::ios::binary);
+    if (!in) return false;
+    std::vector<std::wstring> cur;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) {
+            if (!cur.empty()) lists.push_back(std::move(cur));
+            cur.clear();
+        } else {
+            cur.push_back(Utf8ToWString(line));
+        }
+    }
+    if (!cur.empty()) lists.push_back(std::move(cur));
+    return true;
+}
+
+bool BuildCache::AddToManifest(const std::string& manifestKey, const std::vector<std::wstring>& deps) {
+    std::lock_guard<std::mutex> lock(manifestMtx_);
+    std::vector<std::vector<std::wstring>> lists;
+    ReadManifest(manifestKey, lists);
+    lists.erase(std::remove(lists.begin(), lists.end(), deps), lists.end());
+    lists.insert(lists.begin(), deps);
+    if (lists.size() > MANIFEST_LISTS) lists.resize(MANIFEST_LISTS);
+
+    // Другой процесс может переписать манифест одновременно: переименование атомарно,
+    // поэтому теряется в худшем случае его список, а не весь файл
+    fs::path path = ManifestPath(manifestKey);
+    fs::path tmp = path;
+    tmp += L".tmp-" + Utf8ToWString(TempSuffix());
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        for (const auto& list : lists) {
+            for (const auto& d : list) out << WStringToUtf8(d) << '\n';
+            out << '\n';
+        }
+        if (!out.good()) {
+            out.close();
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool BuildCache::ComputeKey(const ActionDesc& action, std::string& outKey) {
+    std::string manifestKey;
+    if (!ManifestKey(action, manifestKey)) return false;
+    outKey = manifestKey;
+    if (action.depFile.empty()) return true;
+
+    // Заголовки, найденные компилятором в прошлых сборках: первый список, чья запись
+    // лежит в кеше при нынешнем содержимом заголовков, даёт ключ
+    std::vector<std::vector<std::wstring>> lists;
+    ReadManifest(manifestKey, lists);
+    for (const auto& deps : lists) {
+        std::string key;
+        if (!FinalKey(manifestKey, deps, key)) continue;
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (index_.count(key)) {
+            outKey = key;
+            return true;
+        }
+    }
+    return true;
+}
+
+// reflink: CoW-копия, безопасна для последующей перезаписи на месте. false — ФС не умеет.
+static bool Reflink(const std::wstring& from, const std::wstring& to) {
+#if defined(__linux__) && defined(FICLONE)
+    int src = open(fs::path(from).c_str(), O_RDONLY | O_CLOEXEC);
+    if (src < 0) return false;
+    int dst = open(fs::path(to).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool cloned = false;
+    if (dst >= 0) {
+        cloned = ioctl(dst, FICLONE, src) == 0;
+        close(dst);
+    }
+    close(src);
+    if (cloned) return true;
+    std::error_code ec;
+    fs::remove(to, ec);
+#else
+    (void)from;
+    (void)to;
+#endif
+    return false;
+}
+
+bool BuildCache::Materialize(const std::wstring& from, const std::wstring& to) {
+    std::error_code ec;
+    fs::remove(to, ec);
+    fs::create_directories(fs::path(to).parent_path(), ec);
+    if (Reflink(from, to)) return true;
+
+    ec.clear();
+    fs::create_hard_link(from, to, ec);
+    if (!ec) return true;
+
+    // Другой том или ФС без жёстких ссылок — обычное копирование
+    ec.clear();
+    fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+    if (ec) return false;
+    fs::permissions(to, fs::perms::owner_write, fs::perm_options::add, ec);
+    return true;
+}
+
+bool BuildCache::CloneFile(const std::wstring& from, const std::wstring& to) {
+    std::error_code ec;
+    fs::remove(to, ec);
+    fs::create_directories(fs::path(to).parent_path(), ec);
+    if (Reflink(from, to)) return true;
+
+    ec.clear();
+    fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+    if (ec) return false;
+    fs::permissions(to, fs::perms::owner_write, fs::perm_options::add, ec);
+    return true;
+}
+
+bool BuildCache::Restore(const std::string& key, const std::vector<std::wstring>& outputs) {
+    if (key.size() < 2) return false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            CacheStats().misses.Add();
+            return false;
+        }
+        it->second.lastUse = ++clock_;
+    }
+
+    fs::path dir = EntryDir(key);
+    std::error_code ec;
+    fs::last_write_time(dir, fs::file_time_type::clock::now(), ec);
+
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        fs::path src = dir / std::to_wstring(i);
+        if (!fs::exists(src, ec) || !Materialize(src.wstring(), outputs[i])) {
+            // Запись повреждена: выбрасываем её, чтобы следующий Store её переписал
+            RemoveOutputs(outputs);
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                auto it = index_.find(key);
+                if (it != index_.end()) {
+                    totalBytes_ -= std::min(totalBytes_, it->second.size);
+                    index_.erase(it);
+                }
+            }
+            RemoveEntryDir(dir);
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            CacheStats().misses.Add();
+            return false;
+        }
+    }
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    CacheStats().hits.Add();
+    return true;
+}
+
+bool BuildCache::Store(const std::string& key, const std::vector<std::wstring>& outputs) {
+    if (key.size() < 2) return false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (index_.count(key)) return true;
+    }
+
+    // Пишем во временный каталог и переименовываем целиком: запись либо полная, либо её нет
+    fs::path tmp = fs::path(config_.root) / Utf8ToWString("tmp-" + key + "-" + TempSuffix());
+    fs::path dir = EntryDir(key);
+
+    std::error_code ec;
+    RemoveEntryDir(tmp);
+    fs::create_directories(tmp, ec);
+    if (ec) return false;
+
+    uint64_t size = 0;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        fs::path dst = tmp / std::to_wstring(i);
+        fs::copy_file(outputs[i], dst, ec);
+        if (ec) {
+            RemoveEntryDir(tmp);
+            return false;
+        }
+        size += fs::file_size(dst, ec);
+        // Записи только для чтения: жёсткая ссылка на них не даст испортить кеш записью на месте
+        fs::permissions(dst, fs::perms::owner_write | fs::perms::group_write | fs::perms::others_write,
+                        fs::perm_options::remove, ec);
+    }
+
+    fs::create_directories(dir.parent_path(), ec);
+    fs::rename(tmp, dir, ec);
+    if (ec) {
+        // Параллельный Store того же ключа успел первым — его запись равнозначна
+        RemoveEntryDir(tmp);
+        return fs::exists(dir);
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    index_[key] = Entry{ size, ++clock_ };
+    totalBytes_ += size;
+    stores_.fetch_add(1, std::memory_order_relaxed);
+    CacheStats().stores.Add();
+    TrimLocked();
+    CacheStats().bytes.Set((int64_t)totalBytes_);
+    return true;
+}
+
+bool BuildCache::Store(const ActionDesc& action, const std::vector<std::wstring>& outputs,
+                       std::string* outKey)
+{
+    std::string manifestKey, key;
+    if (!ManifestKey(action, manifestKey)) return false;
+    key = manifestKey;
+    if (!action.depFile.empty()) {
+        // depfile свежий — от только что отработавшего инструмента, так что список
+        // включает и заголовки, добавленные в этой правке
+        std::vector<std::wstring> deps;
+        if (!ReadDepFile(action.depFile, deps)) return false;
+        std::sort(deps.begin(), deps.end());
+        deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+        if (!FinalKey(manifestKey, deps, key)) return false;
+        if (!Store(key, outputs)) return false;
+        AddToManifest(manifestKey, deps);
+    } else if (!Store(key, outputs)) {
+        return false;
+    }
+    if (outKey) *outKey = key;
+    return true;
+}
+
+void BuildCache::RemoveOutputs(const std::vector<std::wstring>& outputs) {
+    for (const auto& out : outputs) {
+        std::error_code ec;
+        fs::remove(out, ec);
+    }
+}
+
+void BuildCache::Trim() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    TrimLocked();
+    CacheStats().bytes.Set((int64_t)totalBytes_);
+}
+
+void BuildCache::TrimLocked() {
+    if (totalBytes_ <= config_.maxBytes) return;
+
+    std::vector<std::pair<uint64_t, std::string>> byAge;
+    byAge.reserve(index_.size());
+    for (const auto& [key, e] : index_) {
+        byAge.emplace_back(e.lastUse, key);
+    }
+    std::sort(byAge.begin(), byAge.end());
+
+    for (const auto& [lastUse, key] : byAge) {
+        if (totalBytes_ <= config_.maxBytes) break;
+        auto it = index_.find(key);
+        totalBytes_ -= std::min(totalBytes_, it->second.size);
+        index_.erase(it);
+        RemoveEntryDir(EntryDir(key));
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+        CacheStats().evictions.Add();
+    }
+}
+
+BuildCacheStats BuildCache::Stats() const {
+    BuildCacheStats s;
+    s.hits      = hits_.load(std::memory_order_relaxed);
+    s.misses    = misses_.load(std::memory_order_relaxed);
+    s.stores    = stores_.load(std::memory_order_relaxed);
+    s.evictions = evictions_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mtx_);
+    s.bytes = totalBytes_;
+    return s;
+}
@@ -0,0 +1,466 @@
+// src/build_daemon.cpp
+#include "build_daemon.h"
+#include "utf8.h"
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace fs = std::filesystem;
+
+#if defined(__linux__)
+
+static bool WriteAll(int fd, const std::string& data) {
+    size_t off = 0;
+    while (off < data.size()) {
+        ssize_t n = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        off += (size_t)n;
+    }
+    return true;
+}
+
+// Читает одну строку без '\n'. pending хранит прочитанное сверх строки.
+static bool ReadLine(int fd, std::string& pending, std::string& line) {
+    const size_t MAX_LINE = 64 * 1024;
+    while (true) {
+        size_t pos = pending.find('\n');
+        if (pos != std::string::npos) {
+            line = pending.substr(0, pos);
+            pending.erase(0, pos + 1);
+            return true;
+        }
+        if (pending.size() > MAX_LINE) return false;
+        char buf[4096];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        pending.append(buf, (size_t)n);
+    }
+}
+
+static int ConnectUnix(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+BuildDaemon::BuildDaemon(const BuildDaemonConfig& config)
+    : config_(config)
+{
+}
+
+BuildDaemon::~BuildDaemon() {
+    Stop();
+}
+
+bool BuildDaemon::Start() {
+    if (running_.load(std::memory_order_acquire) || !config_.build) return false;
+
+    sockaddr_un addr{};
+    if (config_.socketPath.empty() || config_.socketPath.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    // Если на сокете уже кто-то отвечает — второй демон не запускаем
+    int probe = ConnectUnix(config_.socketPath);
+    if (probe >= 0) {
+        close(probe);
+        return false;
+    }
+    unlink(config_.socketPath.c_str());
+
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) return false;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, config_.socketPath.c_str(), config_.socketPath.size() + 1);
+    // Права ставим между bind и listen: до listen подключиться к сокету нельзя,
+    // так что окна с правами по umask нет
+    if (bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+        chmod(config_.socketPath.c_str(), 0600) != 0 || listen(listenFd_, 16) != 0)
+    {
+        close(listenFd_);
+        listenFd_ = -1;
+        unlink(config_.socketPath.c_str());
+        return false;
+    }
+
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0) {
+        close(listenFd_);
+        listenFd_ = -1;
+        unlink(config_.socketPath.c_str());
+        return false;
+    }
+
+    running_.store(true, std::memory_order_release);
+    acceptThread_ = std::thread(&BuildDaemon::AcceptThread, this);
+    watchThread_  = std::thread(&BuildDaemon::WatchThread, this);
+    return true;
+}
+
+void BuildDaemon::RequestStop() {
+    {
+        std::lock_guard<std::mutex> lock(waitMtx_);
+        running_.store(false, std::memory_order_release);
+    }
+    waitCv_.notify_all();
+    // Запросы, ждущие чужую сборку, отвечают FAIL и не держат Stop
+    { std::lock_guard<std::mutex> lock(stateMtx_); }
+    stateCv_.notify_all();
+    // Будим accept(): после shutdown он вернёт ошибку
+    if (listenFd_ >= 0) shutdown(listenFd_, SHUT_RDWR);
+}
+
+void BuildDaemon::Wait(std::stop_token stop) {
+    std::stop_callback onStop(stop, [this]() {
+        { std::lock_guard<std::mutex> lock(waitMtx_); }
+        waitCv_.notify_all();
+    });
+    std::unique_lock<std::mutex> lock(waitMtx_);
+    waitCv_.wait(lock, [this, &stop]() {
+        return !running_.load(std::memory_order_acquire) || stop.stop_requested();
+    });
+}
+
+void BuildDaemon::Stop() {
+    RequestStop();
+    if (acceptThread_.joinable()) acceptThread_.join();
+    if (watchThread_.joinable())  watchThread_.join();
+    {
+        std::lock_guard<std::mutex> lock(clientsMtx_);
+        // Клиент может висеть в recv() на недописанной команде — shutdown будит его
+        for (auto& c : clients_) shutdown(c.fd, SHUT_RDWR);
+        for (auto& c : clients_) {
+            if (c.thread.joinable()) c.thread.join();
+            close(c.fd);
+        }
+        clients_.clear();
+    }
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+        listenFd_ = -1;
+        unlink(config_.socketPath.c_str());
+    }
+    if (inotifyFd_ >= 0) {
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+}
+
+void BuildDaemon::AcceptThread() {
+    while (running_.load(std::memory_order_acquire)) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(clientsMtx_);
+        // Подбираем завершившиеся соединения, чтобы список не рос бесконечно
+        for (auto it = clients_.begin(); it != clients_.end();) {
+            if (it->done->load(std::memory_order_acquire)) {
+                it->thread.join();
+                close(it->fd);
+                it = clients_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        std::thread th([this, fd, done]() {
+            HandleClient(fd);
+            done->store(true, std::memory_order_release);
+        });
+        clients_.push_back(Client{ std::move(th), done, fd });
+    }
+}
+
+void BuildDaemon::AddWatch(const std::wstring& key, const std::string& dir) {
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                          IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+    int wd = inotify_add_watch(inotifyFd_, dir.c_str(), mask);
+    if (wd < 0) {
+        // Кончились inotify-watches — без слежения цель всегда считается грязной
+        auto it = targets_.find(key);
+        if (it != targets_.end()) it->second.watched = false;
+        return;
+    }
+    watchOwner_[wd] = key;
+    watchDir_[wd] = dir;
+}
+
+void BuildDaemon::WatchTree(const std::wstring& key, const std::string& root) {
+    AddWatch(key, root);
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        std::error_code ec2;
+        if (it->is_directory(ec2) && !it->is_symlink(ec2)) {
+            AddWatch(key, it->path().string());
+        }
+    }
+}
+
+void BuildDaemon::MarkDirty(int wd, bool all) {
+    if (all) {
+        for (auto& [key, t] : targets_) {
+            t.dirty = true;
+            ++t.changes;
+        }
+        return;
+    }
+    auto it = watchOwner_.find(wd);
+    if (it == watchOwner_.end()) return;
+    auto t = targets_.find(it->second);
+    if (t != targets_.end()) {
+        t->second.dirty = true;
+        ++t->second.changes;
+    }
+}
+
+void BuildDaemon::DrainEvents() {
+    alignas(inotify_event) char buf[16 * 1024];
+    while (true) {
+        // inotifyFd_ неблокирующий: пустая очередь даёт EAGAIN
+        ssize_t len = read(inotifyFd_, buf, sizeof(buf));
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) return;
+
+        for (char* p = buf; p < buf + len;) {
+            auto* ev = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                MarkDirty(-1, true);
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                watchOwner_.erase(ev->wd);
+                watchDir_.erase(ev->wd);
+                continue;
+            }
+            MarkDirty(ev->wd, false);
+
+            // Новый подкаталог тоже ставим под наблюдение
+            if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) && (ev->mask & IN_ISDIR) && ev->len > 0) {
+                auto dir = watchDir_.find(ev->wd);
+                auto owner = watchOwner_.find(ev->wd);
+                if (dir != watchDir_.end() && owner != watchOwner_.end()) {
+                    WatchTree(owner->second, dir->second + "/" + ev->name);
+                }
+            }
+        }
+    }
+}
+
+void BuildDaemon::WatchThread() {
+    while (running_.load(std::memory_order_acquire)) {
+        pollfd pfd{ inotifyFd_, POLLIN, 0 };
+        int r = poll(&pfd, 1, 100);
+        if (r <= 0) continue;
+
+        std::lock_guard<std::mutex> lock(stateMtx_);
+        DrainEvents();
+    }
+}
+
+bool BuildDaemon::RunBuild(int fd, const DaemonRequest& request) {
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [&start]() {
+        return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::wstring key;
+    std::shared_ptr<RunningBuild> mine;
+    if (!request.online) {
+        std::error_code ec;
+        fs::path can = fs::weakly_canonical(fs::path(request.input), ec);
+        if (ec || !fs::is_directory(can, ec)) {
+            WriteAll(fd, "LOG source directory not found\nFAIL " + std::to_string(elapsedMs()) + "\n");
+            return false;
+        }
+        key = can.wstring();
+
+        std::unique_lock<std::mutex> lock(stateMtx_);
+        while (true) {
+            // События правок, сделанных клиентом до запроса, уже в очереди inotify,
+            // но WatchThread мог ещё не проснуться: разбираем их здесь, до проверки dirty
+            DrainEvents();
+            auto it = targets_.find(key);
+            if (it == targets_.end()) {
+                it = targets_.emplace(key, Target{}).first;
+                WatchTree(key, can.string());
+            }
+            Target& t = it->second;
+            if (t.running) {
+                std::shared_ptr<RunningBuild> other = t.running;
+                // Дерево не менялось после старта идущей сборки — её результат и есть наш
+                bool join = !request.force && t.watched && t.changes == other->changesAtStart;
+                if (join) WriteAll(fd, "LOG joined a running build\n");
+                stateCv_.wait(lock, [&]() {
+                    return other->done || !running_.load(std::memory_order_acquire);
+                });
+                if (!other->done) {
+                    WriteAll(fd, "FAIL " + std::to_string(elapsedMs()) + "\n");
+                    return false;
+                }
+                if (join) {
+                    WriteAll(fd, (other->ok ? "OK " : "FAIL ") + std::to_string(elapsedMs()) + "\n");
+                    return other->ok;
+                }
+                continue;   // дерево менялось: после чужой сборки решаем заново
+            }
+            if (!t.dirty && t.watched && !request.force) {
+                // Тёплый no-op: с последней успешной сборки дерево не трогали
+                WriteAll(fd, "LOG up-to-date, nothing to build\nOK " + std::to_string(elapsedMs()) + " up-to-date\n");
+                return true;
+            }
+            mine = std::make_shared<RunningBuild>();
+            mine->changesAtStart = t.changes;
+            t.running = mine;
+            break;
+        }
+    }
+
+    bool ok = false;
+    {
+        std::lock_guard<std::mutex> lock(buildMtx_);
+        // Лог могут писать и сборка, и поток логгера: строки не должны перемешиваться
+        std::mutex logMtx;
+        auto log = [fd, &logMtx](const std::wstring& line) {
+            std::lock_guard<std::mutex> logLock(logMtx);
+            WriteAll(fd, "LOG " + WStringToUtf8(line) + "\n");
+        };
+        try {
+            ok = config_.build(request, log);
+        } catch (...) {
+            ok = false;
+        }
+    }
+
+    if (mine) {
+        std::lock_guard<std::mutex> lock(stateMtx_);
+        DrainEvents();
+        Target& t = targets_[key];
+        // Чистой цель становится только после успеха и без правок во время сборки
+        if (ok && t.changes == mine->changesAtStart) t.dirty = false;
+        mine->done = true;
+        mine->ok = ok;
+        t.running.reset();
+    }
+    if (mine) stateCv_.notify_all();
+    WriteAll(fd, (ok ? "OK " : "FAIL ") + std::to_string(elapsedMs()) + "\n");
+    return ok;
+}
+
+// Только процессы того же пользователя, что и демон
+static bool SameUser(int fd) {
+    ucred cred{};
+    socklen_t len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == geteuid();
+}
+
+void BuildDaemon::HandleClient(int fd) {
+    std::string pending, line;
+    if (!SameUser(fd)) {
+        WriteAll(fd, "FAIL 0\n");
+    } else if (ReadLine(fd, pending, line)) {
+        if (line == "SHUTDOWN") {
+            WriteAll(fd, "BYE\n");
+            RequestStop();
+        } else if (line == "STATUS") {
+            std::lock_guard<std::mutex> lock(stateMtx_);
+            WriteAll(fd, "TARGETS " + std::to_string(targets_.size()) +
+                         " WATCHES " + std::to_string(watchOwner_.size()) + "\n");
+        } else if (line.rfind("BUILD ", 0) == 0) {
+            DaemonRequest req;
+            std::string rest = line.substr(6);
+            if (rest.rfind("online ", 0) == 0) {
+                req.online = true;
+                rest = rest.substr(7);
+            } else if (rest.rfind("offline ", 0) == 0) {
+                rest = rest.substr(8);
+            } else {
+                WriteAll(fd, "FAIL 0\n");
+                rest.clear();
+            }
+            if (rest.rfind("force ", 0) == 0) {
+                req.force = true;
+                rest = rest.substr(6);
+            }
+            if (!rest.empty()) {
+                req.input = Utf8ToWString(rest);
+                RunBuild(fd, req);
+            }
+        } else {
+            WriteAll(fd, "FAIL 0\n");
+        }
+    }
+    // fd закрывает владелец списка clients_ после join: иначе Stop мог бы сделать
+    // shutdown уже чужого дескриптора с тем же номером
+}
+
+int DaemonSubmit(const std::string& socketPath,
+                 const DaemonRequest& request,
+                 const std::function<void(const std::wstring&)>& onLine)
+{
+    int fd = ConnectUnix(socketPath);
+    if (fd < 0) return 2;
+
+    std::string cmd = std::string("BUILD ") + (request.online ? "online " : "offline ") +
+                      (request.force ? "force " : "") + WStringToUtf8(request.input) + "\n";
+    if (!WriteAll(fd, cmd)) {
+        close(fd);
+        return 2;
+    }
+
+    int rc = 2;
+    std::string pending, line;
+    while (ReadLine(fd, pending, line)) {
+        if (line.rfind("LOG ", 0) == 0) {
+            if (onLine) onLine(Utf8ToWString(line.substr(4)));
+        } else if (line.rfind("OK ", 0) == 0) {
+            rc = 0;
+            break;
+        } else if (line.rfind("FAIL", 0) == 0) {
+            rc = 1;
+            break;
+        }
+    }
+    close(fd);
+    return rc;
+}
+
+#else
+
+BuildDaemon::BuildDaemon(const BuildDaemonConfig& config) : config_(config) {}
+BuildDaemon::~BuildDaemon() = default;
+bool BuildDaemon::Start() { return false; }
+void BuildDaemon::Wait(std::stop_token) {}
+void BuildDaemon::Stop() {}
+
+int DaemonSubmit(const std::string&, const DaemonRequest&,
+                 const std::function<void(const std::wstring&)>&)
+{
+    return 2;
+}
+
+#endif
@@ -0,0 +1,381 @@
+// src/build_graph.cpp
+#include "build_graph.h"
+#include "trace.h"
+#include "resource_governor.h"
+#include "metrics.h"
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+using namespace std::chrono;
+
+// Как часто воркер повторяет допуск, если ни одна резервация не освободилась:
+// свободная память и PSI меняются и без нас
+static const int kAdmissionRetryMs = 100;
+
+NodeId BuildGraph::AddNode(BuildStage stage,
+                           const std::wstring& name,
+                           std::function<bool()> action,
+                           uint64_t cost)
+{
+    BuildNode node;
+    node.name   = name;
+    node.stage  = stage;
+    node.cost   = cost > 0 ? cost : 1;
+    node.action = std::move(action);
+    nodes_.push_back(std::move(node));
+    return nodes_.size() - 1;
+}
+
+bool BuildGraph::AddDependency(NodeId node, NodeId dependsOn) {
+    if (node >= nodes_.size() || dependsOn >= nodes_.size() || node == dependsOn) {
+        return false;
+    }
+    auto& deps = nodes_[node].deps;
+    if (std::find(deps.begin(), deps.end(), dependsOn) != deps.end()) {
+        return true;
+    }
+    deps.push_back(dependsOn);
+    nodes_[dependsOn].dependents.push_back(node);
+    return true;
+}
+
+bool BuildGraph::SetResources(NodeId node, const ResourceRequest& resources) {
+    if (node >= nodes_.size()) return false;
+    nodes_[node].resources = resources;
+    return true;
+}
+
+bool BuildGraph::Finalize() {
+    // Алгоритм Кана: топологический порядок + обнаружение цикла
+    std::vector<size_t> inDegree(nodes_.size());
+    std::vector<NodeId> order;
+    order.reserve(nodes_.size());
+    for (NodeId i = 0; i < nodes_.size(); ++i) {
+        inDegree[i] = nodes_[i].deps.size();
+        if (inDegree[i] == 0) order.push_back(i);
+    }
+    for (size_t head = 0; head < order.size(); ++head) {
+        for (NodeId d : nodes_[order[head]].dependents) {
+            if (--inDegree[d] == 0) order.push_back(d);
+        }
+    }
+    if (order.size() != nodes_.size()) {
+        return false;
+    }
+
+    // Приоритет = стоимость самого длинного пути от узла до стока
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        BuildNode& n = nodes_[*it];
+        uint64_t tail = 0;
+        for (NodeId d : n.dependents) {
+            tail = std::max(tail, nodes_[d].priority);
+        }
+        n.priority = n.cost + tail;
+    }
+    return true;
+}
+
+static const char* StageName(BuildStage stage) {
+    switch (stage) {
+        case BuildStage::Download: return "download";
+        case BuildStage::Extract:  return "extract";
+        case BuildStage::Compile:  return "compile";
+        case BuildStage::Link:     return "link";
+        case BuildStage::Pack:     return "pack";
+        default:                   return "node";
+    }
+}
+
+// Метрики планировщика: время узлов по стадиям, исходы, ожидание допуска
+struct SchedulerMetrics {
+    MetricHistogram* nodeSeconds[5];
+    MetricCounter& ok      = Metrics::Counter("x360_build_nodes_total", "Finished build graph nodes",
+                                              Metrics::Label("result", std::string("ok")));
+    MetricCounter& failed  = Metrics::Counter("x360_build_nodes_total", "Finished build graph nodes",
+                                              Metrics::Label("result", std::string("failed")));
+    MetricCounter& skipped = Metrics::Counter("x360_build_nodes_total", "Finished build graph nodes",
+                                              Metrics::Label("result", std::string("skipped")));
+    MetricGauge& running   = Metrics::Gauge("x360_build_nodes_running", "Build graph nodes executing now");
+    MetricHistogram& admissionWait = Metrics::Histogram(
+        "x360_build_admission_wait_seconds", "Time a ready node waits for its resource reservation", 1e-6);
+
+    SchedulerMetrics() {
+        const BuildStage stages[5] = { BuildStage::Download, BuildStage::Extract, BuildStage::Compile,
+                                       BuildStage::Link, BuildStage::Pack };
+        for (int i = 0; i < 5; ++i) {
+            nodeSeconds[i] = &Metrics::Histogram("x360_build_node_seconds", "Build action duration by stage",
+                                                 1e-6, Metrics::Label("stage", std::string(StageName(stages[i]))));
+        }
+    }
+};
+
+static SchedulerMetrics& BuildMetrics() {
+    static SchedulerMetrics m;
+    return m;
+}
+
+BuildScheduler::BuildScheduler(const SchedulerConfig& config)
+    : config_(config)
+{
+}
+
+void BuildScheduler::Cancel() {
+    stop_.store(true, std::memory_order_release);
+    WakeWorkers(true);
+}
+
+bool BuildScheduler::Finished() const {
+    if (remaining_.load(std::memory_order_acquire) == 0) return true;
+    return stop_.load(std::memory_order_acquire) &&
+           running_.load(std::memory_order_acquire) == 0;
+}
+
+void BuildScheduler::WakeWorkers(bool all) {
+    // Берём мьютекс, чтобы не потерять пробуждение между проверкой предиката и wait
+    { std::lock_guard<std::mutex> lock(waitMtx_); }
+    if (all) cv_.notify_all();
+    else     cv_.notify_one();
+}
+
+// Резервация ресурсов узла без ожидания. Узлу без governor или без ресурсов допуск не нужен.
+bool BuildScheduler::Admit(NodeId id, ResourceLease& lease) {
+    const ResourceRequest& resources = graph_->Node(id).resources;
+    if (!config_.governor || resources.Empty()) return true;
+    lease = config_.governor->TryAcquire(resources);
+    return (bool)lease;
+}
+
+bool BuildScheduler::PopLocal(size_t self, NodeId& out, ResourceLease& lease) {
+    WorkerQueue& q = *queues_[self];
+    std::lock_guard<std::mutex> lock(q.mtx);
+    // С хвоста к голове: первым берётся самый приоритетный узел, который влезает сейчас
+    for (auto it = q.items.rbegin(); it != q.items.rend(); ++it) {
+        if (!Admit(*it, lease)) continue;
+        out = *it;
+        q.items.erase(std::next(it).base());
+        queued_.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+    return false;
+}
+
+bool BuildScheduler::Steal(size_t self, NodeId& out, ResourceLease& lease) {
+    const size_t n = queues_.size();
+    for (size_t k = 1; k < n; ++k) {
+        WorkerQueue& q = *queues_[(self + k) % n];
+        std::lock_guard<std::mutex> lock(q.mtx);
+        // Воруем с головы: владелец в это время работает с хвостом своей деки
+        for (auto it = q.items.begin(); it != q.items.end(); ++it) {
+            if (!Admit(*it, lease)) continue;
+            out = *it;
+            q.items.erase(it);
+            queued_.fetch_sub(1, std::memory_order_acq_rel);
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void BuildScheduler::PushReady(size_t self, std::vector<NodeId>& ready) {
+    if (ready.empty()) return;
+    // Хвост деки забирается первым, поэтому кладём по возрастанию приоритета
+    std::sort(ready.begin(), ready.end(), [this](NodeId a, NodeId b) {
+        return graph_->Node(a).priority < graph_->Node(b).priority;
+    });
+    {
+        WorkerQueue& q = *queues_[self];
+        std::lock_guard<std::mutex> lock(q.mtx);
+        auto now = steady_clock::now();
+        for (NodeId id : ready) {
+            state_[id].store((int)NodeState::Ready, std::memory_order_release);
+            readyAt_[id] = now;
+            q.items.push_back(id);
+        }
+        queued_.fetch_add(ready.size(), std::memory_order_acq_rel);
+    }
+    admissionEpoch_.fetch_add(1, std::memory_order_acq_rel);
+    // Один узел воркер выполнит сам, остальное пусть разбирают соседи
+    if (ready.size() > 1) WakeWorkers(true);
+}
+
+void BuildScheduler::FinishNode() {
+    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        WakeWorkers(true);
+    }
+}
+
+void BuildScheduler::SkipDependents(NodeId id) {
+    std::vector<NodeId> stack(graph_->Node(id).dependents);
+    while (!stack.empty()) {
+        NodeId d = stack.back();
+        stack.pop_back();
+        int expected = (int)NodeState::Pending;
+        if (!state_[d].compare_exchange_strong(expected, (int)NodeState::Skipped,
+                                               std::memory_order_acq_rel)) {
+            continue;
+        }
+        BuildMetrics().skipped.Add();
+        FinishNode();
+        const auto& next = graph_->Node(d).dependents;
+        stack.insert(stack.end(), next.begin(), next.end());
+    }
+}
+
+// lease — резервация, полученная при снятии узла с деки (пустая, если ресурсы не нужны)
+void BuildScheduler::Execute(size_t self, NodeId id, ResourceLease lease) {
+    const BuildNode& node = graph_->Node(id);
+    state_[id].store((int)NodeState::Running, std::memory_order_release);
+    running_.fetch_add(1, std::memory_order_acq_rel);
+    SchedulerMetrics& metrics = BuildMetrics();
+    if (lease) {
+        metrics.admissionWait.Record(
+            (uint64_t)duration_cast<microseconds>(steady_clock::now() - readyAt_[id]).count());
+    }
+
+    bool ok = false;
+    metrics.running.Add(1);
+    auto runStart = steady_clock::now();
+    {
+        TRACE_SCOPE("build", StageName(node.stage), node.name);
+        // Вложенные Acquire действия (Unzip, загрузки) делят резервацию узла, а не ждут её
+        ResourceLease::Scope leaseScope(lease);
+        try {
+            ok = node.action ? node.action() : true;
+        } catch (...) {
+            ok = false;
+        }
+    }
+    if (lease) {
+        lease.Release();
+        // Освободившиеся ресурсы могут пропустить узлы, которые не влезли раньше
+        admissionEpoch_.fetch_add(1, std::memory_order_acq_rel);
+        if (queued_.load(std::memory_order_acquire) > 0) WakeWorkers(true);
+    }
+    metrics.running.Add(-1);
+    size_t stageIndex = std::min<size_t>((size_t)node.stage, 4);
+    metrics.nodeSeconds[stageIndex]->Record(
+        (uint64_t)duration_cast<microseconds>(steady_clock::now() - runStart).count());
+    (ok ? metrics.ok : metrics.failed).Add();
+
+    if (ok) {
+        state_[id].store((int)NodeState::Done, std::memory_order_release);
+        completed_.fetch_add(1, std::memory_order_relaxed);
+        std::vector<NodeId> ready;
+        for (NodeId d : node.dependents) {
+            if (depsLeft_[d].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                ready.push_back(d);
+            }
+        }
+        PushReady(self, ready);
+    } else {
+        state_[id].store((int)NodeState::Failed, std::memory_order_release);
+        failed_.fetch_add(1, std::memory_order_relaxed);
+        SkipDependents(id);
+        if (!config_.keepGoing) {
+            stop_.store(true, std::memory_order_release);
+        }
+    }
+
+    running_.fetch_sub(1, std::memory_order_acq_rel);
+    FinishNode();
+    if (stop_.load(std::memory_order_acquire)) {
+        WakeWorkers(true);
+    }
+}
+
+void BuildScheduler::WorkerThread(size_t self) {
+    if (Tracer::Enabled()) Tracer::SetThreadName("build worker");
+    while (true) {
+        if (Finished()) break;
+
+        // Эпоха читается до попытки: освобождение между попыткой и wait не потеряется
+        const uint64_t epoch = admissionEpoch_.load(std::memory_order_acquire);
+        NodeId id = 0;
+        ResourceLease lease;
+        if (!stop_.load(std::memory_order_acquire) &&
+            (PopLocal(self, id, lease) || Steal(self, id, lease)))
+        {
+            Execute(self, id, std::move(lease));
+            continue;
+        }
+
+        // Узлы в деках есть, но ни один не влез: ждём новой эпохи или следующего опроса
+        std::unique_lock<std::mutex> lock(waitMtx_);
+        auto runnable = [this, epoch]() {
+            return Finished() ||
+                   (!stop_.load(std::memory_order_acquire) &&
+                    queued_.load(std::memory_order_acquire) > 0 &&
+                    (!config_.governor || admissionEpoch_.load(std::memory_order_acquire) != epoch));
+        };
+        if (config_.governor) cv_.wait_for(lock, milliseconds(kAdmissionRetryMs), runnable);
+        else                  cv_.wait(lock, runnable);
+    }
+}
+
+bool BuildScheduler::Run(const BuildGraph& graph, std::stop_token stop) {
+    graph_ = &graph;
+    const size_t count = graph.Size();
+    stats_ = SchedulerStats{};
+    if (count == 0) return true;
+
+    size_t jobs = config_.maxJobs > 0
+                ? (size_t)config_.maxJobs
+                : std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min(jobs, count);
+
+    queues_.clear();
+    for (size_t i = 0; i < jobs; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    state_    = std::make_unique<std::atomic<int>[]>(count);
+    depsLeft_ = std::make_unique<std::atomic<size_t>[]>(count);
+    readyAt_  = std::make_unique<steady_clock::time_point[]>(count);
+
+    remaining_.store(count, std::memory_order_release);
+    queued_.store(0, std::memory_order_release);
+    running_.store(0, std::memory_order_release);
+    completed_.store(0, std::memory_order_release);
+    failed_.store(0, std::memory_order_release);
+    steals_.store(0, std::memory_order_release);
+    stop_.store(false, std::memory_order_release);
+
+    // Стартовые узлы раскладываем по декам по кругу: у каждого воркера на хвосте
+    // окажется самый приоритетный из доставшихся ему.
+    std::vector<NodeId> roots;
+    for (NodeId i = 0; i < count; ++i) {
+        state_[i].store((int)NodeState::Pending, std::memory_order_relaxed);
+        depsLeft_[i].store(graph.Node(i).deps.size(), std::memory_order_relaxed);
+        if (graph.Node(i).deps.empty()) roots.push_back(i);
+    }
+    std::sort(roots.begin(), roots.end(), [&graph](NodeId a, NodeId b) {
+        return graph.Node(a).priority > graph.Node(b).priority;
+    });
+    std::vector<std::vector<NodeId>> initial(jobs);
+    for (size_t i = 0; i < roots.size(); ++i) {
+        initial[i % jobs].push_back(roots[i]);
+    }
+    for (size_t w = 0; w < jobs; ++w) {
+        PushReady(w, initial[w]);
+    }
+
+    // Колбэк регистрируется после сброса stop_, иначе ранняя отмена потерялась бы
+    std::stop_callback onStop(stop, [this]() { Cancel(); });
+
+    std::vector<std::thread> threads;
+    threads.reserve(jobs);
+    for (size_t w = 0; w < jobs; ++w) {
+        threads.emplace_back(&BuildScheduler::WorkerThread, this, w);
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    stats_.completed = completed_.load(std::memory_order_acquire);
+    stats_.failed    = failed_.load(std::memory_order_acquire);
+    stats_.skipped   = count - stats_.completed - stats_.failed;
+    stats_.steals    = steals_.load(std::memory_order_acquire);
+    graph_ = nullptr;
+    return stats_.failed == 0 && stats_.skipped == 0;
+}
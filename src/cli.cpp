@@ -0,0 +1,940 @@
+// src/cli.cpp
+#include "cli.h"
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <stop_token>
+#include <nlohmann/json.hpp>
+#include "core_build.h"
+#include "logger.h"
+#include "downloader.h"
+#include "packer.h"
+#include "trace.h"
+#include "link_order.h"
+#include "bench.h"
+#include "remote_exec.h"
+#include "build_daemon.h"
+#include "sdk_store.h"
+#include "metrics.h"
+#include "utf8.h"
+
+using json = nlohmann::json;
+using namespace std::chrono;
+
+namespace {
+
+struct CliTarget {
+    bool online = false;
+    std::wstring input;
+};
+
+struct CliOptions {
+    std::vector<CliTarget> targets;
+    int jobs = 1;
+    bool ndjson = false;
+    std::wstring logFile = L"build.log";
+    std::wstring traceFile;       // пусто → трассировка выключена
+    std::wstring metricsFile;     // непусто → метрики в формате Prometheus раз в секунду и сводка в конце
+    std::wstring hotList;         // профиль горячих функций → фрагмент линкер-скрипта
+    std::wstring hotSymbols;      // вывод nm -S для отчёта о страницах
+    std::wstring hotOut = L"crt/hot_text.ld";
+    std::wstring benchOut;        // непусто → режим бенчмарков вместо сборки
+    std::wstring benchBaseline;
+    double benchThreshold = 10.0; // допустимое замедление медианы, %
+    int benchRepeats = 5;
+    std::string benchFilter;
+    int workerPort = -1;          // ≥0 → режим воркера удалённого исполнения
+    std::string workerBind = "127.0.0.1";
+    std::wstring workerRoot;
+    int workerSlots = 0;
+    std::vector<std::string> workerTools;   // --worker-tool, можно несколько
+    std::wstring sdkStore;        // непусто → операции с хранилищем SDK вместо сборки
+    std::wstring sdkImportVersion;
+    std::wstring sdkImportSource; // .zip или распакованный каталог
+    std::wstring sdkUseVersion;
+    std::wstring sdkUseDir;
+    bool sdkGc = false;
+    std::wstring daemonSocket;    // --daemon: обслуживать сборки через этот сокет
+    std::wstring submitSocket;    // --submit: отправить цели демону на этом сокете
+    bool force = false;           // --force: демон собирает даже неизменённое дерево
+};
+
+void PrintUsage() {
+    std::cerr <<
+        "usage: x360make [--online|--offline] [-j N] [--ndjson] [--log FILE] [--trace FILE] [--metrics FILE]\n"
+        "                [--hot-list FILE [--hot-symbols FILE] [--hot-out FILE]] <target>...\n"
+        "       x360make --bench OUT.json [--baseline FILE] [--threshold PCT]\n"
+        "                [--bench-repeats N] [--bench-filter TEXT] [--ndjson]\n"
+        "       x360make --worker PORT --worker-tool NAME... [--worker-bind ADDR] [--worker-root DIR]\n"
+        "                [--worker-slots N]\n"
+        "       x360make --sdk-store DIR [--sdk-import VERSION ZIP|DIR] [--sdk-use VERSION DIR] [--sdk-gc]\n"
+        "       x360make --daemon SOCKET [--log FILE]\n"
+        "       x360make --submit SOCKET [--force] [--ndjson] [--online|--offline] <target>...\n"
+        "  --online      following targets are URLs (default)\n"
+        "  --offline     following targets are local paths\n"
+        "  -j N          build up to N targets in parallel (0 = all cores)\n"
+        "  --ndjson      machine-readable progress on stdout, one JSON object per line\n"
+        "                (start, progress, log, finish, summary events)\n"
+        "  --log FILE    log file (default build.log)\n"
+        "  --trace FILE  write a Chrome/Perfetto trace of all build stages\n"
+        "  --metrics FILE  rewrite Prometheus text metrics every second, print a summary at the end\n"
+        "  --hot-list FILE     hot-function profile; generates the .text ordering fragment\n"
+        "  --hot-symbols FILE  `nm -S --defined-only` output, adds a page-locality report\n"
+        "  --hot-out FILE      fragment path (default crt/hot_text.ld, INCLUDEd by crt/xex.ld)\n"
+        "  targets may be omitted when only --hot-list is given\n"
+        "  --bench OUT.json    run the benchmark suite (unzip, logger, locale, pack) instead of a build\n"
+        "  --baseline FILE     compare medians against an earlier --bench result\n"
+        "  --threshold PCT     slowdown that counts as a regression (default 10)\n"
+        "  --worker PORT       serve remote compile/pack actions until Ctrl+C; clients authenticate\n"
+        "                      with the X360MAKE_REMOTE_SECRET environment variable (required)\n"
+        "  --worker-tool NAME  allow argv[0] == NAME (exact match, repeatable; at least one required)\n"
+        "  --sdk-store DIR     deduplicated SDK store; --sdk-import adds a version,\n"
+        "                      --sdk-use switches DIR to a version, --sdk-gc drops unused data\n"
+        "  --daemon SOCKET     keep warm build state and serve builds on a Unix socket (Linux)\n"
+        "                      until Ctrl+C or a SHUTDOWN request\n"
+        "  --submit SOCKET     build targets through a running --daemon; unchanged offline\n"
+        "                      trees answer immediately, --force rebuilds them anyway\n"
+        "exit codes: 0 ok, 1 build failed, 2 usage error, 3 init failed, 4 benchmark regression,\n"
+        "            130 cancelled\n";
+}
+
+bool ParseArgs(const std::vector<std::wstring>& args, CliOptions& opt) {
+    bool online = true;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::wstring& a = args[i];
+        if (a == L"--online") {
+            online = true;
+        } else if (a == L"--offline") {
+            online = false;
+        } else if (a == L"--ndjson") {
+            opt.ndjson = true;
+        } else if (a == L"-j" || a == L"--jobs") {
+            if (i + 1 >= args.size()) return false;
+            try {
+                opt.jobs = std::stoi(args[++i]);
+            } catch (...) {
+                return false;
+            }
+            if (opt.jobs < 0) return false;
+        } else if (a.rfind(L"-j", 0) == 0 && a.size() > 2) {
+            try {
+                opt.jobs = std::stoi(a.substr(2));
+            } catch (...) {
+                return false;
+            }
+            if (opt.jobs < 0) return false;
+        } else if (a == L"--log") {
+            if (i + 1 >= args.size()) return false;
+            opt.logFile = args[++i];
+        } else if (a == L"--trace") {
+            if (i + 1 >= args.size()) return false;
+            opt.traceFile = args[++i];
+        } else if (a == L"--metrics") {
+            if (i + 1 >= args.size()) return false;
+            opt.metricsFile = args[++i];
+        } else if (a == L"--hot-list") {
+            if (i + 1 >= args.size()) return false;
+            opt.hotList = args[++i];
+        } else if (a == L"--hot-symbols") {
+            if (i + 1 >= args.size()) return false;
+            opt.hotSymbols = args[++i];
+        } else if (a == L"--hot-out") {
+            if (i + 1 >= args.size()) return false;
+            opt.hotOut = args[++i];
+        } else if (a == L"--bench") {
+            if (i + 1 >= args.size()) return false;
+            opt.benchOut = args[++i];
+        } else if (a == L"--baseline") {
+            if (i + 1 >= args.size()) return false;
+            opt.benchBaseline = args[++i];
+        } else if (a == L"--threshold") {
+            if (i + 1 >= args.size()) return false;
+            try {
+                opt.benchThreshold = std::stod(args[++i]);
+            } catch (...) {
+                return false;
+            }
+            if (opt.benchThreshold < 0) return false;
+        } else if (a == L"--bench-repeats") {
+            if (i + 1 >= args.size()) return false;
+            try {
+                opt.benchRepeats = std::stoi(args[++i]);
+            } catch (...) {
+                return false;
+            }
+            if (opt.benchRepeats < 1) return false;
+        } else if (a == L"--bench-filter") {
+            if (i + 1 >= args.size()) return false;
+            opt.benchFilter = WStringToUtf8(args[++i]);
+        } else if (a == L"--worker") {
+            if (i + 1 >= args.size()) return false;
+            try {
+                opt.workerPort = std::stoi(args[++i]);
+            } catch (...) {
+                return false;
+            }
+            if (opt.workerPort < 0 || opt.workerPort > 65535) return false;
+        } else if (a == L"--worker-bind") {
+            if (i + 1 >= args.size()) return false;
+            opt.workerBind = WStringToUtf8(args[++i]);
+        } else if (a == L"--worker-root") {
+            if (i + 1 >= args.size()) return false;
+            opt.workerRoot = args[++i];
+        } else if (a == L"--worker-slots") {
+            if (i + 1 >= args.size()) return false;
+            try {
+                opt.workerSlots = std::stoi(args[++i]);
+            } catch (...) {
+                return false;
+            }
+            if (opt.workerSlots < 0) return false;
+        } else if (a == L"--worker-tool") {
+            if (i + 1 >= args.size()) return false;
+            opt.workerTools.push_back(WStringToUtf8(args[++i]));
+        } else if (a == L"--sdk-store") {
+            if (i + 1 >= args.size()) return false;
+            opt.sdkStore = args[++i];
+        } else if (a == L"--sdk-import") {
+            if (i + 2 >= args.size()) return false;
+            opt.sdkImportVersion = args[++i];
+            opt.sdkImportSource = args[++i];
+        } else if (a == L"--sdk-use") {
+            if (i + 2 >= args.size()) return false;
+            opt.sdkUseVersion = args[++i];
+            opt.sdkUseDir = args[++i];
+        } else if (a == L"--sdk-gc") {
+            opt.sdkGc = true;
+        } else if (a == L"--daemon") {
+            if (i + 1 >= args.size()) return false;
+            opt.daemonSocket = args[++i];
+        } else if (a == L"--submit") {
+            if (i + 1 >= args.size()) return false;
+            opt.submitSocket = args[++i];
+        } else if (a == L"--force") {
+            opt.force = true;
+        } else if (!a.empty() && a[0] == L'-') {
+            return false;
+        } else {
+            opt.targets.push_back({ online, a });
+        }
+    }
+    if (opt.jobs == 0) {
+        opt.jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (!opt.benchBaseline.empty() && opt.benchOut.empty()) return false;
+    bool sdkOp = !opt.sdkImportVersion.empty() || !opt.sdkUseVersion.empty() || opt.sdkGc;
+    if (sdkOp != !opt.sdkStore.empty()) return false;
+    // Режимы без сборки целей: лишние позиционные аргументы — скорее опечатка, чем намерение
+    bool noTargets = opt.workerPort >= 0 || sdkOp || !opt.benchOut.empty() || !opt.daemonSocket.empty();
+    if (noTargets && !opt.targets.empty()) return false;
+    if (!opt.submitSocket.empty() && opt.targets.empty()) return false;
+    if (opt.force && opt.submitSocket.empty()) return false;
+    return !opt.targets.empty() || !opt.hotList.empty() || !opt.benchOut.empty() ||
+           opt.workerPort >= 0 || sdkOp || !opt.daemonSocket.empty();
+}
+
+// Единая точка вывода: строки от разных потоков не перемешиваются
+class CliReporter {
+public:
+    explicit CliReporter(bool ndjson) : ndjson_(ndjson) {}
+
+    void Start(size_t id, const CliTarget& t) {
+        if (ndjson_) {
+            Emit({ {"event", "start"}, {"id", id},
+                   {"mode", t.online ? "online" : "offline"},
+                   {"target", WStringToUtf8(t.input)} });
+        } else {
+            Line("[start] " + WStringToUtf8(t.input));
+        }
+    }
+
+    void Finish(size_t id, const CliTarget& t, bool ok, long long ms) {
+        if (ndjson_) {
+            Emit({ {"event", "finish"}, {"id", id}, {"target", WStringToUtf8(t.input)},
+                   {"ok", ok}, {"ms", ms} });
+        } else {
+            Line((ok ? "[ok]    " : "[FAIL]  ") + WStringToUtf8(t.input) +
+                 " (" + std::to_string(ms) + " ms)");
+        }
+    }
+
+    // Строка лога логгера сборки; в текстовом режиме печатаются только предупреждения и ошибки
+    void BuildLog(LogLevel level, const std::wstring& message) {
+        if (ndjson_) {
+            Emit({ {"event", "log"}, {"level", LevelName(level)}, {"line", WStringToUtf8(message)} });
+        } else if (level >= LogLevel::Warning) {
+            Line((level == LogLevel::Warning ? "[warn]  " : "[error] ") + WStringToUtf8(message));
+        }
+    }
+
+    // Прогресс сборки (только NDJSON: в тексте хватает start/finish)
+    void Progress(size_t targetsDone, size_t targets, uint64_t nodesDone, uint64_t nodesFailed,
+                  int64_t nodesRunning, long long ms)
+    {
+        if (!ndjson_) return;
+        Emit({ {"event", "progress"}, {"targets_done", targetsDone}, {"targets", targets},
+               {"nodes_done", nodesDone}, {"nodes_failed", nodesFailed},
+               {"nodes_running", nodesRunning}, {"ms", ms} });
+    }
+
+    // Строка лога сборки цели id
+    void Log(size_t id, const std::wstring& line) {
+        if (ndjson_) {
+            Emit({ {"event", "log"}, {"id", id}, {"line", WStringToUtf8(line)} });
+        } else {
+            Line("        " + WStringToUtf8(line));
+        }
+    }
+
+    void LinkOrderReport(const std::wstring& out, size_t functions, const LocalityReport* r) {
+        if (ndjson_) {
+            json j = { {"event", "link_order"}, {"fragment", WStringToUtf8(out)},
+                       {"functions", functions} };
+            if (r) {
+                j["resolved"]     = r->resolved;
+                j["hot_bytes"]    = r->hotBytes;
+                j["pages_before"] = r->pagesBefore;
+                j["pages_after"]  = r->pagesAfter;
+                j["missing"]      = r->missing.size();
+            }
+            Emit(j);
+        } else {
+            Line("[order] " + WStringToUtf8(out) + ": " + std::to_string(functions) + " hot functions");
+            if (r) {
+                Line("        resolved " + std::to_string(r->resolved) + ", " +
+                     std::to_string(r->hotBytes) + " bytes, pages " +
+                     std::to_string(r->pagesBefore) + " -> " + std::to_string(r->pagesAfter) +
+                     (r->missing.empty() ? "" : ", missing " + std::to_string(r->missing.size())));
+            }
+        }
+    }
+
+    void Bench(const BenchResult& r) {
+        if (ndjson_) {
+            json j = { {"event", "bench"}, {"name", r.name}, {"skipped", r.skipped}, {"failed", r.failed} };
+            if (r.skipped || r.failed) {
+                j["note"] = r.note;
+            } else {
+                j["median_ms"] = r.medianMs;
+                j["throughput"] = r.throughput;
+                j["unit"] = r.unit;
+            }
+            Emit(j);
+        } else if (r.skipped) {
+            Line("[skip]  " + r.name + " (" + r.note + ")");
+        } else if (r.failed) {
+            Line("[FAIL]  " + r.name + " (" + r.note + ")");
+        } else {
+            char buf[160];
+            std::snprintf(buf, sizeof(buf), "[bench] %-28s %10.2f ms  %12.1f %s",
+                          r.name.c_str(), r.medianMs, r.throughput, r.unit.c_str());
+            Line(buf);
+        }
+    }
+
+    void BenchDelta(const BenchComparison& c) {
+        if (ndjson_) {
+            Emit({ {"event", "bench_compare"}, {"name", c.name}, {"baseline_ms", c.baselineMs},
+                   {"current_ms", c.currentMs}, {"delta_pct", c.deltaPct},
+                   {"regression", c.regression}, {"failed", c.failed} });
+        } else if (c.failed) {
+            Line("[FAILED] " + c.name);
+        } else {
+            char buf[160];
+            std::snprintf(buf, sizeof(buf), "%s %-28s %10.2f -> %10.2f ms  %+6.1f%%",
+                          c.regression ? "[SLOWER]" : "[same]  ", c.name.c_str(),
+                          c.baselineMs, c.currentMs, c.deltaPct);
+            Line(buf);
+        }
+    }
+
+    void Sdk(const std::string& op, const std::wstring& version, const SdkImportStats* imp,
+             uint64_t freed, const SdkStoreStats& st)
+    {
+        if (ndjson_) {
+            json j = { {"event", "sdk"}, {"op", op}, {"version", WStringToUtf8(version)},
+                       {"versions", st.versions}, {"chunk_bytes", st.chunkBytes},
+                       {"blob_bytes", st.blobBytes} };
+            if (imp) {
+                j["files"]      = imp->files;
+                j["bytes"]      = imp->bytes;
+                j["chunks"]     = imp->chunks;
+                j["new_chunks"] = imp->newChunks;
+                j["new_bytes"]  = imp->newBytes;
+            }
+            if (op == "gc") j["freed"] = freed;
+            Emit(j);
+        } else {
+            std::string s = "[sdk]   " + op;
+            if (!version.empty()) s += " " + WStringToUtf8(version);
+            if (imp) {
+                s += ": " + std::to_string(imp->files) + " files, " + std::to_string(imp->bytes) +
+                     " bytes, " + std::to_string(imp->newBytes) + " new";
+            }
+            if (op == "gc") s += ": freed " + std::to_string(freed) + " bytes";
+            Line(s);
+            Line("        store: " + std::to_string(st.versions) + " versions, " +
+                 std::to_string(st.chunkBytes) + " bytes in chunks, " +
+                 std::to_string(st.blobBytes) + " bytes in blobs");
+        }
+    }
+
+    void Metric(const MetricSnapshot& m) {
+        if (ndjson_) {
+            json j = { {"event", "metric"}, {"name", m.name}, {"labels", m.labels}, {"kind", m.kind} };
+            if (m.kind == "histogram") {
+                j["count"] = m.count;
+                j["sum"]   = m.value;
+                j["p50"]   = m.p50;
+                j["p90"]   = m.p90;
+                j["p99"]   = m.p99;
+                j["max"]   = m.max;
+            } else {
+                j["value"] = m.value;
+                if (m.kind == "gauge") j["max"] = m.max;
+            }
+            Emit(j);
+            return;
+        }
+        std::string name = m.name + (m.labels.empty() ? "" : "{" + m.labels + "}");
+        char buf[256];
+        if (m.kind == "histogram") {
+            std::snprintf(buf, sizeof(buf), "[metric] %-48s n=%llu p50=%.4g p90=%.4g p99=%.4g max=%.4g",
+                          name.c_str(), (unsigned long long)m.count, m.p50, m.p90, m.p99, m.max);
+        } else if (m.kind == "gauge") {
+            std::snprintf(buf, sizeof(buf), "[metric] %-48s %.0f (max %.0f)", name.c_str(), m.value, m.max);
+        } else {
+            std::snprintf(buf, sizeof(buf), "[metric] %-48s %.0f", name.c_str(), m.value);
+        }
+        Line(buf);
+    }
+
+    void Summary(size_t ok, size_t failed, long long ms) {
+        if (ndjson_) {
+            Emit({ {"event", "summary"}, {"ok", ok}, {"failed", failed}, {"ms", ms} });
+        } else {
+            Line("built " + std::to_string(ok) + ", failed " + std::to_string(failed) +
+                 " in " + std::to_string(ms) + " ms");
+        }
+    }
+
+private:
+    static const char* LevelName(LogLevel level) {
+        switch (level) {
+            case LogLevel::Debug:   return "debug";
+            case LogLevel::Info:    return "info";
+            case LogLevel::Warning: return "warning";
+            case LogLevel::Error:   return "error";
+            default:                return "fatal";
+        }
+    }
+
+    void Emit(const json& j) {
+        Line(j.dump());
+    }
+    void Line(const std::string& s) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::cout << s << '\n';
+        std::cout.flush();
+    }
+
+    bool ndjson_;
+    std::mutex mtx_;
+};
+
+// Обработчик сигнала только ставит флаг; токен взводит обычный поток-наблюдатель
+volatile std::sig_atomic_t g_interrupted = 0;
+
+extern "C" void OnInterrupt(int) {
+    g_interrupted = 1;
+}
+
+// На время жизни ставит обработчик Ctrl+C и поток, переводящий флаг в stop_source
+class InterruptWatcher {
+public:
+    InterruptWatcher() {
+        g_interrupted = 0;
+        std::signal(SIGINT, OnInterrupt);
+        thread_ = std::thread([this]() {
+            while (!done_.load(std::memory_order_acquire)) {
+                if (g_interrupted) {
+                    source_.request_stop();
+                    break;
+                }
+                std::this_thread::sleep_for(milliseconds(20));
+            }
+        });
+    }
+
+    ~InterruptWatcher() {
+        done_.store(true, std::memory_order_release);
+        thread_.join();
+        std::signal(SIGINT, SIG_DFL);
+    }
+
+    InterruptWatcher(const InterruptWatcher&) = delete;
+    InterruptWatcher& operator=(const InterruptWatcher&) = delete;
+
+    std::stop_token Token() const { return source_.get_token(); }
+    bool Interrupted() const { return source_.stop_requested(); }
+
+private:
+    std::stop_source source_;
+    std::atomic<bool> done_{false};
+    std::thread thread_;
+};
+
+// Пока идёт сборка, раз в секунду сообщает прогресс по счётчикам графа сборки
+// (x360_build_nodes_*, см. build_graph.cpp); неизменившийся прогресс не повторяется.
+class ProgressTicker {
+public:
+    ProgressTicker(CliReporter& reporter, size_t targets, const std::atomic<size_t>& finished)
+        : reporter_(reporter), targets_(targets), finished_(finished)
+    {
+        base_ = NodesDone();
+        baseFailed_ = failed_.Value();
+        thread_ = std::thread([this]() { Run(); });
+    }
+
+    ~ProgressTicker() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            done_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    ProgressTicker(const ProgressTicker&) = delete;
+    ProgressTicker& operator=(const ProgressTicker&) = delete;
+
+private:
+    uint64_t NodesDone() const { return ok_.Value() + failed_.Value() + skipped_.Value(); }
+
+    void Run() {
+        auto t0 = steady_clock::now();
+        uint64_t lastNodes = NodesDone();
+        size_t lastTargets = finished_.load();
+        int64_t lastRunning = running_.Value();
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (!cv_.wait_for(lock, seconds(1), [this]() { return done_; })) {
+            uint64_t nodes = NodesDone();
+            size_t targets = finished_.load();
+            int64_t running = running_.Value();
+            if (nodes == lastNodes && targets == lastTargets && running == lastRunning) continue;
+            lastNodes = nodes;
+            lastTargets = targets;
+            lastRunning = running;
+            reporter_.Progress(targets, targets_, nodes - base_, failed_.Value() - baseFailed_, running,
+                               (long long)duration_cast<milliseconds>(steady_clock::now() - t0).count());
+        }
+    }
+
+    CliReporter& reporter_;
+    size_t targets_;
+    const std::atomic<size_t>& finished_;
+    MetricCounter& ok_ = Metrics::Counter("x360_build_nodes_total", "Finished build graph nodes",
+                                          Metrics::Label("result", std::string("ok")));
+    MetricCounter& failed_ = Metrics::Counter("x360_build_nodes_total", "Finished build graph nodes",
+                                              Metrics::Label("result", std::string("failed")));
+    MetricCounter& skipped_ = Metrics::Counter("x360_build_nodes_total", "Finished build graph nodes",
+                                               Metrics::Label("result", std::string("skipped")));
+    MetricGauge& running_ = Metrics::Gauge("x360_build_nodes_running", "Build graph nodes executing now");
+    uint64_t base_ = 0;
+    uint64_t baseFailed_ = 0;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool done_ = false;
+    std::thread thread_;
+};
+
+std::shared_ptr<IDownloader> MakeDownloader() {
+#ifdef _WIN32
+    return std::make_shared<WinHttpDownloader>();
+#else
+    return nullptr;
+#endif
+}
+
+// Воркер удалённого исполнения: работает до Ctrl+C
+int RunWorker(const CliOptions& opt) {
+    RemoteWorkerConfig cfg;
+    cfg.bindAddress = opt.workerBind;
+    cfg.port  = (uint16_t)opt.workerPort;
+    cfg.root  = opt.workerRoot.empty()
+        ? (std::filesystem::temp_directory_path() / "x360make-worker").wstring()
+        : opt.workerRoot;
+    cfg.slots = opt.workerSlots;
+    cfg.tools = opt.workerTools;
+    const char* secret = std::getenv("X360MAKE_REMOTE_SECRET");
+    if (secret) cfg.secret = secret;
+    if (cfg.secret.empty()) {
+        std::cerr << "X360MAKE_REMOTE_SECRET is not set: the worker refuses unauthenticated clients\n";
+        return CLI_USAGE;
+    }
+    if (cfg.tools.empty()) {
+        std::cerr << "no --worker-tool given: the worker would have nothing it is allowed to run\n";
+        return CLI_USAGE;
+    }
+    RemoteWorker worker(cfg);
+    if (!worker.Start()) {
+        std::cerr << "cannot start remote worker\n";
+        return CLI_INIT_FAIL;
+    }
+    std::cerr << "remote worker listening on " << opt.workerBind << ":" << worker.Port() << "\n";
+    InterruptWatcher interrupt;
+    while (!interrupt.Interrupted()) {
+        std::this_thread::sleep_for(milliseconds(100));
+    }
+    worker.Stop();
+    return CLI_OK;
+}
+
+// Демон сборки: тёплое состояние между запросами --submit, до Ctrl+C или SHUTDOWN
+int RunDaemon(const CliOptions& opt) {
+    // Демон собирает по одной цели, так что строки логгера уходят клиенту текущей сборки
+    std::mutex clientLogMtx;
+    const std::function<void(const std::wstring&)>* clientLog = nullptr;
+
+    LoggerConfig logCfg;
+    logCfg.filename      = opt.logFile;
+    logCfg.maxFileSize   = 50 * 1024 * 1024;
+    logCfg.consoleOutput = false;
+    logCfg.sink = [&](LogLevel, const std::wstring& message) {
+        std::lock_guard<std::mutex> lock(clientLogMtx);
+        if (clientLog) (*clientLog)(message);
+    };
+    std::shared_ptr<AsyncFileLogger> logger;
+    try {
+        logger = std::make_shared<AsyncFileLogger>(logCfg);
+    } catch (...) {
+        return CLI_INIT_FAIL;
+    }
+    auto downloader = MakeDownloader();
+    InterruptWatcher interrupt;
+
+    BuildDaemonConfig cfg;
+    cfg.socketPath = WStringToUtf8(opt.daemonSocket);
+    cfg.build = [&](const DaemonRequest& request, const std::function<void(const std::wstring&)>& log) {
+        if (request.online && !downloader) {
+            log(L"online targets need a downloader, which is not available on this platform");
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(clientLogMtx);
+            clientLog = &log;
+        }
+        bool ok = false;
+        try {
+            auto packer = std::make_shared<Packer>();
+            CoreBuilder builder(logger, downloader, packer);
+            std::stop_callback onStop(interrupt.Token(), [&builder]() {
+                builder.CancelBuild();
+            });
+            ok = request.online ? builder.StartOnlineBuild(request.input, interrupt.Token())
+                                : builder.StartOfflineBuild(request.input, interrupt.Token());
+        } catch (...) {
+            ok = false;
+        }
+        std::lock_guard<std::mutex> lock(clientLogMtx);
+        clientLog = nullptr;
+        return ok;
+    };
+    BuildDaemon daemon(cfg);
+    if (!daemon.Start()) {
+        std::cerr << "cannot start build daemon (socket busy, or not Linux)\n";
+        return CLI_INIT_FAIL;
+    }
+    std::cerr << "build daemon listening on " << cfg.socketPath << "\n";
+    daemon.Wait(interrupt.Token());
+    daemon.Stop();
+    logger->Close();
+    return interrupt.Interrupted() ? CLI_CANCELLED : CLI_OK;
+}
+
+// Цели по очереди уходят демону; его лог печатается как лог цели
+int RunSubmit(const CliOptions& opt) {
+    const std::string socketPath = WStringToUtf8(opt.submitSocket);
+    CliReporter reporter(opt.ndjson);
+    size_t ok = 0, failed = 0;
+    auto t0 = steady_clock::now();
+    for (size_t i = 0; i < opt.targets.size(); ++i) {
+        const CliTarget& t = opt.targets[i];
+        DaemonRequest request;
+        request.online = t.online;
+        request.input  = t.input;
+        request.force  = opt.force;
+        reporter.Start(i, t);
+        auto start = steady_clock::now();
+        int rc = DaemonSubmit(socketPath, request, [&](const std::wstring& line) {
+            reporter.Log(i, line);
+        });
+        if (rc == 2) {
+            std::cerr << "build daemon is not reachable at " << socketPath << "\n";
+            return CLI_INIT_FAIL;
+        }
+        (rc == 0 ? ok : failed) += 1;
+        reporter.Finish(i, t, rc == 0,
+                        (long long)duration_cast<milliseconds>(steady_clock::now() - start).count());
+    }
+    reporter.Summary(ok, failed, (long long)duration_cast<milliseconds>(steady_clock::now() - t0).count());
+    return failed == 0 ? CLI_OK : CLI_BUILD_FAIL;
+}
+
+// Операции с хранилищем SDK в порядке import → use → gc; до Ctrl+C или первой ошибки
+int RunSdk(const CliOptions& opt) {
+    SdkStoreConfig cfg;
+    cfg.root = opt.sdkStore;
+    SdkStore store(cfg);
+    if (!store.Open()) {
+        std::cerr << "cannot open SDK store\n";
+        return CLI_INIT_FAIL;
+    }
+    InterruptWatcher interrupt;
+
+    CliReporter reporter(opt.ndjson);
+    int rc = CLI_OK;
+    if (!opt.sdkImportVersion.empty()) {
+        std::error_code ec;
+        bool ok = std::filesystem::is_directory(opt.sdkImportSource, ec)
+            ? store.Import(opt.sdkImportVersion, opt.sdkImportSource, interrupt.Token())
+            : store.ImportZip(opt.sdkImportVersion, opt.sdkImportSource, interrupt.Token());
+        if (ok) {
+            SdkImportStats imp = store.LastImport();
+            reporter.Sdk("import", opt.sdkImportVersion, &imp, 0, store.Stats());
+        } else {
+            std::cerr << "SDK import failed\n";
+            rc = CLI_BUILD_FAIL;
+        }
+    }
+    if (rc == CLI_OK && !opt.sdkUseVersion.empty()) {
+        if (store.Materialize(opt.sdkUseVersion, opt.sdkUseDir, interrupt.Token())) {
+            reporter.Sdk("use", opt.sdkUseVersion, nullptr, 0, store.Stats());
+        } else {
+            std::cerr << "cannot materialize SDK version\n";
+            rc = CLI_BUILD_FAIL;
+        }
+    }
+    if (rc == CLI_OK && opt.sdkGc && !interrupt.Interrupted()) {
+        uint64_t freed = store.CollectGarbage();
+        reporter.Sdk("gc", L"", nullptr, freed, store.Stats());
+    }
+
+    if (interrupt.Interrupted()) return CLI_CANCELLED;
+    return rc;
+}
+
+// Прогон бенчмарков и сравнение с baseline; цели сборки в этом режиме не собираются
+int RunBench(const CliOptions& opt) {
+    BenchConfig cfg;
+    cfg.workDir = (std::filesystem::temp_directory_path() / "x360make-bench").wstring();
+    cfg.repeats = opt.benchRepeats;
+    cfg.filter  = opt.benchFilter;
+    BenchSuite suite(cfg);
+    CliReporter reporter(opt.ndjson);
+    if (!suite.Run()) {
+        std::cerr << "cannot prepare benchmark work directory\n";
+        return CLI_INIT_FAIL;
+    }
+    bool failed = false;
+    for (const auto& r : suite.Results()) {
+        reporter.Bench(r);
+        failed = failed || r.failed;
+    }
+    if (!suite.WriteJson(opt.benchOut)) {
+        std::cerr << "failed to write benchmark results\n";
+        return CLI_INIT_FAIL;
+    }
+    if (opt.benchBaseline.empty()) return failed ? CLI_BENCH_REGRESSION : CLI_OK;
+
+    std::vector<BenchComparison> cmp;
+    if (!BenchSuite::Compare(opt.benchBaseline, suite.Results(), opt.benchThreshold, cmp)) {
+        std::cerr << "cannot read benchmark baseline\n";
+        return CLI_INIT_FAIL;
+    }
+    bool regressed = false;
+    for (const auto& c : cmp) {
+        reporter.BenchDelta(c);
+        regressed = regressed || c.regression;
+    }
+    return regressed ? CLI_BENCH_REGRESSION : CLI_OK;
+}
+
+// Фрагмент порядка .text для crt/xex.ld; отчёт — если дана таблица символов
+bool GenerateLinkOrder(const CliOptions& opt, CliReporter& reporter) {
+    LinkOrder order;
+    if (!order.LoadProfile(opt.hotList)) {
+        std::cerr << "cannot read hot-function list\n";
+        return false;
+    }
+    if (!order.WriteScript(opt.hotOut)) {
+        std::cerr << "cannot write link order fragment\n";
+        return false;
+    }
+    if (opt.hotSymbols.empty()) {
+        reporter.LinkOrderReport(opt.hotOut, order.Hot().size(), nullptr);
+        return true;
+    }
+    if (!order.LoadSymbols(opt.hotSymbols)) {
+        std::cerr << "cannot read symbol table\n";
+        return false;
+    }
+    LocalityReport report = order.Report();
+    reporter.LinkOrderReport(opt.hotOut, order.Hot().size(), &report);
+    return true;
+}
+
+} // namespace
+
+int RunCLI(const std::vector<std::wstring>& args) {
+    CliOptions opt;
+    if (!ParseArgs(args, opt)) {
+        PrintUsage();
+        return CLI_USAGE;
+    }
+    if (opt.workerPort >= 0) {
+        return RunWorker(opt);
+    }
+    if (!opt.sdkStore.empty()) {
+        return RunSdk(opt);
+    }
+    if (!opt.daemonSocket.empty()) {
+        return RunDaemon(opt);
+    }
+    if (!opt.submitSocket.empty()) {
+        return RunSubmit(opt);
+    }
+
+    if (!opt.benchOut.empty()) {
+        if (!opt.traceFile.empty()) Tracer::Enable();
+        int rc = RunBench(opt);
+        if (!opt.traceFile.empty() && !Tracer::Write(opt.traceFile)) {
+            std::cerr << "failed to write trace file\n";
+        }
+        return rc;
+    }
+
+    if (!opt.hotList.empty()) {
+        CliReporter orderReporter(opt.ndjson);
+        if (!GenerateLinkOrder(opt, orderReporter)) return CLI_INIT_FAIL;
+        if (opt.targets.empty()) return CLI_OK;
+    }
+
+    auto downloader = MakeDownloader();
+    if (!downloader) {
+        for (const auto& t : opt.targets) {
+            if (t.online) {
+                std::cerr << "online targets need a downloader, which is not available on this platform\n";
+                return CLI_USAGE;
+            }
+        }
+    }
+
+    CliReporter reporter(opt.ndjson);
+
+    LoggerConfig logCfg;
+    logCfg.filename      = opt.logFile;
+    logCfg.maxFileSize   = 50 * 1024 * 1024;
+    logCfg.consoleOutput = false;
+    logCfg.sink = [&reporter](LogLevel level, const std::wstring& message) {
+        reporter.BuildLog(level, message);
+    };
+    std::shared_ptr<AsyncFileLogger> logger;
+    try {
+        logger = std::make_shared<AsyncFileLogger>(logCfg);
+    } catch (...) {
+        return CLI_INIT_FAIL;
+    }
+
+    if (!opt.traceFile.empty()) {
+        Tracer::Enable();
+    }
+    if (!opt.metricsFile.empty()) {
+        Metrics::StartExport(opt.metricsFile, 1000);
+    }
+    static MetricHistogram& targetSeconds = Metrics::Histogram(
+        "x360_target_seconds", "Wall time of one CLI build target", 1e-3);
+    static MetricCounter& targetsOk = Metrics::Counter(
+        "x360_targets_total", "Finished CLI build targets", Metrics::Label("result", std::string("ok")));
+    static MetricCounter& targetsFailed = Metrics::Counter(
+        "x360_targets_total", "Finished CLI build targets", Metrics::Label("result", std::string("failed")));
+
+    InterruptWatcher interrupt;
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> okCount(0);
+    std::atomic<size_t> failCount(0);
+    std::atomic<size_t> finished(0);
+    auto t0 = steady_clock::now();
+
+    // Каждая цель получает свой CoreBuilder; воркеры разбирают цели по атомарному индексу
+    auto worker = [&]() {
+        if (Tracer::Enabled()) Tracer::SetThreadName("cli target");
+        while (true) {
+            if (interrupt.Interrupted()) break;
+            size_t i = next.fetch_add(1);
+            if (i >= opt.targets.size()) break;
+            const CliTarget& t = opt.targets[i];
+            reporter.Start(i, t);
+            auto start = steady_clock::now();
+            bool ok = false;
+            TRACE_SCOPE("build", "target", t.input);
+            try {
+                auto packer = std::make_shared<Packer>();
+                CoreBuilder builder(logger, downloader, packer);
+                std::stop_callback onStop(interrupt.Token(), [&builder]() {
+                    builder.CancelBuild();
+                });
+                // Токен доходит до Download, Unzip и Pack внутри сборки
+                ok = t.online ? builder.StartOnlineBuild(t.input, interrupt.Token())
+                              : builder.StartOfflineBuild(t.input, interrupt.Token());
+            } catch (...) {
+                ok = false;
+            }
+            long long ms = (long long)duration_cast<milliseconds>(steady_clock::now() - start).count();
+            (ok ? okCount : failCount).fetch_add(1);
+            (ok ? targetsOk : targetsFailed).Add();
+            targetSeconds.Record((uint64_t)ms);
+            reporter.Finish(i, t, ok, ms);
+            finished.fetch_add(1);
+        }
+    };
+
+    int threadsCount = std::min(opt.jobs, (int)opt.targets.size());
+    {
+        std::unique_ptr<ProgressTicker> progress;
+        if (opt.ndjson) progress = std::make_unique<ProgressTicker>(reporter, opt.targets.size(), finished);
+        std::vector<std::thread> threads;
+        threads.reserve(threadsCount);
+        for (int t = 0; t < threadsCount; ++t) {
+            threads.emplace_back(worker);
+        }
+        for (auto& th : threads) {
+            th.join();
+        }
+    }
+
+    reporter.Summary(okCount.load(), failCount.load(),
+                     (long long)duration_cast<milliseconds>(steady_clock::now() - t0).count());
+    logger->Close();
+    if (!opt.metricsFile.empty()) {
+        // Последняя выгрузка после Close: в ней уже учтён хвост очереди логгера
+        Metrics::StopExport();
+        for (const auto& m : Metrics::Snapshot()) {
+            reporter.Metric(m);
+        }
+    }
+    if (!opt.traceFile.empty() && !Tracer::Write(opt.traceFile)) {
+        std::cerr << "failed to write trace file\n";
+    }
+    if (interrupt.Interrupted()) return CLI_CANCELLED;
+    return failCount.load() == 0 ? CLI_OK : CLI_BUILD_FAIL;
+}
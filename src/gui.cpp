@@ -8,12 +8,14 @@
 #include <thread>
 #include <vector>
 #include <mutex>
+#include <stop_token>
 #include <commctrl.h>
 #include <fmt/core.h>
 #include "core_build.h"
 #include "logger.h"
 #include "downloader.h"
 #include "packer.h"
+#include "log_model.h"
 
 #pragma comment(lib, "Comctl32.lib")
 
@@ -31,7 +33,7 @@ enum {
 };
 
 constexpr UINT WM_BUILD_STARTED  = WM_USER + 1;
-constexpr UINT WM_BUILD_UPDATE   = WM_USER + 2; // wParam=percent (1–100) или 0 → новая строка лога
+constexpr UINT WM_BUILD_UPDATE   = WM_USER + 2; // модель лога/прогресса изменилась (не чаще одного на кадр)
 constexpr UINT WM_BUILD_FINISHED = WM_USER + 3; // wParam=1 (успех) или 0 (провал)
 
 static HWND hUrlEdit, hPathEdit, hBuildBtn, hCancelBtn;
@@ -40,36 +42,32 @@ static bool onlineMode = true;
 
 static std::shared_ptr<AsyncFileLogger> logger;
 static std::unique_ptr<CoreBuilder> builder;
+static std::shared_ptr<WinHttpDownloader> downloader;
+static std::shared_ptr<Packer> packer;
 static std::thread buildThread;
+static std::stop_source buildStop;   // общий токен отмены текущей сборки
 
-static std::vector<std::wstring> logMessages;
-static std::mutex logMutex;
+// Ограниченный лог + прогресс; ListView читает его в режиме owner-data
+static LogModel logModel(10000);
 
-// Добавить запись в лог (вектор + сигнал GUI)
-static void AddLogMessage(HWND hWnd, const std::wstring& msg) {
-    {
-        std::lock_guard<std::mutex> lock(logMutex);
-        logMessages.push_back(msg);
-    }
-    PostMessageW(hWnd, WM_BUILD_UPDATE, 0, 0);
+// Добавить запись в лог (сигнал GUI посылает сама модель, если он ещё не в очереди)
+static void AddLogMessage(const std::wstring& msg) {
+    logModel.Append(msg);
 }
 
-static std::atomic<bool> cancelRequested(false);
-
 // Функция потока сборки
-static void BuildThreadProc(HWND hWnd, std::wstring input, bool online) {
+static void BuildThreadProc(HWND hWnd, std::wstring input, bool online, std::stop_token stop) {
     PostMessageW(hWnd, WM_BUILD_STARTED, 0, 0);
 
     auto progressCb = [&](double percent) {
-        int p = static_cast<int>(percent);
-        PostMessageW(hWnd, WM_BUILD_UPDATE, (WPARAM)p, 0);
+        logModel.SetProgress(static_cast<int>(percent));
     };
 
     bool success = false;
     if (online) {
-        success = builder->StartOnlineBuild(input);
+        success = builder->StartOnlineBuild(input, stop);
     } else {
-        success = builder->StartOfflineBuild(input);
+        success = builder->StartOfflineBuild(input, stop);
     }
     PostMessageW(hWnd, WM_BUILD_FINISHED, success ? 1 : 0, 0);
 }
@@ -92,10 +90,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wp, LPARAM lp) {
         logCfg.maxFileSize  = 50 * 1024 * 1024;
         logCfg.consoleOutput= false;
         logger = std::make_shared<AsyncFileLogger>(logCfg);
-        builder = std::make_unique<CoreBuilder>(
-                      logger,
-                      std::make_shared<WinHttpDownloader>(),
-                      std::make_shared<Packer>());
+        downloader = std::make_shared<WinHttpDownloader>();
+        packer = std::make_shared<Packer>();
+        builder = std::make_unique<CoreBuilder>(logger, downloader, packer);
+        logModel.SetNotifier([hWnd]() {
+            PostMessageW(hWnd, WM_BUILD_UPDATE, 0, 0);
+        });
 
         CreateWindowW(L"BUTTON", loc.L(L"btnOnline").c_str(),
                       WS_CHILD | WS_VISIBLE | WS_GROUP | BS_AUTORADIOBUTTON,
@@ -147,7 +147,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wp, LPARAM lp) {
         INITCOMMONCONTROLSEX icex = { sizeof(icex), ICC_LISTVIEW_CLASSES };
         InitCommonControlsEx(&icex);
         hLogList = CreateWindowW(WC_LISTVIEWW, L"",
-                                 WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_EDITLABELS,
+                                 WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_OWNERDATA,
                                  S(10), S(200), S(410), S(200),
                                  hWnd, (HMENU)ID_LIST_LOG, nullptr, nullptr);
         ListView_SetExtendedListViewStyle(hLogList, LVS_EX_FULLROWSELECT);
@@ -168,7 +168,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wp, LPARAM lp) {
             EnableWindow(hBuildBtn, TRUE);
             SetWindowTextW(hStatusText, L"");
             SendMessageW(hProgressBar, PBM_SETPOS, 0, 0);
-            ListView_DeleteAllItems(hLogList);
+            logModel.Clear();
             break;
 
         case ID_BTN_OFFLINE:
@@ -176,7 +176,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wp, LPARAM lp) {
             EnableWindow(hBuildBtn, TRUE);
             SetWindowTextW(hStatusText, L"");
             SendMessageW(hProgressBar, PBM_SETPOS, 0, 0);
-            ListView_DeleteAllItems(hLogList);
+            logModel.Clear();
             break;
 
         case ID_BTN_BUILD: {
@@ -190,18 +190,23 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wp, LPARAM lp) {
             }
             EnableWindow(hBuildBtn, FALSE);
             EnableWindow(hCancelBtn, TRUE);
-            logMessages.clear();
-            cancelRequested.store(false, std::memory_order_release);
+            // Предыдущая сборка уже отчиталась WM_BUILD_FINISHED, поток завершается
+            if (buildThread.joinable()) {
+                buildThread.join();
+            }
+            logModel.Clear();
             builder->CancelBuild();
 
-            buildThread = std::thread([hWnd, input, onlineMode]() {
-                BuildThreadProc(hWnd, input, onlineMode);
+            // Свежий токен на каждую сборку: отмена прошлой не должна задеть новую
+            buildStop = std::stop_source{};
+            buildThread = std::thread([hWnd, input, online = onlineMode, stop = buildStop.get_token()]() {
+                BuildThreadProc(hWnd, input, online, stop);
             });
             break;
         }
 
         case ID_BTN_CANCEL:
-            cancelRequested.store(true, std::memory_order_acquire);
+            buildStop.request_stop();
             builder->CancelBuild();
             SetWindowTextW(hStatusText, L"Cancel requested...");
             EnableWindow(hCancelBtn, FALSE);
@@ -215,33 +220,53 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wp, LPARAM lp) {
         return 0;
 
     case WM_BUILD_UPDATE: {
-        if (wp != 0) {
-            int percent = static_cast<int>(wp);
+        // Подтверждаем до чтения: изменения, пришедшие после, пошлют новый сигнал
+        logModel.Acknowledge();
+
+        static int shownPercent = -1;
+        int percent = logModel.Progress();
+        if (percent != shownPercent) {
+            shownPercent = percent;
             SendMessageW(hProgressBar, PBM_SETPOS, percent, 0);
-            wchar_t buf[128];
-            swprintf_s(buf, L"Progress: %d%%", percent);
-            SetWindowTextW(hStatusText, buf);
-        } else {
-            std::lock_guard<std::mutex> lock(logMutex);
-            int idx = (int)logMessages.size() - 1;
-            if (idx >= 0 && !cancelRequested.load(std::memory_order_acquire)) {
-                SendMessage(hLogList, WM_SETREDRAW, FALSE, 0);
-
-                std::wstring copy = logMessages[idx];
-                LVITEMW lvi{};
-                lvi.mask   = LVIF_TEXT;
-                lvi.iItem  = idx;
-                lvi.pszText= const_cast<wchar_t*>(copy.c_str());
-                ListView_InsertItem(hLogList, &lvi);
-                ListView_EnsureVisible(hLogList, idx, FALSE);
-
-                SendMessage(hLogList, WM_SETREDRAW, TRUE, 0);
-                InvalidateRect(hLogList, nullptr, TRUE);
+            if (percent > 0) {
+                wchar_t buf[128];
+                swprintf_s(buf, L"Progress: %d%%", percent);
+                SetWindowTextW(hStatusText, buf);
+            }
+        }
+
+        // Owner-data: ListView хранит только число строк, текст берёт из модели по запросу
+        static uint64_t shownTotal = 0;
+        uint64_t total = logModel.TotalAppended();
+        if (total != shownTotal || logModel.Size() != (size_t)ListView_GetItemCount(hLogList)) {
+            shownTotal = total;
+            int count = (int)logModel.Size();
+            ListView_SetItemCountEx(hLogList, count, LVSICF_NOSCROLL);
+            if (count > 0) {
+                ListView_EnsureVisible(hLogList, count - 1, FALSE);
             }
+            // При вытеснении старых строк индексы сдвигаются — перерисовываем видимую часть
+            InvalidateRect(hLogList, nullptr, FALSE);
         }
         return 0;
     }
 
+    case WM_NOTIFY: {
+        auto* hdr = reinterpret_cast<NMHDR*>(lp);
+        if (hdr->hwndFrom == hLogList && hdr->code == LVN_GETDISPINFOW) {
+            auto* di = reinterpret_cast<NMLVDISPINFOW*>(lp);
+            if ((di->item.mask & LVIF_TEXT) && di->item.pszText && di->item.cchTextMax > 0) {
+                std::wstring line;
+                if (!logModel.Line((size_t)di->item.iItem, line)) {
+                    line.clear();
+                }
+                wcsncpy_s(di->item.pszText, di->item.cchTextMax, line.c_str(), _TRUNCATE);
+            }
+            return 0;
+        }
+        break;
+    }
+
     case WM_BUILD_FINISHED: {
         bool success = (wp != 0);
         if (success) {
@@ -257,7 +282,8 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wp, LPARAM lp) {
     }
 
     case WM_DESTROY:
-        cancelRequested.store(true, std::memory_order_acquire);
+        logModel.SetNotifier(nullptr);
+        buildStop.request_stop();
         builder->CancelBuild();
         if (buildThread.joinable()) {
             buildThread.join();
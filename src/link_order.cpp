@@ -0,0 +1,169 @@
+// src/link_order.cpp
+#include "link_order.h"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <set>
+
+namespace fs = std::filesystem;
+
+static bool ParseWeight(const std::string& s, uint64_t& out) {
+    if (s.empty() || s.size() > 19) return false;
+    uint64_t v = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + (uint64_t)(c - '0');
+    }
+    out = v;
+    return true;
+}
+
+// Имя попадает в шаблон ld как есть, поэтому спецсимволы glob и разделители недопустимы
+static bool IsLinkerSafeName(const std::string& name) {
+    if (name.empty()) return false;
+    for (unsigned char c : name) {
+        if (c <= ' ' || c >= 0x7F) return false;
+        switch (c) {
+        case '*': case '?': case '[': case ']': case '(': case ')':
+        case '"': case '\\': case ';': case ',': case '/':
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LinkOrder::LoadProfile(const std::wstring& path) {
+    std::ifstream in{ fs::path(path) };
+    if (!in) return false;
+
+    // Вес по порядку для строк без числа: первая строка получает наибольший
+    std::vector<std::pair<std::string, uint64_t>> rows;
+    std::vector<bool> ranked;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        std::istringstream ss(line);
+        std::string a, b;
+        if (!(ss >> a)) continue;
+        ss >> b;
+        uint64_t w = 0;
+        if (!b.empty() && ParseWeight(b, w)) {
+            rows.push_back({ a, w });
+            ranked.push_back(false);
+        } else if (!b.empty() && ParseWeight(a, w)) {
+            rows.push_back({ b, w });
+            ranked.push_back(false);
+        } else {
+            rows.push_back({ a, 0 });
+            ranked.push_back(true);
+        }
+    }
+
+    uint64_t rank = rows.size();
+    std::unordered_map<std::string, size_t> index;
+    hot_.clear();
+    for (size_t i = 0; i < rows.size(); ++i, --rank) {
+        uint64_t w = ranked[i] ? rank : rows[i].second;
+        auto it = index.find(rows[i].first);
+        if (it != index.end()) {
+            hot_[it->second].weight += w;
+        } else {
+            index[rows[i].first] = hot_.size();
+            hot_.push_back({ rows[i].first, w });
+        }
+    }
+    std::stable_sort(hot_.begin(), hot_.end(), [](const HotFunction& x, const HotFunction& y) {
+        return x.weight > y.weight;
+    });
+    return true;
+}
+
+bool LinkOrder::LoadSymbols(const std::wstring& path) {
+    std::ifstream in{ fs::path(path) };
+    if (!in) return false;
+
+    symbols_.clear();
+    std::string line;
+    while (std::getline(in, line)) {
+        // "00001234 00000040 T name" — строки без размера (нет -S) пропускаем
+        std::istringstream ss(line);
+        std::string addr, size, type, name;
+        if (!(ss >> addr >> size >> type >> name)) continue;
+        if (type.size() != 1) continue;
+        char t = type[0];
+        if (t != 't' && t != 'T' && t != 'W' && t != 'w') continue;
+        try {
+            CodeSymbol sym;
+            sym.address = std::stoull(addr, nullptr, 16);
+            sym.size    = std::stoull(size, nullptr, 16);
+            if (sym.size == 0) continue;
+            symbols_[name] = sym;
+        } catch (...) {
+            continue;
+        }
+    }
+    return true;
+}
+
+std::string LinkOrder::ScriptFragment() const {
+    std::string out = "/* Сгенерировано x360make по профилю: горячие функции по убыванию веса */\n";
+    std::string patterns;
+    for (const auto& f : hot_) {
+        if (!IsLinkerSafeName(f.name)) continue;
+        patterns += "*(.text." + f.name + ")\n";
+    }
+    // Выравнивание на страницу только при непустом наборе: иначе xex.ld
+    // ставит __hot_text_start__ сам (PROVIDE) и не теряет место на паддинг
+    if (!patterns.empty()) {
+        out += ". = ALIGN(0x1000);\n__hot_text_start__ = .;\n" + patterns;
+    }
+    return out;
+}
+
+bool LinkOrder::WriteScript(const std::wstring& outPath) const {
+    fs::path target(outPath);
+    fs::path tmp = target;
+    tmp += L".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out << ScriptFragment();
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, target, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+LocalityReport LinkOrder::Report(uint64_t pageSize, uint64_t alignment) const {
+    LocalityReport r;
+    r.hotFunctions = hot_.size();
+    if (pageSize == 0) pageSize = 0x1000;
+    if (alignment == 0) alignment = 1;
+
+    std::set<uint64_t> pages;
+    uint64_t packed = 0;    // смещение от начала горячей группы (она выровнена на страницу)
+    for (const auto& f : hot_) {
+        auto it = symbols_.find(f.name);
+        if (it == symbols_.end()) {
+            r.missing.push_back(f.name);
+            continue;
+        }
+        const CodeSymbol& s = it->second;
+        ++r.resolved;
+        r.hotBytes += s.size;
+        for (uint64_t p = s.address / pageSize; p <= (s.address + s.size - 1) / pageSize; ++p) {
+            pages.insert(p);
+        }
+        packed = (packed + alignment - 1) / alignment * alignment + s.size;
+    }
+    r.pagesBefore = pages.size();
+    r.pagesAfter = (size_t)((packed + pageSize - 1) / pageSize);
+    return r;
+}
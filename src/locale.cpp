@@ -1,10 +1,11 @@
 // src/locale.cpp
 #include "locale.h"
+#include "arena.h"
 #include <fstream>
 #include <nlohmann/json.hpp>
 #include <filesystem>
 #include <sstream>
-#include <windows.h>
+#include "utf8.h"
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
@@ -38,26 +39,7 @@ bool Locale::Utf8ToWStringSafe(const std::string& utf8, std::wstring& out) {
     {
         start = 3;
     }
-    int needed = MultiByteToWideChar(
-        CP_UTF8, MB_ERR_INVALID_CHARS,
-        utf8.data() + start, (int)utf8.size() - (int)start,
-        nullptr, 0
-    );
-    if (needed <= 0) {
-        out.clear();
-        return false;
-    }
-    out.resize(needed);
-    int ret = MultiByteToWideChar(
-        CP_UTF8, MB_ERR_INVALID_CHARS,
-        utf8.data() + start, (int)utf8.size() - (int)start,
-        &out[0], needed
-    );
-    if (ret <= 0) {
-        out.clear();
-        return false;
-    }
-    return true;
+    return Utf8ToWStringStrict(std::string_view(utf8).substr(start), out);
 }
 
 LangMap& Locale::GetLangMap() {
@@ -137,22 +119,22 @@ bool Locale::LoadLanguage(const std::string& lang_code) {
         return false;
     }
 
+    // Временные строки конвертации общие на весь файл: в куче остаются только
+    // ключи и значения самой карты, без промежуточных копий на каждую пару
+    AllocScope allocScope(AllocSite::Locale);
     LangMap newMap;
+    newMap.reserve(j.size());
+    std::wstring keyW, valW;
     for (auto& item : j.items()) {
         const auto& keyUtf8 = item.key();
         if (keyUtf8.empty()) continue;
+        if (!item.value().is_string()) continue;
+        const auto& valUtf8 = item.value().get_ref<const std::string&>();
 
-        std::string valUtf8;
-        try {
-            valUtf8 = item.value().get<std::string>();
-        } catch (...) {
-            continue;
-        }
-
-        std::wstring keyW, valW;
         if (!Utf8ToWStringSafe(keyUtf8, keyW)) continue;
         if (!Utf8ToWStringSafe(valUtf8, valW)) continue;
-        newMap.emplace(std::move(keyW), std::move(valW));
+        newMap.emplace(keyW, valW);
+        allocScope.Unit();
     }
 
     GetLangMap().swap(newMap);
@@ -0,0 +1,85 @@
+// src/log_model.cpp
+#include "log_model.h"
+#include <algorithm>
+
+LogModel::LogModel(size_t capacity)
+    : capacity_(capacity > 0 ? capacity : 1)
+{
+    ring_.resize(capacity_);
+}
+
+void LogModel::SetNotifier(std::function<void()> notify) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    notify_ = std::move(notify);
+}
+
+void LogModel::Changed() {
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+    if (pending_.exchange(true, std::memory_order_acq_rel)) {
+        return;   // представление ещё не забрало прошлый сигнал
+    }
+    std::function<void()> notify;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        notify = notify_;
+    }
+    if (notify) notify();
+}
+
+void LogModel::Acknowledge() {
+    pending_.store(false, std::memory_order_release);
+}
+
+void LogModel::Append(std::wstring line) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        size_t pos = (head_ + count_) % capacity_;
+        ring_[pos] = std::move(line);
+        if (count_ < capacity_) {
+            ++count_;
+        } else {
+            head_ = (head_ + 1) % capacity_;
+        }
+        ++total_;
+    }
+    Changed();
+}
+
+void LogModel::SetProgress(int percent) {
+    percent = std::clamp(percent, 0, 100);
+    if (progress_.exchange(percent, std::memory_order_acq_rel) == percent) {
+        return;
+    }
+    Changed();
+}
+
+void LogModel::Clear() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto& s : ring_) {
+            std::wstring().swap(s);
+        }
+        head_ = 0;
+        count_ = 0;
+        total_ = 0;
+    }
+    progress_.store(0, std::memory_order_release);
+    Changed();
+}
+
+size_t LogModel::Size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return count_;
+}
+
+uint64_t LogModel::TotalAppended() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return total_;
+}
+
+bool LogModel::Line(size_t index, std::wstring& out) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (index >= count_) return false;
+    out = ring_[(head_ + index) % capacity_];
+    return true;
+}
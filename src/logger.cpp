@@ -1,64 +1,67 @@
 // src/logger.cpp
 #include "logger.h"
-#include <windows.h>
+#include "arena.h"
+#include "metrics.h"
+#include "utf8.h"
 #include <chrono>
 #include <locale>
 #include <filesystem>
-#include <fcntl.h>
-#include <io.h>
 #include <iostream>
 #include <clocale>
+#include <cstdio>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 using namespace std::chrono;
 namespace fs = std::filesystem;
 
+// Пул строк сообщений: сколько памяти он держит и какие строки слишком велики, чтобы держать
+static const size_t MAX_SPARE_BYTES = 1024 * 1024;
+static const size_t MAX_SPARE_CAPACITY = 1024;
+
+// Метрики логгера общие для всех экземпляров процесса
+struct LoggerMetrics {
+    MetricCounter& lines   = Metrics::Counter("x360_logger_lines_total", "Log lines written");
+    MetricCounter& bytes   = Metrics::Counter("x360_logger_bytes_total", "Bytes written to log files");
+    MetricCounter& dropped = Metrics::Counter("x360_logger_dropped_total",
+                                              "Log lines discarded on queue overflow");
+    MetricGauge& depth     = Metrics::Gauge("x360_logger_queue_depth",
+                                            "Log lines waiting for the writer thread");
+};
+
+static LoggerMetrics& LogMetrics() {
+    static LoggerMetrics m;
+    return m;
+}
+
 void AsyncFileLogger::EnsureConsoleUnicode() {
     std::setlocale(LC_ALL, "");
+#ifdef _WIN32
     _setmode(_fileno(stdout), _O_U16TEXT);
+#endif
 }
 
+// Файл пишется байтами UTF-8: строка перекодируется в utf8_ и уходит как есть,
+// без codecvt потока и без WinAPI, поэтому логгер одинаково работает на Windows и Linux
 bool AsyncFileLogger::OpenFileWithBOM(const std::wstring& path) {
-    HANDLE hFile = CreateFileW(
-        path.c_str(),
-        GENERIC_WRITE,
-        FILE_SHARE_READ | FILE_SHARE_WRITE,
-        nullptr,
-        CREATE_ALWAYS,
-        FILE_ATTRIBUTE_NORMAL,
-        nullptr
-    );
-    if (hFile == INVALID_HANDLE_VALUE) {
-        std::wcerr << L"Logger: CreateFileW failed, err=" << GetLastError() << std::endl;
-        return false;
-    }
-    DWORD written = 0;
-    uint8_t bom[] = {0xEF, 0xBB, 0xBF};
-    if (!WriteFile(hFile, bom, 3, &written, nullptr) || written != 3) {
-        std::wcerr << L"Logger: WriteFile BOM failed, err=" << GetLastError() << std::endl;
-        CloseHandle(hFile);
-        return false;
-    }
-
-    int fd = _open_osfhandle((intptr_t)hFile, _O_APPEND | _O_U8TEXT);
-    if (fd < 0) {
-        std::wcerr << L"Logger: _open_osfhandle failed" << std::endl;
-        CloseHandle(hFile);
+    currentFile_.open(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+    if (!currentFile_.is_open()) {
+        currentFile_.clear();
+        std::wcerr << L"Logger: cannot open " << path << std::endl;
         return false;
     }
-    FILE* fp = _fdopen(fd, "w, ccs=UTF-8");
-    if (!fp) {
-        std::wcerr << L"Logger: _fdopen failed" << std::endl;
-        _close(fd);
-        return false;
-    }
-    currentFile_.attach(fp);
+    static const char bom[] = { '\xEF', '\xBB', '\xBF' };
+    currentFile_.write(bom, sizeof(bom));
     currentFile_.flush();
-    auto pos = currentFile_.tellp();
-    if (pos == -1) {
-        fileSize_.store(0, std::memory_order_relaxed);
-    } else {
-        fileSize_.store(static_cast<size_t>(pos), std::memory_order_relaxed);
+    if (!currentFile_.good()) {
+        std::wcerr << L"Logger: cannot write BOM to " << path << std::endl;
+        currentFile_.close();
+        currentFile_.clear();
+        return false;
     }
+    fileSize_.store(sizeof(bom), std::memory_order_relaxed);
     return true;
 }
 
@@ -85,7 +88,7 @@ AsyncFileLogger::~AsyncFileLogger() {
     Close();
 }
 
-std::wstring AsyncFileLogger::LevelToString(LogLevel level) {
+const wchar_t* AsyncFileLogger::LevelToString(LogLevel level) {
     switch (level) {
         case LogLevel::Debug:   return L"[DEBUG]";
         case LogLevel::Info:    return L"[INFO]";
@@ -96,22 +99,89 @@ std::wstring AsyncFileLogger::LevelToString(LogLevel level) {
     }
 }
 
-std::wstring AsyncFileLogger::Timestamp() {
-    auto now = system_clock::now();
-    auto t   = system_clock::to_time_t(now);
-    tm local_tm;
+void AsyncFileLogger::FormatTimestamp(std::time_t t, wchar_t (&buf)[64]) {
+    tm local_tm{};
+#ifdef _WIN32
     localtime_s(&local_tm, &t);
-    wchar_t buf[64];
-    swprintf_s(buf, L"%04d-%02d-%02d %02d:%02d:%02d",
+#else
+    localtime_r(&t, &local_tm);
+#endif
+    std::swprintf(buf, 64, L"%04d-%02d-%02d %02d:%02d:%02d",
                local_tm.tm_year + 1900,
                local_tm.tm_mon + 1,
                local_tm.tm_mday,
                local_tm.tm_hour,
                local_tm.tm_min,
                local_tm.tm_sec);
+}
+
+std::wstring AsyncFileLogger::Timestamp() {
+    wchar_t buf[64];
+    FormatTimestamp(system_clock::to_time_t(system_clock::now()), buf);
     return buf;
 }
 
+// Собирает строку в line_ (ёмкость переиспользуется) и пишет её
+void AsyncFileLogger::WriteEntry(LogLevel level, const std::wstring& message) {
+    std::time_t now = system_clock::to_time_t(system_clock::now());
+    if (now != lastStampTime_) {
+        FormatTimestamp(now, lastStamp_);
+        lastStampTime_ = now;
+    }
+    line_.clear();
+    line_ += L'[';
+    line_ += lastStamp_;
+    line_ += L"] ";
+    line_ += LevelToString(level);
+    line_ += L' ';
+    line_ += message;
+    line_ += L'\n';
+    WStringToUtf8(line_, utf8_);
+    if (config_.consoleOutput) {
+#ifdef _WIN32
+        std::wcout << line_;
+#else
+        std::cout.write(utf8_.data(), (std::streamsize)utf8_.size());
+#endif
+    }
+    if (config_.sink) {
+        config_.sink(level, message);
+    }
+    if (currentFile_.is_open()) {
+        currentFile_.write(utf8_.data(), (std::streamsize)utf8_.size());
+        // Увеличиваем через атомарный fetch_add
+        fileSize_.fetch_add(utf8_.size(), std::memory_order_relaxed);
+        LogMetrics().bytes.Add(utf8_.size());
+    }
+    LogMetrics().lines.Add();
+}
+
+// Кладёт строку в пул, если она не сверхдлинная и пул не вышел за MAX_SPARE_BYTES; под mtxQueue_
+void AsyncFileLogger::PutSpare(std::wstring&& s) {
+    size_t bytes = s.capacity() * sizeof(wchar_t);
+    if (s.capacity() > MAX_SPARE_CAPACITY || spareBytes_ + bytes > MAX_SPARE_BYTES) return;
+    spareBytes_ += bytes;
+    spare_.push_back(std::move(s));
+}
+
+// Достаёт строку из пула в out; false, если пул пуст. Под mtxQueue_
+bool AsyncFileLogger::TakeSpare(std::wstring& out) {
+    if (spare_.empty()) return false;
+    out = std::move(spare_.back());
+    spare_.pop_back();
+    spareBytes_ -= out.capacity() * sizeof(wchar_t);
+    return true;
+}
+
+// Возвращает строки записанной пачки в пул
+void AsyncFileLogger::Recycle(std::vector<std::pair<LogLevel, std::wstring>>& batch) {
+    std::lock_guard<std::mutex> lock(mtxQueue_);
+    for (auto& entry : batch) {
+        PutSpare(std::move(entry.second));
+    }
+    batch.clear();
+}
+
 void AsyncFileLogger::RotateFileIfNeeded() {
     if (!currentFile_.is_open()) return;
     size_t curSize = fileSize_.load(std::memory_order_acquire);
@@ -121,13 +191,18 @@ void AsyncFileLogger::RotateFileIfNeeded() {
     currentFile_.close();
 
     fs::path oldName = config_.filename;
+    // В имени файла метка без ':' (на Windows это недопустимый символ)
     std::wstring ts = Timestamp();
-    fs::path newName = oldName.string() + L"." + ts + L".log";
+    for (auto& ch : ts) {
+        if (ch == L':') ch = L'-';
+        else if (ch == L' ') ch = L'_';
+    }
+    fs::path newName = oldName.wstring() + L"." + ts + L".log";
     std::error_code ec;
     fs::rename(oldName, newName, ec);
     if (ec) {
         for (int i = 1; i <= 999; ++i) {
-            fs::path alt = oldName.string() + L"." + ts + L"_" + std::to_wstring(i) + L".log";
+            fs::path alt = oldName.wstring() + L"." + ts + L"_" + std::to_wstring(i) + L".log";
             fs::rename(oldName, alt, ec);
             if (!ec) break;
         }
@@ -140,6 +215,8 @@ void AsyncFileLogger::RotateFileIfNeeded() {
 
 void AsyncFileLogger::WorkerThread() {
     std::atomic_thread_fence(std::memory_order_acquire);
+    AllocScope allocScope(AllocSite::Logger);
+    std::vector<std::pair<LogLevel, std::wstring>> localQueue;
     while (true) {
         std::unique_lock<std::mutex> lock(mtxQueue_);
         cv_.wait(lock, [this]() {
@@ -148,61 +225,77 @@ void AsyncFileLogger::WorkerThread() {
         if (!running_.load(std::memory_order_acquire) && queue_.empty()) {
             break;
         }
-        std::queue<std::pair<LogLevel, std::wstring>> localQueue;
+        // Пачка меняется местами с очередью: оба вектора сохраняют ёмкость между итерациями
         std::swap(localQueue, queue_);
         lock.unlock();
+        LogMetrics().depth.Set(0);
 
-        while (!localQueue.empty()) {
-            auto [level, msg] = std::move(localQueue.front());
-            localQueue.pop();
-
-            std::wstring line = L"[" + Timestamp() + L"] "
-                               + LevelToString(level) + L" "
-                               + msg + L"\n";
-            if (config_.consoleOutput) {
-                std::wcout << line;
-            }
-            if (currentFile_.is_open()) {
-                currentFile_ << line;
-                // Увеличиваем через атомарный fetch_add
-                size_t bytes = line.size() * sizeof(wchar_t);
-                fileSize_.fetch_add(bytes, std::memory_order_relaxed);
-                RotateFileIfNeeded();
-            }
+        for (auto& [level, msg] : localQueue) {
+            WriteEntry(level, msg);
+            allocScope.Unit();
+            RotateFileIfNeeded();
         }
+        Recycle(localQueue);
     }
 
     while (true) {
-        std::pair<LogLevel, std::wstring> entry;
         {
             std::lock_guard<std::mutex> lock2(mtxQueue_);
             if (queue_.empty()) break;
-            entry = std::move(queue_.front());
-            queue_.pop();
-        }
-        std::wstring line = L"[" + Timestamp() + L"] "
-                           + LevelToString(entry.first) + L" "
-                           + entry.second + L"\n";
-        if (config_.consoleOutput) {
-            std::wcout << line;
+            std::swap(localQueue, queue_);
         }
-        if (currentFile_.is_open()) {
-            currentFile_ << line;
+        for (auto& [level, msg] : localQueue) {
+            WriteEntry(level, msg);
+            allocScope.Unit();
         }
+        localQueue.clear();
     }
     if (currentFile_.is_open()) {
         currentFile_.close();
     }
 }
 
+void AsyncFileLogger::DropIfFull() {
+    if (queue_.size() >= config_.maxQueueSize) {
+        LogMetrics().dropped.Add(queue_.size());
+        // Переполнение: как и раньше, отбрасываем накопленное; строки уходят в пул
+        for (auto& entry : queue_) {
+            PutSpare(std::move(entry.second));
+        }
+        queue_.clear();
+    }
+}
+
 void AsyncFileLogger::Log(LogLevel level, const std::wstring& message) {
     if (level < config_.minLevel) return;
     {
+        AllocScope allocScope(AllocSite::Logger);
+        std::lock_guard<std::mutex> lock(mtxQueue_);
+        DropIfFull();
+        std::wstring text;
+        TakeSpare(text);
+        text.assign(message);
+        queue_.emplace_back(level, std::move(text));
+        LogMetrics().depth.Set((int64_t)queue_.size());
+    }
+    cv_.notify_one();
+}
+
+void AsyncFileLogger::Log(LogLevel level, std::wstring&& message) {
+    if (level < config_.minLevel) return;
+    {
+        AllocScope allocScope(AllocSite::Logger);
         std::lock_guard<std::mutex> lock(mtxQueue_);
-        if (queue_.size() >= config_.maxQueueSize) {
-            queue_ = std::queue<std::pair<LogLevel, std::wstring>>();
+        DropIfFull();
+        queue_.emplace_back(level, std::move(message));
+        // Взамен вызывающий получает строку из пула: временная строка вернёт её в кучу,
+        // а переиспользуемый буфер вызывающего дальше пишется без аллокаций
+        std::wstring spare;
+        if (TakeSpare(spare)) {
+            spare.clear();
+            message.swap(spare);
         }
-        queue_.emplace(level, message);
+        LogMetrics().depth.Set((int64_t)queue_.size());
     }
     cv_.notify_one();
 }
@@ -0,0 +1,30 @@
+// src/main.cpp
+#include "cli.h"
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include "gui.h"
+#else
+#include "utf8.h"
+#endif
+
+// Точка входа: без аргументов — GUI (только Windows), с аргументами — CLI (см. cli.h)
+#ifdef _WIN32
+int wmain(int argc, wchar_t** argv) {
+    if (argc <= 1) {
+        // Консольная подсистема: окно консоли GUI не нужно
+        FreeConsole();
+        return RunGUI(GetModuleHandleW(nullptr), SW_SHOWDEFAULT);
+    }
+    return RunCLI(std::vector<std::wstring>(argv + 1, argv + argc));
+}
+#else
+int main(int argc, char** argv) {
+    std::vector<std::wstring> args;
+    args.reserve(argc > 1 ? argc - 1 : 0);
+    for (int i = 1; i < argc; ++i) {
+        args.push_back(Utf8ToWString(argv[i]));
+    }
+    return RunCLI(args);
+}
+#endif
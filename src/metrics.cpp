@@ -0,0 +1,316 @@
+// src/metrics.cpp
+#include "metrics.h"
+#include "utf8.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <bit>
+#include <algorithm>
+#include <cstdio>
+
+namespace fs = std::filesystem;
+using namespace std::chrono;
+
+// ----------------------------- MetricHistogram -----------------------------
+
+size_t MetricHistogram::BucketIndex(uint64_t v) {
+    if (v < kSubBuckets) return (size_t)v;
+    int e = std::bit_width(v) - 1;                      // старший бит, ≥ kSubBits
+    size_t sub = (size_t)(v >> (e - kSubBits)) & (kSubBuckets - 1);
+    return ((size_t)(e - kSubBits + 1) << kSubBits) + sub;
+}
+
+uint64_t MetricHistogram::BucketUpper(size_t index) {
+    if (index < kSubBuckets) return index;
+    size_t group = index >> kSubBits;
+    size_t sub = index & (kSubBuckets - 1);
+    int shift = (int)group - 1;                         // ширина корзины = 2^shift
+    uint64_t lower = (uint64_t)(kSubBuckets + sub) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void MetricHistogram::Record(uint64_t v) {
+    buckets_[BucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(v, std::memory_order_relaxed);
+    uint64_t m = max_.load(std::memory_order_relaxed);
+    while (v > m && !max_.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+}
+
+uint64_t MetricHistogram::Percentile(double q) const {
+    uint64_t total = Count();
+    if (total == 0) return 0;
+    q = q < 0 ? 0 : (q > 1 ? 1 : q);
+    uint64_t rank = (uint64_t)(q * (double)(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += BucketCount(i);
+        if (seen >= rank) return std::min(BucketUpper(i), Max());
+    }
+    return Max();
+}
+
+// ----------------------------- реестр -----------------------------
+
+namespace {
+
+enum class MetricKind { Counter, Gauge, Histogram };
+
+struct MetricEntry {
+    MetricKind kind;
+    std::string name;
+    std::string help;
+    std::string labels;
+    std::unique_ptr<MetricCounter> counter;
+    std::unique_ptr<MetricGauge> gauge;
+    std::unique_ptr<MetricHistogram> histogram;
+};
+
+struct Registry {
+    std::mutex mtx;
+    // Ключ (имя, метки): экспорт идёт по имени, и одно семейство выводится подряд
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<MetricEntry>> entries;
+};
+
+Registry& GetRegistry() {
+    static Registry r;
+    return r;
+}
+
+const char* KindName(MetricKind kind);
+
+// nullptr — серия уже зарегистрирована с другим типом. Это ошибка в коде вызывающего:
+// сообщаем о ней сразу, а обновления уходят в несвязанную метрику (см. Metrics::Counter)
+MetricEntry* Find(MetricKind kind, const char* name, const char* help,
+                  const std::string& labels, double unit)
+{
+    Registry& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    auto& slot = r.entries[{ name, labels }];
+    if (!slot) {
+        slot = std::make_unique<MetricEntry>();
+        slot->kind = kind;
+        slot->name = name;
+        slot->help = help;
+        slot->labels = labels;
+        switch (kind) {
+        case MetricKind::Counter:   slot->counter = std::make_unique<MetricCounter>(); break;
+        case MetricKind::Gauge:     slot->gauge = std::make_unique<MetricGauge>(); break;
+        case MetricKind::Histogram: slot->histogram = std::make_unique<MetricHistogram>(unit); break;
+        }
+    } else if (slot->kind != kind) {
+        std::fprintf(stderr, "metrics: %s{%s} is a %s, requested as %s; updates are dropped\n",
+                     name, labels.c_str(), KindName(slot->kind), KindName(kind));
+        return nullptr;
+    }
+    return slot.get();
+}
+
+std::string Number(double v) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.9g", v);
+    return buf;
+}
+
+std::string WithLabels(const std::string& labels, const std::string& extra = {}) {
+    if (labels.empty() && extra.empty()) return {};
+    if (labels.empty()) return "{" + extra + "}";
+    if (extra.empty()) return "{" + labels + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+const char* KindName(MetricKind kind) {
+    switch (kind) {
+    case MetricKind::Counter:   return "counter";
+    case MetricKind::Gauge:     return "gauge";
+    case MetricKind::Histogram: return "histogram";
+    }
+    return "untyped";
+}
+
+// Фоновый экспорт
+struct Exporter {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread thread;
+    bool stop = false;
+    std::wstring path;
+};
+
+Exporter& GetExporter() {
+    static Exporter e;
+    return e;
+}
+
+} // namespace
+
+// Несвязанные метрики для конфликта типов: не экспортируются, ссылка остаётся валидной
+MetricCounter& Metrics::Counter(const char* name, const char* help, const std::string& labels) {
+    static MetricCounter detached;
+    MetricEntry* e = Find(MetricKind::Counter, name, help, labels, 1.0);
+    return e ? *e->counter : detached;
+}
+
+MetricGauge& Metrics::Gauge(const char* name, const char* help, const std::string& labels) {
+    static MetricGauge detached;
+    MetricEntry* e = Find(MetricKind::Gauge, name, help, labels, 1.0);
+    return e ? *e->gauge : detached;
+}
+
+MetricHistogram& Metrics::Histogram(const char* name, const char* help, double unit,
+                                    const std::string& labels)
+{
+    static MetricHistogram detached;
+    MetricEntry* e = Find(MetricKind::Histogram, name, help, labels, unit);
+    return e ? *e->histogram : detached;
+}
+
+std::string Metrics::Label(const char* key, const std::string& value) {
+    std::string out = key;
+    out += "=\"";
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+    return out;
+}
+
+std::string Metrics::Label(const char* key, const std::wstring& value) {
+    return Label(key, WStringToUtf8(value));
+}
+
+std::string Metrics::PrometheusText() {
+    Registry& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    std::string out;
+    std::string family;
+    for (const auto& [key, e] : r.entries) {
+        if (e->name != family) {
+            family = e->name;
+            out += "# HELP " + e->name + " " + e->help + "\n";
+            out += "# TYPE " + e->name + " " + KindName(e->kind) + "\n";
+        }
+        if (e->kind == MetricKind::Counter) {
+            out += e->name + WithLabels(e->labels) + " " + std::to_string(e->counter->Value()) + "\n";
+        } else if (e->kind == MetricKind::Gauge) {
+            out += e->name + WithLabels(e->labels) + " " + std::to_string(e->gauge->Value()) + "\n";
+        } else {
+            // Границы le — все концы октав 0, 1, 3, 7 … 2^64 − 1, включая пустые: набор
+            // серий одинаков в каждой выгрузке, и rate() по корзинам не ломается от появления
+            // новых le. Подкорзины остаются внутри процесса для перцентилей сводки
+            const MetricHistogram& h = *e->histogram;
+            uint64_t cum = 0;
+            for (size_t i = 0; i < MetricHistogram::kBuckets; ++i) {
+                cum += h.BucketCount(i);
+                uint64_t upper = MetricHistogram::BucketUpper(i);
+                if ((upper & (upper + 1)) != 0) continue;
+                out += e->name + "_bucket" +
+                       WithLabels(e->labels, "le=\"" + Number((double)upper * h.Unit()) + "\"") +
+                       " " + std::to_string(cum) + "\n";
+            }
+            // +Inf и _count — сумма тех же корзин, а не Count(): Record мог пройти посреди
+            // обхода, и последняя le тогда оказалась бы больше +Inf
+            const uint64_t total = cum;
+            out += e->name + "_bucket" + WithLabels(e->labels, "le=\"+Inf\"") + " " +
+                   std::to_string(total) + "\n";
+            out += e->name + "_sum" + WithLabels(e->labels) + " " +
+                   Number((double)h.Sum() * h.Unit()) + "\n";
+            out += e->name + "_count" + WithLabels(e->labels) + " " + std::to_string(total) + "\n";
+        }
+    }
+    return out;
+}
+
+bool Metrics::WritePrometheus(const std::wstring& path) {
+    fs::path target(path);
+    fs::path tmp = target;
+    tmp += L".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << PrometheusText();
+        if (!out.good()) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, target, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+void Metrics::StartExport(const std::wstring& path, int intervalMs) {
+    StopExport();
+    Exporter& ex = GetExporter();
+    {
+        std::lock_guard<std::mutex> lock(ex.mtx);
+        ex.stop = false;
+        ex.path = path;
+    }
+    if (intervalMs <= 0) intervalMs = 1000;
+    ex.thread = std::thread([&ex, intervalMs]() {
+        std::unique_lock<std::mutex> lock(ex.mtx);
+        while (!ex.stop) {
+            std::wstring p = ex.path;
+            lock.unlock();
+            WritePrometheus(p);
+            lock.lock();
+            ex.cv.wait_for(lock, milliseconds(intervalMs), [&ex]() { return ex.stop; });
+        }
+    });
+}
+
+void Metrics::StopExport() {
+    Exporter& ex = GetExporter();
+    if (!ex.thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(ex.mtx);
+        ex.stop = true;
+    }
+    ex.cv.notify_all();
+    ex.thread.join();
+    WritePrometheus(ex.path);
+}
+
+std::vector<MetricSnapshot> Metrics::Snapshot() {
+    Registry& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    std::vector<MetricSnapshot> out;
+    for (const auto& [key, e] : r.entries) {
+        MetricSnapshot s;
+        s.name = e->name;
+        s.labels = e->labels;
+        s.kind = KindName(e->kind);
+        if (e->kind == MetricKind::Counter) {
+            if (e->counter->Value() == 0) continue;
+            s.value = (double)e->counter->Value();
+        } else if (e->kind == MetricKind::Gauge) {
+            if (e->gauge->Value() == 0 && e->gauge->Max() == 0) continue;
+            s.value = (double)e->gauge->Value();
+            s.max = (double)e->gauge->Max();
+        } else {
+            const MetricHistogram& h = *e->histogram;
+            if (h.Count() == 0) continue;
+            s.count = h.Count();
+            s.value = (double)h.Sum() * h.Unit();
+            s.max = (double)h.Max() * h.Unit();
+            s.p50 = (double)h.Percentile(0.50) * h.Unit();
+            s.p90 = (double)h.Percentile(0.90) * h.Unit();
+            s.p99 = (double)h.Percentile(0.99) * h.Unit();
+        }
+        out.push_back(std::move(s));
+    }
+    return out;
+}
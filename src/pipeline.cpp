@@ -0,0 +1,144 @@
+// src/pipeline.cpp
+#include "pipeline.h"
+#include "trace.h"
+#include <thread>
+#include <chrono>
+
+using namespace std::chrono;
+
+Pipeline::Pipeline(std::function<bool(const PipelineEmit& emit)> source)
+    : source_(std::move(source))
+{
+}
+
+void Pipeline::AddStage(PipelineStage stage) {
+    auto rt = std::make_unique<StageRuntime>();
+    if (stage.workers < 1) stage.workers = 1;
+    rt->input = std::make_unique<BoundedQueue<std::wstring>>(stage.queueCapacity);
+    std::string label = Metrics::Label("stage", stage.name);
+    rt->itemsTotal = &Metrics::Counter("x360_pipeline_items_total", "Items processed by a pipeline stage",
+                                       label);
+    rt->itemSeconds = &Metrics::Histogram("x360_pipeline_item_seconds",
+                                          "Time a pipeline stage spends on one item", 1e-6, label);
+    rt->stage = std::move(stage);
+    stages_.push_back(std::move(rt));
+}
+
+void Pipeline::Fail() {
+    failed_.store(true, std::memory_order_release);
+    for (auto& st : stages_) {
+        st->input->Abort();
+    }
+}
+
+void Pipeline::Cancel() {
+    Fail();
+}
+
+bool Pipeline::EmitTo(size_t index, const std::wstring& item) {
+    if (failed_.load(std::memory_order_acquire)) return false;
+    if (index >= stages_.size()) {
+        std::lock_guard<std::mutex> lock(outMtx_);
+        outputs_.push_back(item);
+        return true;
+    }
+    return stages_[index]->input->Push(item);
+}
+
+void Pipeline::StageWorker(size_t index) {
+    StageRuntime& rt = *stages_[index];
+    PipelineEmit emit = [this, index](const std::wstring& item) {
+        return EmitTo(index + 1, item);
+    };
+
+    std::wstring item;
+    while (rt.input->Pop(item)) {
+        TRACE_SCOPE("pipeline", "stage", rt.stage.name);
+        auto t0 = steady_clock::now();
+        bool ok = false;
+        try {
+            ok = rt.stage.process ? rt.stage.process(item, emit) : emit(item);
+        } catch (...) {
+            ok = false;
+        }
+        uint64_t us = (uint64_t)duration_cast<microseconds>(steady_clock::now() - t0).count();
+        rt.busyUs.fetch_add(us, std::memory_order_relaxed);
+        rt.items.fetch_add(1, std::memory_order_relaxed);
+        rt.itemsTotal->Add();
+        rt.itemSeconds->Record(us);
+        if (!ok) {
+            Fail();
+            break;
+        }
+    }
+
+    // Последний воркер стадии вызывает finish и закрывает вход следующей стадии
+    if (rt.activeWorkers.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    if (!failed_.load(std::memory_order_acquire) && rt.stage.finish) {
+        TRACE_SCOPE("pipeline", "stage finish", rt.stage.name);
+        auto t0 = steady_clock::now();
+        bool ok = false;
+        try {
+            ok = rt.stage.finish(emit);
+        } catch (...) {
+            ok = false;
+        }
+        rt.busyUs.fetch_add((uint64_t)duration_cast<microseconds>(steady_clock::now() - t0).count(),
+                            std::memory_order_relaxed);
+        if (!ok) Fail();
+    }
+    if (index + 1 < stages_.size()) {
+        stages_[index + 1]->input->Close();
+    }
+}
+
+bool Pipeline::Run(std::stop_token stop) {
+    failed_.store(false, std::memory_order_release);
+    outputs_.clear();
+    std::stop_callback onStop(stop, [this]() { Cancel(); });
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        stages_[i]->activeWorkers.store(stages_[i]->stage.workers, std::memory_order_release);
+        for (int w = 0; w < stages_[i]->stage.workers; ++w) {
+            threads.emplace_back(&Pipeline::StageWorker, this, i);
+        }
+    }
+
+    // Источник работает в вызывающем потоке и упирается в ёмкость первой очереди
+    bool sourceOk = false;
+    try {
+        sourceOk = source_ ? source_([this](const std::wstring& item) { return EmitTo(0, item); })
+                           : true;
+    } catch (...) {
+        sourceOk = false;
+    }
+    if (!sourceOk) {
+        Fail();
+    } else if (!stages_.empty()) {
+        stages_[0]->input->Close();
+    }
+
+    for (auto& th : threads) {
+        th.join();
+    }
+    return sourceOk && !failed_.load(std::memory_order_acquire);
+}
+
+std::vector<std::wstring> Pipeline::Outputs() const {
+    std::lock_guard<std::mutex> lock(outMtx_);
+    return outputs_;
+}
+
+std::vector<PipelineStageStats> Pipeline::Stats() const {
+    std::vector<PipelineStageStats> out;
+    for (const auto& st : stages_) {
+        PipelineStageStats s;
+        s.name     = st->stage.name;
+        s.items    = st->items.load(std::memory_order_relaxed);
+        s.busyMs   = st->busyUs.load(std::memory_order_relaxed) / 1000;
+        s.maxDepth = st->input->MaxDepth();
+        out.push_back(std::move(s));
+    }
+    return out;
+}
@@ -0,0 +1,1123 @@
+// src/remote_exec.cpp
+#include "remote_exec.h"
+#include "sha256.h"
+#include "build_cache.h"
+#include "trace.h"
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <set>
+#include <random>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#endif
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+static const char* kProtocolError = "protocol error";
+
+// Лог процесса может быть не в UTF-8 — невалидные байты заменяем, а не бросаем исключение
+static std::string DumpLine(const json& j) {
+    return j.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+}
+
+static bool IsHexHash(const std::string& s) {
+    if (s.size() != 64) return false;
+    for (char c : s) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    }
+    return true;
+}
+
+// Относительный путь внутри песочницы: без абсолютных путей, '..' и пустых компонентов
+static bool IsSafeRelative(const std::string& name) {
+    if (name.empty() || name[0] == '/' || name.find('\\') != std::string::npos ||
+        name.find('\0') != std::string::npos)
+    {
+        return false;
+    }
+    size_t start = 0;
+    while (start <= name.size()) {
+        size_t end = name.find('/', start);
+        if (end == std::string::npos) end = name.size();
+        std::string part = name.substr(start, end - start);
+        if (part.empty() || part == "." || part == "..") return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+std::string RemoteExecutor::ActionKey(const RemoteAction& action,
+                                      const std::vector<std::string>& inputHashes)
+{
+    // Длины перед строками — чтобы разные разбиения argv не давали одинаковый поток байт
+    Sha256 h;
+    auto put = [&h](const std::string& s) {
+        h.Update(std::to_string(s.size()) + ":");
+        h.Update(s);
+    };
+    put("x360make-remote-v1");
+    for (const auto& a : action.argv) put("arg:" + a);
+    for (size_t i = 0; i < action.inputs.size(); ++i) {
+        put("in:" + action.inputs[i].name);
+        put(i < inputHashes.size() ? inputHashes[i] : std::string());
+    }
+    for (const auto& o : action.outputs) put("out:" + o.name);
+    return h.FinalHex();
+}
+
+#if defined(__linux__)
+
+static std::string Unhex(const std::string& hex) {
+    std::string out;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        out.push_back((char)std::stoi(hex.substr(i, 2), nullptr, 16));
+    }
+    return out;
+}
+
+// HMAC-SHA256 (RFC 2104) в hex
+static std::string HmacHex(const std::string& key, const std::string& message) {
+    std::string k = key;
+    if (k.size() > 64) {
+        Sha256 h;
+        h.Update(k);
+        k = Unhex(h.FinalHex());
+    }
+    k.resize(64, '\0');
+    std::string ipad(64, '\0'), opad(64, '\0');
+    for (size_t i = 0; i < 64; ++i) {
+        ipad[i] = (char)(k[i] ^ 0x36);
+        opad[i] = (char)(k[i] ^ 0x5c);
+    }
+    Sha256 inner;
+    inner.Update(ipad);
+    inner.Update(message);
+    Sha256 outer;
+    outer.Update(opad);
+    outer.Update(Unhex(inner.FinalHex()));
+    return outer.FinalHex();
+}
+
+// Ответ на nonce воркера: секрет по сети не передаётся, а старый ответ не подходит к новому nonce
+static std::string AuthToken(const std::string& secret, const std::string& nonce) {
+    return HmacHex(secret, "x360make-remote-v1:" + nonce);
+}
+
+// Сравнение без раннего выхода: время ответа не выдаёт длину совпавшего префикса
+static bool SameDigest(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) return false;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < a.size(); ++i) diff |= (unsigned char)(a[i] ^ b[i]);
+    return diff == 0;
+}
+
+static std::string NewNonce() {
+    std::random_device rd;
+    std::string out;
+    char buf[9];
+    for (int i = 0; i < 8; ++i) {
+        std::snprintf(buf, sizeof(buf), "%08x", (unsigned)rd());
+        out += buf;
+    }
+    return out;
+}
+
+static bool WriteAll(int fd, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    size_t off = 0;
+    while (off < size) {
+        ssize_t n = send(fd, p + off, size - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        off += (size_t)n;
+    }
+    return true;
+}
+
+static bool WriteAll(int fd, const std::string& data) {
+    return WriteAll(fd, data.data(), data.size());
+}
+
+// Читает одну строку без '\n'. pending хранит прочитанное сверх строки.
+static bool ReadLine(int fd, std::string& pending, std::string& line) {
+    const size_t MAX_LINE = 16 * 1024 * 1024;   // exec с тысячами входов — длинная строка
+    size_t scanned = 0;
+    while (true) {
+        size_t pos = pending.find('\n', scanned);
+        if (pos != std::string::npos) {
+            line = pending.substr(0, pos);
+            pending.erase(0, pos + 1);
+            return true;
+        }
+        scanned = pending.size();
+        if (pending.size() > MAX_LINE) return false;
+        char buf[64 * 1024];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        pending.append(buf, (size_t)n);
+    }
+}
+
+// Читает ровно size байт (сначала из pending) и отдаёт их блоками в sink
+static bool ReadExact(int fd, std::string& pending, uint64_t size,
+                      const std::function<bool(const char*, size_t)>& sink)
+{
+    if (!pending.empty()) {
+        size_t take = (size_t)std::min<uint64_t>(size, pending.size());
+        if (!sink(pending.data(), take)) return false;
+        pending.erase(0, take);
+        size -= take;
+    }
+    char buf[64 * 1024];
+    while (size > 0) {
+        ssize_t n = recv(fd, buf, (size_t)std::min<uint64_t>(size, sizeof(buf)), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        if (!sink(buf, (size_t)n)) return false;
+        size -= (uint64_t)n;
+    }
+    return true;
+}
+
+static bool SendFileBytes(int fd, const std::string& path, uint64_t expected) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<char> buf(64 * 1024);
+    uint64_t sent = 0;
+    while (sent < expected) {
+        in.read(buf.data(), (std::streamsize)std::min<uint64_t>(buf.size(), expected - sent));
+        std::streamsize got = in.gcount();
+        if (got <= 0) return false;
+        if (!WriteAll(fd, buf.data(), (size_t)got)) return false;
+        sent += (uint64_t)got;
+    }
+    return true;
+}
+
+static int ConnectTcp(const std::string& host, uint16_t port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+static bool ParseAddress(const std::string& address, std::string& host, uint16_t& port) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0) return false;
+    host = address.substr(0, colon);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    try {
+        int p = std::stoi(address.substr(colon + 1));
+        if (p <= 0 || p > 65535) return false;
+        port = (uint16_t)p;
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+// Клиентская часть hello: читает nonce, отвечает HMAC и ждёт {"slots",...}
+static bool Handshake(int fd, const std::string& secret, std::string& pending, json& reply) {
+    std::string line;
+    if (!ReadLine(fd, pending, line)) return false;
+    std::string nonce;
+    try {
+        nonce = json::parse(line).at("nonce").get<std::string>();
+    } catch (...) {
+        return false;
+    }
+    if (!WriteAll(fd, DumpLine({ {"op", "hello"}, {"auth", AuthToken(secret, nonce)} })) ||
+        !ReadLine(fd, pending, line))
+    {
+        return false;
+    }
+    try {
+        reply = json::parse(line);
+    } catch (...) {
+        return false;
+    }
+    return reply.contains("slots");
+}
+
+// ----------------------------- воркер -----------------------------
+
+RemoteWorker::RemoteWorker(const RemoteWorkerConfig& config)
+    : config_(config)
+{
+    if (config_.slots <= 0) {
+        config_.slots = (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+    freeSlots_ = config_.slots;
+}
+
+RemoteWorker::~RemoteWorker() {
+    Stop();
+}
+
+std::string RemoteWorker::BlobPath(const std::string& hash) const {
+    return root_ + "/blobs/" + hash.substr(0, 2) + "/" + hash;
+}
+
+bool RemoteWorker::Start() {
+    if (running_.load(std::memory_order_acquire) || config_.root.empty()) return false;
+    // Воркер исполняет чужие команды: без секрета и списка инструментов не слушаем вовсе
+    if (config_.secret.empty() || config_.tools.empty()) return false;
+
+    std::error_code ec;
+    fs::create_directories(fs::path(config_.root) / "blobs", ec);
+    fs::create_directories(fs::path(config_.root) / "tmp", ec);
+    // Песочницы от прошлого запуска (воркер убили посреди действия)
+    fs::remove_all(fs::path(config_.root) / "work", ec);
+    fs::create_directories(fs::path(config_.root) / "work", ec);
+    if (ec) return false;
+    root_ = fs::path(config_.root).string();
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(config_.bindAddress.c_str(), std::to_string(config_.port).c_str(), &hints, &res) != 0) {
+        return false;
+    }
+    listenFd_ = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol);
+    if (listenFd_ >= 0) {
+        int one = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listenFd_, res->ai_addr, res->ai_addrlen) != 0 || listen(listenFd_, 64) != 0) {
+            close(listenFd_);
+            listenFd_ = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (listenFd_ < 0) return false;
+
+    sockaddr_storage bound{};
+    socklen_t len = sizeof(bound);
+    getsockname(listenFd_, (sockaddr*)&bound, &len);
+    port_ = ntohs(bound.ss_family == AF_INET6 ? ((sockaddr_in6*)&bound)->sin6_port
+                                              : ((sockaddr_in*)&bound)->sin_port);
+
+    running_.store(true, std::memory_order_release);
+    acceptThread_ = std::thread(&RemoteWorker::AcceptThread, this);
+    return true;
+}
+
+void RemoteWorker::Wait() {
+    std::unique_lock<std::mutex> lock(waitMtx_);
+    waitCv_.wait(lock, [this]() { return !running_.load(std::memory_order_acquire); });
+}
+
+void RemoteWorker::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(waitMtx_);
+        running_.store(false, std::memory_order_release);
+    }
+    waitCv_.notify_all();
+    if (listenFd_ >= 0) shutdown(listenFd_, SHUT_RDWR);
+    if (acceptThread_.joinable()) acceptThread_.join();
+    {
+        std::lock_guard<std::mutex> lock(clientsMtx_);
+        // Клиент может висеть в recv() между командами — shutdown будит его,
+        // а HandleExec по обрыву соединения убивает запущенный процесс
+        for (auto& c : clients_) shutdown(c.fd, SHUT_RDWR);
+        for (auto& c : clients_) {
+            if (c.thread.joinable()) c.thread.join();
+            close(c.fd);
+        }
+        clients_.clear();
+    }
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+        listenFd_ = -1;
+    }
+}
+
+void RemoteWorker::AcceptThread() {
+    if (Tracer::Enabled()) Tracer::SetThreadName("remote worker accept");
+    while (running_.load(std::memory_order_acquire)) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::lock_guard<std::mutex> lock(clientsMtx_);
+        // Подбираем завершившиеся соединения, чтобы список не рос бесконечно
+        for (auto it = clients_.begin(); it != clients_.end();) {
+            if (it->done->load(std::memory_order_acquire)) {
+                it->thread.join();
+                close(it->fd);
+                it = clients_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        std::thread th([this, fd, done]() {
+            HandleClient(fd);
+            done->store(true, std::memory_order_release);
+        });
+        clients_.push_back(Client{ std::move(th), done, fd });
+    }
+}
+
+void RemoteWorker::AcquireSlot() {
+    std::unique_lock<std::mutex> lock(slotMtx_);
+    slotCv_.wait(lock, [this]() { return freeSlots_ > 0; });
+    --freeSlots_;
+    runningCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RemoteWorker::ReleaseSlot() {
+    {
+        std::lock_guard<std::mutex> lock(slotMtx_);
+        ++freeSlots_;
+        runningCount_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    slotCv_.notify_one();
+}
+
+bool RemoteWorker::ReceiveBlob(int fd, std::string& pending, const std::string& hash, uint64_t size) {
+    std::string tmp = root_ + "/tmp/" + hash + "." +
+                      std::to_string(sandboxSeq_.fetch_add(1, std::memory_order_relaxed));
+    Sha256 h;
+    bool ok;
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        ok = (bool)out && ReadExact(fd, pending, size, [&](const char* p, size_t n) {
+            h.Update(p, n);
+            out.write(p, (std::streamsize)n);
+            return (bool)out;
+        });
+    }
+    std::error_code ec;
+    if (!ok || h.FinalHex() != hash) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    // Блоб неизменяем: песочницы получают его жёсткой ссылкой
+    chmod(tmp.c_str(), 0444);
+    std::string dst = BlobPath(hash);
+    fs::create_directories(fs::path(dst).parent_path(), ec);
+    fs::rename(tmp, dst, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return fs::exists(dst);
+    }
+    return true;
+}
+
+bool RemoteWorker::StoreOutput(const std::string& path, std::string& hash, uint64_t& size) {
+    std::error_code ec;
+    if (!fs::is_regular_file(path, ec)) return false;
+    size = fs::file_size(path, ec);
+    if (ec) return false;
+    if (!Sha256::HashFile(fs::path(path).wstring(), hash)) return false;
+    std::string dst = BlobPath(hash);
+    if (fs::exists(dst, ec)) return true;
+    chmod(path.c_str(), 0444);
+    fs::create_directories(fs::path(dst).parent_path(), ec);
+    fs::rename(path, dst, ec);
+    return !ec || fs::exists(dst);
+}
+
+bool RemoteWorker::SendFile(int fd, const std::string& path) {
+    std::error_code ec;
+    uint64_t size = fs::file_size(path, ec);
+    return !ec && SendFileBytes(fd, path, size);
+}
+
+bool RemoteWorker::HandleExec(int fd, std::string& pending, const std::string& request) {
+    json req;
+    try {
+        req = json::parse(request);
+    } catch (...) {
+        return false;
+    }
+    if (!req.contains("argv") || !req["argv"].is_array() || req["argv"].empty()) {
+        return false;
+    }
+    std::vector<std::string> argv;
+    std::vector<std::pair<std::string, std::string>> inputs;    // имя → hash
+    std::vector<std::string> outputs;
+    try {
+        for (const auto& a : req["argv"]) argv.push_back(a.get<std::string>());
+        for (const auto& in : req.value("inputs", json::array())) {
+            std::string name = in.at("name").get<std::string>();
+            std::string hash = in.at("hash").get<std::string>();
+            if (!IsSafeRelative(name) || !IsHexHash(hash)) return false;
+            inputs.push_back({ name, hash });
+        }
+        for (const auto& o : req.value("outputs", json::array())) {
+            std::string name = o.get<std::string>();
+            if (!IsSafeRelative(name)) return false;
+            outputs.push_back(name);
+        }
+    } catch (...) {
+        return false;
+    }
+    if (std::find(config_.tools.begin(), config_.tools.end(), argv[0]) == config_.tools.end()) {
+        WriteAll(fd, DumpLine({ {"error", "tool not allowed: " + argv[0]} }));
+        return false;
+    }
+
+    // Ключ кеша считаем сами: клиентский мог бы указать на чужой результат
+    RemoteAction action;
+    action.argv = argv;
+    std::vector<std::string> inputHashes;
+    for (const auto& in : inputs) {
+        action.inputs.push_back({ in.first, std::wstring() });
+        inputHashes.push_back(in.second);
+    }
+    for (const auto& o : outputs) action.outputs.push_back({ o, std::wstring() });
+    std::string key = RemoteExecutor::ActionKey(action, inputHashes);
+    std::string claimed = req.value("key", std::string());
+    if (!claimed.empty() && claimed != key) {
+        WriteAll(fd, DumpLine({ {"error", "action key mismatch"} }));
+        return false;
+    }
+    TRACE_SCOPE("remote", "exec", fs::path(argv[0]).wstring());
+
+    // Тот же ключ уже выполнялся успешно и его выходы на месте — отдаём сразу
+    CachedAction cached;
+    bool hit = false;
+    {
+        std::lock_guard<std::mutex> lock(cacheMtx_);
+        auto it = actionCache_.find(key);
+        if (it != actionCache_.end()) {
+            hit = true;
+            for (const auto& o : it->second.outputs) {
+                std::error_code ec;
+                if (!fs::exists(BlobPath(o.second), ec)) hit = false;
+            }
+            if (hit) cached = it->second;
+        }
+    }
+
+    std::vector<std::string> missing;
+    if (!hit) {
+        std::set<std::string> seen;
+        for (const auto& in : inputs) {
+            std::error_code ec;
+            if (!fs::exists(BlobPath(in.second), ec) && seen.insert(in.second).second) {
+                missing.push_back(in.second);
+            }
+        }
+    }
+    if (!WriteAll(fd, DumpLine({ {"missing", missing} }))) return false;
+
+    for (size_t i = 0; i < missing.size(); ++i) {
+        std::string line;
+        if (!ReadLine(fd, pending, line)) return false;
+        json blob;
+        try {
+            blob = json::parse(line);
+        } catch (...) {
+            return false;
+        }
+        if (blob.value("op", std::string()) != "blob" ||
+            blob.value("hash", std::string()) != missing[i] || !blob.contains("size"))
+        {
+            return false;
+        }
+        if (!ReceiveBlob(fd, pending, missing[i], blob["size"].get<uint64_t>())) return false;
+    }
+
+    if (!hit) {
+        // Песочница: входы — reflink или копии блобов. Жёсткая ссылка дала бы инструменту
+        // писать прямо в хранилище (права 0444 владельцу файла не помеха)
+        std::string box = root_ + "/work/" + std::to_string(getpid()) + "-" +
+                          std::to_string(sandboxSeq_.fetch_add(1, std::memory_order_relaxed));
+        std::error_code ec;
+        fs::create_directories(box, ec);
+        bool staged = !ec;
+        for (const auto& in : inputs) {
+            if (!staged) break;
+            fs::path dst = fs::path(box) / in.first;
+            if (!BuildCache::CloneFile(fs::path(BlobPath(in.second)).wstring(), dst.wstring())) {
+                staged = false;
+            }
+        }
+        for (const auto& o : outputs) {
+            fs::create_directories((fs::path(box) / o).parent_path(), ec);
+        }
+        if (!staged) {
+            fs::remove_all(box, ec);
+            WriteAll(fd, DumpLine({ {"log", "remote: cannot stage inputs"} }));
+            WriteAll(fd, DumpLine({ {"done", true}, {"exit", -1}, {"cached", false},
+                                    {"running", runningCount_.load()}, {"outputs", json::array()} }));
+            return true;
+        }
+
+        AcquireSlot();
+        int exitCode = -1;
+        bool peerGone = false;
+        int pipeFd[2];
+        if (pipe2(pipeFd, O_CLOEXEC) == 0) {
+            std::vector<char*> cargv;
+            for (auto& a : argv) cargv.push_back(a.data());
+            cargv.push_back(nullptr);
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                // Своя группа процессов — при обрыве убиваем всё дерево инструмента
+                setpgid(0, 0);
+                dup2(pipeFd[1], 1);
+                dup2(pipeFd[1], 2);
+                int devnull = open("/dev/null", O_RDONLY);
+                if (devnull >= 0) dup2(devnull, 0);
+                if (chdir(box.c_str()) != 0) _exit(126);
+                execvp(cargv[0], cargv.data());
+                _exit(127);
+            }
+            close(pipeFd[1]);
+            if (pid > 0) {
+                setpgid(pid, pid);
+                std::string buf;
+                char chunk[4096];
+                bool eof = false;
+                while (!eof) {
+                    pollfd pfd[2] = { { pipeFd[0], POLLIN, 0 }, { fd, POLLIN, 0 } };
+                    int r = poll(pfd, 2, 500);
+                    if (r < 0 && errno != EINTR) break;
+                    if (pfd[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                        char probe;
+                        ssize_t n = recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+                        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                            peerGone = true;
+                            kill(-pid, SIGKILL);
+                        }
+                    }
+                    if (pfd[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+                        ssize_t n = read(pipeFd[0], chunk, sizeof(chunk));
+                        if (n < 0 && errno == EINTR) continue;
+                        if (n <= 0) {
+                            eof = true;
+                        } else {
+                            buf.append(chunk, (size_t)n);
+                        }
+                        size_t pos;
+                        while ((pos = buf.find('\n')) != std::string::npos) {
+                            if (!peerGone) WriteAll(fd, DumpLine({ {"log", buf.substr(0, pos)} }));
+                            buf.erase(0, pos + 1);
+                        }
+                        if (eof && !buf.empty() && !peerGone) {
+                            WriteAll(fd, DumpLine({ {"log", buf} }));
+                        }
+                    }
+                    if (peerGone && !eof) continue;
+                }
+                int status = 0;
+                while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+                exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            }
+            close(pipeFd[0]);
+        }
+        ReleaseSlot();
+
+        if (peerGone) {
+            fs::remove_all(box, ec);
+            return false;
+        }
+
+        cached = CachedAction{};
+        cached.exitCode = exitCode;
+        bool allOutputs = true;
+        for (const auto& o : outputs) {
+            std::string hash;
+            uint64_t size = 0;
+            if (StoreOutput((fs::path(box) / o).string(), hash, size)) {
+                cached.outputs.push_back({ o, hash });
+                cached.sizes.push_back(size);
+            } else {
+                allOutputs = false;
+            }
+        }
+        fs::remove_all(box, ec);
+
+        if (exitCode == 0 && allOutputs) {
+            std::lock_guard<std::mutex> lock(cacheMtx_);
+            // Кеш действий ограничен; при переполнении начинаем заново — блобы остаются
+            if (actionCache_.size() >= 65536) actionCache_.clear();
+            actionCache_[key] = cached;
+        }
+    }
+
+    json outs = json::array();
+    for (size_t i = 0; i < cached.outputs.size(); ++i) {
+        outs.push_back({ {"name", cached.outputs[i].first}, {"hash", cached.outputs[i].second},
+                         {"size", cached.sizes[i]} });
+    }
+    json done = { {"done", true}, {"exit", cached.exitCode}, {"cached", hit},
+                  {"running", runningCount_.load()}, {"outputs", outs} };
+    if (!WriteAll(fd, DumpLine(done))) return false;
+    for (const auto& o : cached.outputs) {
+        if (!SendFile(fd, BlobPath(o.second))) return false;
+    }
+    return true;
+}
+
+void RemoteWorker::HandleClient(int fd) {
+    const std::string nonce = NewNonce();
+    if (!WriteAll(fd, DumpLine({ {"nonce", nonce} }))) return;
+    bool authed = false;
+    std::string pending, line;
+    while (running_.load(std::memory_order_acquire) && ReadLine(fd, pending, line)) {
+        json req;
+        try {
+            req = json::parse(line);
+        } catch (...) {
+            break;
+        }
+        std::string op = req.value("op", std::string());
+        if (op == "hello") {
+            if (!authed) {
+                std::string auth = req.value("auth", std::string());
+                if (!SameDigest(auth, AuthToken(config_.secret, nonce))) {
+                    WriteAll(fd, DumpLine({ {"error", "unauthorized"} }));
+                    break;
+                }
+                authed = true;
+            }
+            if (!WriteAll(fd, DumpLine({ {"slots", config_.slots}, {"running", runningCount_.load()} }))) {
+                break;
+            }
+        } else if (op == "exec" && authed) {
+            if (!HandleExec(fd, pending, line)) break;
+        } else {
+            WriteAll(fd, DumpLine({ {"error", authed ? kProtocolError : "unauthorized"} }));
+            break;
+        }
+    }
+    // fd закрывает владелец списка clients_ после join: Stop делает ему shutdown
+}
+
+// ----------------------------- координатор -----------------------------
+
+RemoteExecutor::RemoteExecutor(const RemoteExecConfig& config)
+    : config_(config)
+{
+    for (const auto& a : config_.workers) {
+        Worker w;
+        w.address = a;
+        if (ParseAddress(a, w.host, w.port)) workers_.push_back(w);
+    }
+}
+
+bool RemoteExecutor::Probe(const Worker& w, int& slots, int& running) {
+    int fd = ConnectTcp(w.host, w.port);
+    if (fd < 0) return false;
+    bool alive = false;
+    std::string pending;
+    json j;
+    if (Handshake(fd, config_.secret, pending, j)) {
+        try {
+            slots = std::max(1, j.value("slots", 1));
+            running = std::max(0, j.value("running", 0));
+            alive = true;
+        } catch (...) {
+            alive = false;
+        }
+    }
+    close(fd);
+    return alive;
+}
+
+void RemoteExecutor::MarkProbed(Worker& w, bool alive, int slots, int running) {
+    w.alive = alive;
+    w.probing = false;
+    if (alive) {
+        w.slots = slots;
+        w.external = running;
+        w.failures = 0;
+        return;
+    }
+    // Пауза до следующего hello: 0,5 с × 2^(сбоев подряд - 1), не больше 30 с
+    w.failures = std::min(w.failures + 1, 7);
+    auto backoff = std::min(std::chrono::milliseconds(500) * (1 << (w.failures - 1)),
+                            std::chrono::milliseconds(30000));
+    w.retryAt = std::chrono::steady_clock::now() + backoff;
+}
+
+bool RemoteExecutor::Connect() {
+    bool any = false;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        Worker w;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            w = workers_[i];
+        }
+        int slots = 1;
+        int running = 0;
+        bool alive = Probe(w, slots, running);
+        std::lock_guard<std::mutex> lock(mtx_);
+        MarkProbed(workers_[i], alive, slots, running);
+        any = any || alive;
+    }
+    cv_.notify_all();
+    return any;
+}
+
+void RemoteExecutor::ReviveWorkers() {
+    std::vector<size_t> due;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            Worker& w = workers_[i];
+            if (w.alive || w.probing || w.retryAt > now) continue;
+            w.probing = true;             // опрашивает один поток, остальные идут мимо
+            due.push_back(i);
+        }
+    }
+    if (due.empty()) return;
+    for (size_t i : due) {
+        Worker w;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            w = workers_[i];
+        }
+        int slots = 1;
+        int running = 0;
+        bool alive = Probe(w, slots, running);
+        std::lock_guard<std::mutex> lock(mtx_);
+        MarkProbed(workers_[i], alive, slots, running);
+    }
+    cv_.notify_all();
+}
+
+size_t RemoteExecutor::WorkerCount() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    size_t n = 0;
+    for (const auto& w : workers_) n += w.alive ? 1 : 0;
+    return n;
+}
+
+int RemoteExecutor::TotalSlots() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    int n = 0;
+    for (const auto& w : workers_) n += w.alive ? w.slots : 0;
+    return n;
+}
+
+// Наименее загруженный живой воркер со свободным слотом. Загрузка — наши действия плюс
+// чужие по последнему ответу, делённые на число слотов. Если все заняты — ждём освобождения.
+int RemoteExecutor::PickWorker(const std::vector<int>& exclude, std::stop_token stop) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!stop.stop_requested()) {
+        int best = -1;
+        double bestLoad = 0;
+        bool anyCandidate = false;
+        for (int i = 0; i < (int)workers_.size(); ++i) {
+            const Worker& w = workers_[i];
+            if (!w.alive || std::find(exclude.begin(), exclude.end(), i) != exclude.end()) continue;
+            anyCandidate = true;
+            if (w.inflight >= w.slots) continue;
+            double load = (double)(w.inflight + w.external) / (double)w.slots;
+            if (best < 0 || load < bestLoad) {
+                best = i;
+                bestLoad = load;
+            }
+        }
+        if (!anyCandidate) return -1;
+        if (best >= 0) {
+            ++workers_[best].inflight;
+            return best;
+        }
+        cv_.wait_for(lock, std::chrono::milliseconds(50));
+    }
+    return -1;
+}
+
+void RemoteExecutor::ReleaseWorker(int index, int reportedRunning) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Worker& w = workers_[index];
+        --w.inflight;
+        // В ответе воркера посчитаны и наши остальные действия — их вычитаем
+        if (reportedRunning >= 0) w.external = std::max(0, reportedRunning - w.inflight);
+    }
+    cv_.notify_all();
+}
+
+bool RemoteExecutor::HashInput(const std::wstring& path, std::string& hash, uint64_t& size) {
+    std::error_code ec;
+    size = fs::file_size(path, ec);
+    if (ec) return false;
+    int64_t mtime = (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+    if (ec) return false;
+    {
+        std::lock_guard<std::mutex> lock(hashMtx_);
+        auto it = hashCache_.find(path);
+        if (it != hashCache_.end() && it->second.size == size && it->second.mtime == mtime) {
+            hash = it->second.hash;
+            return true;
+        }
+    }
+    if (!Sha256::HashFile(path, hash)) return false;
+    std::lock_guard<std::mutex> lock(hashMtx_);
+    hashCache_[path] = { size, mtime, hash };
+    return true;
+}
+
+// 0 — действие отработало (результат в result), 1 — сбой связи с воркером (можно повторить
+// на другом), 2 — отмена, 3 — локальная ошибка (выход не записался и т.п.)
+int RemoteExecutor::RunOn(int index, const RemoteAction& action, const std::vector<std::string>& hashes,
+                          const std::vector<uint64_t>& sizes, RemoteResult& result,
+                          const std::function<void(const std::string&)>& onLog, std::stop_token stop,
+                          int& reportedRunning)
+{
+    std::string host;
+    uint16_t port;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        host = workers_[index].host;
+        port = workers_[index].port;
+        result.worker = workers_[index].address;
+    }
+    int fd = ConnectTcp(host, port);
+    if (fd < 0) return 1;
+    int rc;
+    {
+        // Отмена рвёт соединение: воркер убьёт процесс, а наши recv вернут ошибку.
+        // Колбэк снимается до close: иначе shutdown мог бы попасть в чужой сокет с тем же номером
+        std::stop_callback onStop(stop, [fd]() { shutdown(fd, SHUT_RDWR); });
+        rc = Exchange(fd, action, hashes, sizes, result, onLog, reportedRunning);
+    }
+    close(fd);
+    return stop.stop_requested() ? 2 : rc;
+}
+
+int RemoteExecutor::Exchange(int fd, const RemoteAction& action, const std::vector<std::string>& hashes,
+                             const std::vector<uint64_t>& sizes, RemoteResult& result,
+                             const std::function<void(const std::string&)>& onLog, int& reportedRunning)
+{
+    std::string pending, line;
+    json hello;
+    if (!Handshake(fd, config_.secret, pending, hello)) {
+        if (onLog && hello.contains("error")) {
+            onLog(result.worker + ": " + hello.value("error", std::string()) + "\n");
+        }
+        return 1;
+    }
+
+    json inputs = json::array();
+    for (size_t i = 0; i < action.inputs.size(); ++i) {
+        inputs.push_back({ {"name", action.inputs[i].name}, {"hash", hashes[i]}, {"size", sizes[i]} });
+    }
+    json outputs = json::array();
+    for (const auto& o : action.outputs) outputs.push_back(o.name);
+    json req = { {"op", "exec"}, {"key", result.key}, {"argv", action.argv},
+                 {"inputs", inputs}, {"outputs", outputs} };
+
+    if (!WriteAll(fd, DumpLine(req)) || !ReadLine(fd, pending, line)) return 1;
+
+    // Докачиваем только то, чего у воркера нет. Отказ воркера (инструмент не разрешён,
+    // ключ не сошёлся) — ошибка действия, а не связи: повтор на другом воркере не поможет
+    std::vector<std::string> missing;
+    try {
+        json j = json::parse(line);
+        if (j.contains("error")) {
+            if (onLog) onLog(result.worker + ": " + j.value("error", std::string()) + "\n");
+            return 3;
+        }
+        missing = j.at("missing").get<std::vector<std::string>>();
+    } catch (...) {
+        return 1;
+    }
+    for (const auto& h : missing) {
+        size_t i = 0;
+        while (i < hashes.size() && hashes[i] != h) ++i;
+        if (i == hashes.size()) return 1;
+        if (!WriteAll(fd, DumpLine({ {"op", "blob"}, {"hash", h}, {"size", sizes[i]} })) ||
+            !SendFileBytes(fd, fs::path(action.inputs[i].localPath).string(), sizes[i]))
+        {
+            return 1;
+        }
+        result.uploadedBytes += sizes[i];
+    }
+
+    json done;
+    while (true) {
+        if (!ReadLine(fd, pending, line)) return 1;
+        try {
+            json j = json::parse(line);
+            if (j.contains("log")) {
+                if (onLog) onLog(j["log"].get<std::string>());
+                continue;
+            }
+            if (j.value("done", false)) {
+                done = std::move(j);
+                break;
+            }
+        } catch (...) {
+        }
+        return 1;
+    }
+
+    result.exitCode = done.value("exit", -1);
+    result.cached = done.value("cached", false);
+    reportedRunning = done.value("running", -1);
+
+    // Выходы идут подряд в порядке списка; каждый проверяется по хешу и кладётся атомарно
+    std::vector<bool> received(action.outputs.size(), false);
+    for (const auto& o : done.value("outputs", json::array())) {
+        std::string name, hash;
+        uint64_t size = 0;
+        try {
+            name = o.at("name").get<std::string>();
+            hash = o.at("hash").get<std::string>();
+            size = o.at("size").get<uint64_t>();
+        } catch (...) {
+            return 1;
+        }
+        size_t i = 0;
+        while (i < action.outputs.size() && action.outputs[i].name != name) ++i;
+        if (i == action.outputs.size()) return 1;
+
+        fs::path dst(action.outputs[i].localPath);
+        fs::path tmp = dst;
+        tmp += L".remote-tmp";
+        std::error_code ec;
+        if (dst.has_parent_path()) fs::create_directories(dst.parent_path(), ec);
+        Sha256 h;
+        bool writable;
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            writable = (bool)out;
+            bool ok = ReadExact(fd, pending, size, [&](const char* p, size_t n) {
+                h.Update(p, n);
+                if (writable) {
+                    out.write(p, (std::streamsize)n);
+                    writable = (bool)out;
+                }
+                return true;    // поток дочитываем в любом случае, иначе соединение рассинхронизируется
+            });
+            if (!ok) {
+                out.close();
+                fs::remove(tmp, ec);
+                return 1;
+            }
+        }
+        if (!writable || h.FinalHex() != hash) {
+            fs::remove(tmp, ec);
+            return writable ? 1 : 3;
+        }
+        fs::rename(tmp, dst, ec);
+        if (ec) {
+            fs::remove(tmp, ec);
+            return 3;
+        }
+        received[i] = true;
+    }
+
+    result.ok = result.exitCode == 0 &&
+                std::all_of(received.begin(), received.end(), [](bool b) { return b; });
+    return 0;
+}
+
+bool RemoteExecutor::Execute(const RemoteAction& action, RemoteResult& result,
+                             const std::function<void(const std::string&)>& onLog,
+                             std::stop_token stop)
+{
+    result = RemoteResult{};
+    auto start = std::chrono::steady_clock::now();
+    if (action.argv.empty()) return false;
+    TRACE_SCOPE("remote", "action", fs::path(action.argv[0]).wstring());
+
+    std::vector<std::string> hashes(action.inputs.size());
+    std::vector<uint64_t> sizes(action.inputs.size());
+    for (size_t i = 0; i < action.inputs.size(); ++i) {
+        if (!IsSafeRelative(action.inputs[i].name) ||
+            !HashInput(action.inputs[i].localPath, hashes[i], sizes[i]))
+        {
+            return false;
+        }
+    }
+    for (const auto& o : action.outputs) {
+        if (!IsSafeRelative(o.name)) return false;
+    }
+    result.key = ActionKey(action, hashes);
+
+    std::vector<int> tried;
+    for (int attempt = 0; attempt <= std::max(0, config_.retries); ++attempt) {
+        ReviveWorkers();
+        int index = PickWorker(tried, stop);
+        if (index < 0) break;
+        int reported = -1;
+        RemoteResult attemptResult;
+        attemptResult.key = result.key;
+        int rc = RunOn(index, action, hashes, sizes, attemptResult, onLog, stop, reported);
+        ReleaseWorker(index, reported);
+        if (rc == 1) {
+            // Сбой связи: воркер выходит из ротации до повторного hello после паузы
+            std::lock_guard<std::mutex> lock(mtx_);
+            MarkProbed(workers_[index], false, 0, 0);
+            tried.push_back(index);
+            continue;
+        }
+        result = attemptResult;
+        break;
+    }
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result.ok;
+}
+
+#else
+
+RemoteWorker::RemoteWorker(const RemoteWorkerConfig& config) : config_(config) {}
+RemoteWorker::~RemoteWorker() = default;
+bool RemoteWorker::Start() { return false; }
+void RemoteWorker::Wait() {}
+void RemoteWorker::Stop() {}
+
+RemoteExecutor::RemoteExecutor(const RemoteExecConfig& config) : config_(config) {}
+bool RemoteExecutor::Connect() { return false; }
+bool RemoteExecutor::Execute(const RemoteAction&, RemoteResult& result,
+                             const std::function<void(const std::string&)>&, std::stop_token)
+{
+    result = RemoteResult{};
+    return false;
+}
+size_t RemoteExecutor::WorkerCount() const { return 0; }
+int RemoteExecutor::TotalSlots() const { return 0; }
+
+#endif
@@ -0,0 +1,325 @@
+// src/resource_governor.cpp
+#include "resource_governor.h"
+#include "metrics.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+using namespace std::chrono;
+
+// ----------------------------- ResourceLease -----------------------------
+
+ResourceLease::ResourceLease(ResourceLease&& other) noexcept
+    : governor_(other.governor_), request_(other.request_), nest_(std::move(other.nest_))
+{
+    other.governor_ = nullptr;
+}
+
+ResourceLease& ResourceLease::operator=(ResourceLease&& other) noexcept {
+    if (this != &other) {
+        Release();
+        governor_ = other.governor_;
+        request_ = other.request_;
+        nest_ = std::move(other.nest_);
+        other.governor_ = nullptr;
+    }
+    return *this;
+}
+
+void ResourceLease::Release() {
+    if (governor_) {
+        governor_->Release(request_, nest_.get());
+        governor_ = nullptr;
+        nest_.reset();
+    }
+}
+
+// Бюджет родителя для Acquire/TryAcquire текущего потока
+static thread_local std::shared_ptr<LeaseNest> t_nest;
+
+ResourceLease::Scope::Scope(const ResourceLease& lease)
+    : prev_(t_nest)
+{
+    // Пустая резервация ничего не даёт вложенной работе: остаётся бюджет внешнего Scope
+    if (lease) {
+        auto nest = std::make_shared<LeaseNest>();
+        nest->governor = lease.governor_;
+        nest->budget = lease.request_;
+        t_nest = std::move(nest);
+    }
+}
+
+ResourceLease::Scope::Scope(std::shared_ptr<LeaseNest> nest)
+    : prev_(t_nest)
+{
+    if (nest) t_nest = std::move(nest);
+}
+
+ResourceLease::Scope::~Scope() {
+    t_nest = std::move(prev_);
+}
+
+std::shared_ptr<LeaseNest> ResourceLease::CurrentNest() {
+    return t_nest;
+}
+
+// ----------------------------- опрос системы -----------------------------
+
+#if defined(__linux__)
+// "some avg10=1.23 avg60=..." → 1.23
+static bool ReadPressure(const char* path, double& avg10) {
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.rfind("some ", 0) != 0) continue;
+        size_t pos = line.find("avg10=");
+        if (pos == std::string::npos) return false;
+        try {
+            avg10 = std::stod(line.substr(pos + 6));
+        } catch (...) {
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+#endif
+
+SystemResources ResourceGovernor::ReadSystem() {
+    SystemResources r;
+#if defined(_WIN32)
+    MEMORYSTATUSEX ms{};
+    ms.dwLength = sizeof(ms);
+    if (GlobalMemoryStatusEx(&ms)) {
+        r.valid = true;
+        r.totalMemory = ms.ullTotalPhys;
+        r.availableMemory = ms.ullAvailPhys;
+    }
+#elif defined(__linux__)
+    std::ifstream in("/proc/meminfo");
+    std::string key;
+    uint64_t value = 0;
+    std::string unit;
+    while (in >> key >> value) {
+        std::getline(in, unit);
+        if (key == "MemTotal:") {
+            r.totalMemory = value * 1024;
+        } else if (key == "MemAvailable:") {
+            r.availableMemory = value * 1024;
+            r.valid = true;
+        }
+    }
+    ReadPressure("/proc/pressure/memory", r.memoryPressure);
+    ReadPressure("/proc/pressure/io", r.ioPressure);
+#endif
+    return r;
+}
+
+// ----------------------------- ResourceGovernor -----------------------------
+
+// Метрики допуска; при нескольких экземплярах суммируются
+struct GovernorMetrics {
+    MetricGauge& reservedMemory = Metrics::Gauge("x360_governor_reserved_memory_bytes",
+                                                 "Memory reserved by admitted jobs");
+    MetricGauge& waiting   = Metrics::Gauge("x360_governor_waiting", "Jobs waiting for admission");
+    MetricCounter& admitted = Metrics::Counter("x360_governor_admitted_total", "Jobs admitted");
+    MetricCounter& deferred = Metrics::Counter("x360_governor_deferred_total",
+                                               "Jobs that had to wait before admission");
+};
+
+static GovernorMetrics& GovMetrics() {
+    static GovernorMetrics m;
+    return m;
+}
+
+ResourceGovernor::ResourceGovernor(const ResourceGovernorConfig& config)
+    : config_(config)
+{
+    if (config_.pollMs <= 0) config_.pollMs = 200;
+    Refresh(true);
+    if (config_.memoryBudget == 0 && system_.valid) {
+        double fraction = std::clamp(config_.memoryFraction, 0.05, 1.0);
+        config_.memoryBudget = (uint64_t)((double)system_.availableMemory * fraction);
+    }
+}
+
+ResourceGovernor& ResourceGovernor::Shared() {
+    static ResourceGovernor governor;
+    return governor;
+}
+
+void ResourceGovernor::Refresh(bool force) {
+    auto now = steady_clock::now();
+    if (!force && now - lastRefresh_ < milliseconds(config_.pollMs)) return;
+    system_ = ReadSystem();
+    lastRefresh_ = now;
+}
+
+bool ResourceGovernor::Fits(const ResourceRequest& request, uint64_t ticket) {
+    // Заждавшийся запрос идёт первым: остальные не обгоняют его, пока он не допущен
+    if (starvingTicket_ != 0 && starvingTicket_ != ticket) return false;
+    if (running_ == 0) return true;
+    if (config_.memoryBudget != 0 && reservedMemory_ + request.memoryBytes > config_.memoryBudget) {
+        return false;
+    }
+    if (config_.ioBudget != 0 && reservedIo_ + request.ioBytesPerSec > config_.ioBudget) {
+        return false;
+    }
+    Refresh(false);
+    if (system_.valid) {
+        if (system_.availableMemory < config_.minAvailable + request.memoryBytes) return false;
+        if (system_.memoryPressure > config_.maxMemoryPressure) return false;
+        if (system_.ioPressure > config_.maxIoPressure) return false;
+    }
+    return true;
+}
+
+// Вложенная резервация влезает, если остаток бюджета родителя её вмещает.
+// Первая вложенная допускается всегда — как и любая резервация у пустого governor.
+// Измерение, которое родитель не резервировал (0), вложенной работе не ограничено.
+bool ResourceGovernor::FitsNest(const LeaseNest& nest, const ResourceRequest& request) {
+    if (nest.children == 0) return true;
+    if (nest.budget.memoryBytes != 0 &&
+        nest.used.memoryBytes + request.memoryBytes > nest.budget.memoryBytes) {
+        return false;
+    }
+    if (nest.budget.ioBytesPerSec != 0 &&
+        nest.used.ioBytesPerSec + request.ioBytesPerSec > nest.budget.ioBytesPerSec) {
+        return false;
+    }
+    return true;
+}
+
+// Ждёт только освобождения соседних вложенных резерваций того же родителя: они уже
+// допущены и идут, так что ожидание конечно. Общий бюджет, PSI и starvingTicket_
+// не проверяются — всё это родитель прошёл при своём допуске.
+ResourceLease ResourceGovernor::AcquireNested(const std::shared_ptr<LeaseNest>& nest,
+                                              const ResourceRequest& request, bool wait,
+                                              std::stop_token stop,
+                                              const std::function<bool()>& cancelled)
+{
+    std::stop_callback onStop(stop, [this]() {
+        { std::lock_guard<std::mutex> guard(mtx_); }
+        cv_.notify_all();
+    });
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!FitsNest(*nest, request)) {
+        if (!wait || stop.stop_requested() || (cancelled && cancelled())) {
+            return ResourceLease();
+        }
+        cv_.wait_for(lock, milliseconds(config_.pollMs));
+    }
+    nest->used.memoryBytes += request.memoryBytes;
+    nest->used.ioBytesPerSec += request.ioBytesPerSec;
+    ++nest->children;
+    return ResourceLease(this, request, nest);
+}
+
+ResourceLease ResourceGovernor::TryAcquire(const ResourceRequest& request) {
+    if (t_nest && t_nest->governor == this) {
+        return AcquireNested(t_nest, request, false, {}, nullptr);
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!Fits(request, 0)) return ResourceLease();
+    reservedMemory_ += request.memoryBytes;
+    reservedIo_ += request.ioBytesPerSec;
+    ++running_;
+    ++admitted_;
+    GovMetrics().admitted.Add();
+    GovMetrics().reservedMemory.Add((int64_t)request.memoryBytes);
+    return ResourceLease(this, request);
+}
+
+ResourceLease ResourceGovernor::Acquire(const ResourceRequest& request,
+                                        std::stop_token stop,
+                                        const std::function<bool()>& cancelled)
+{
+    if (t_nest && t_nest->governor == this) {
+        return AcquireNested(t_nest, request, true, stop, cancelled);
+    }
+    // Будим ожидание сразу по отмене, а не на следующем опросе через pollMs.
+    // Колбэк создаётся до захвата mtx_: при уже запрошенной остановке он вызывается здесь же.
+    std::stop_callback onStop(stop, [this]() {
+        { std::lock_guard<std::mutex> guard(mtx_); }
+        cv_.notify_all();
+    });
+    std::unique_lock<std::mutex> lock(mtx_);
+    uint64_t ticket = nextTicket_++;
+    auto start = steady_clock::now();
+    bool waited = false;
+    while (!Fits(request, ticket)) {
+        if (stop.stop_requested() || (cancelled && cancelled())) {
+            if (starvingTicket_ == ticket) starvingTicket_ = 0;
+            if (waited) {
+                --waiting_;
+                GovMetrics().waiting.Add(-1);
+            }
+            cv_.notify_all();
+            return ResourceLease();
+        }
+        if (!waited) {
+            waited = true;
+            ++waiting_;
+            GovMetrics().waiting.Add(1);
+        }
+        if (starvingTicket_ == 0 && steady_clock::now() - start > milliseconds(config_.starvationMs)) {
+            starvingTicket_ = ticket;
+        }
+        // Ждём освобождения резервации или следующего опроса системы
+        cv_.wait_for(lock, milliseconds(config_.pollMs));
+    }
+    if (starvingTicket_ == ticket) {
+        starvingTicket_ = 0;
+        cv_.notify_all();
+    }
+    if (waited) {
+        --waiting_;
+        ++deferred_;
+        GovMetrics().waiting.Add(-1);
+        GovMetrics().deferred.Add();
+    }
+    reservedMemory_ += request.memoryBytes;
+    reservedIo_ += request.ioBytesPerSec;
+    ++running_;
+    ++admitted_;
+    GovMetrics().admitted.Add();
+    GovMetrics().reservedMemory.Add((int64_t)request.memoryBytes);
+    return ResourceLease(this, request);
+}
+
+void ResourceGovernor::Release(const ResourceRequest& request, LeaseNest* nest) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (nest) {
+            // Вложенная резервация возвращается в бюджет родителя, общий учёт не менялся
+            nest->used.memoryBytes -= std::min(nest->used.memoryBytes, request.memoryBytes);
+            nest->used.ioBytesPerSec -= std::min(nest->used.ioBytesPerSec, request.ioBytesPerSec);
+            --nest->children;
+        } else {
+            reservedMemory_ -= std::min(reservedMemory_, request.memoryBytes);
+            reservedIo_ -= std::min(reservedIo_, request.ioBytesPerSec);
+            --running_;
+            GovMetrics().reservedMemory.Add(-(int64_t)request.memoryBytes);
+        }
+    }
+    cv_.notify_all();
+}
+
+ResourceGovernorStats ResourceGovernor::Stats() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Refresh(false);
+    ResourceGovernorStats s;
+    s.reservedMemory = reservedMemory_;
+    s.reservedIo = reservedIo_;
+    s.memoryBudget = config_.memoryBudget;
+    s.running = running_;
+    s.waiting = waiting_;
+    s.admitted = admitted_;
+    s.deferred = deferred_;
+    s.system = system_;
+    return s;
+}
@@ -0,0 +1,771 @@
+// src/sdk_store.cpp
+#include "sdk_store.h"
+#include "sha256.h"
+#include "build_cache.h"
+#include "unzip.h"
+#include "trace.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <cstring>
+#include <nlohmann/json.hpp>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+// Временный файл или каталог в tmp/ моложе этого может ещё дописываться другим процессом
+const auto STALE_TMP_AGE = std::chrono::hours(1);
+
+// Таблица gear-хеша: 256 псевдослучайных слов (splitmix64), одинаковая на всех машинах,
+// иначе границы чанков и дедупликация зависели бы от сборки
+struct GearTable {
+    uint64_t v[256];
+    constexpr GearTable() : v() {
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        for (int i = 0; i < 256; ++i) {
+            x += 0x9E3779B97F4A7C15ull;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            v[i] = z ^ (z >> 31);
+        }
+    }
+};
+constexpr GearTable kGear;
+
+std::string PathToUtf8(const fs::path& p) {
+    auto s = p.generic_u8string();
+    return std::string(s.begin(), s.end());
+}
+
+fs::path Utf8ToPath(const std::string& s) {
+    return fs::path(std::u8string(s.begin(), s.end()));
+}
+
+// Путь из манифеста не должен выходить из дерева версии
+bool SafeRelative(const fs::path& p) {
+    if (p.empty() || p.is_absolute() || p.has_root_name()) return false;
+    for (const auto& part : p) {
+        if (part == "..") return false;
+    }
+    return true;
+}
+
+// Самое позднее время записи внутри p (для каталога — по всему поддереву)
+fs::file_time_type NewestWrite(const fs::path& p) {
+    std::error_code ec;
+    fs::file_time_type newest = fs::last_write_time(p, ec);
+    if (!fs::is_directory(p, ec)) return newest;
+    for (auto it = fs::recursive_directory_iterator(p, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        std::error_code ec2;
+        newest = std::max(newest, fs::last_write_time(it->path(), ec2));
+    }
+    return newest;
+}
+
+// Что должно остаться прежним у опубликованного blob, чтобы его не перехешировать.
+// ctime сюда не входит: её сдвигает каждая новая жёсткая ссылка из дерева версии.
+// Запись через ссылку меняет mtime, подмена файла — inode.
+struct BlobStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t inode = 0;
+
+    bool operator==(const BlobStamp&) const = default;
+};
+
+bool StatBlob(const fs::path& p, BlobStamp& out) {
+    std::error_code ec;
+    out.size = fs::file_size(p, ec);
+    if (ec) return false;
+    out.mtime = (int64_t)fs::last_write_time(p, ec).time_since_epoch().count();
+    if (ec) return false;
+#if defined(_WIN32)
+    HANDLE h = CreateFileW(p.c_str(), FILE_READ_ATTRIBUTES,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, 0, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    BY_HANDLE_FILE_INFORMATION info{};
+    bool ok = GetFileInformationByHandle(h, &info) != 0;
+    CloseHandle(h);
+    if (!ok) return false;
+    out.inode = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+#else
+    struct stat st {};
+    if (::stat(p.c_str(), &st) != 0) return false;
+    out.inode = (uint64_t)st.st_ino;
+#endif
+    return true;
+}
+
+bool ReadStamp(const fs::path& p, BlobStamp& out) {
+    std::ifstream in(p);
+    return (bool)(in >> out.size >> out.mtime >> out.inode);
+}
+
+// Через временный файл: оборванная запись не оставит штамп, совпадающий с чужим blob
+void WriteStamp(const fs::path& p, const fs::path& tmp, const BlobStamp& stamp) {
+    std::error_code ec;
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) return;
+        out << stamp.size << ' ' << stamp.mtime << ' ' << stamp.inode << '\n';
+        out.close();
+        if (!out.good()) {
+            fs::remove(tmp, ec);
+            return;
+        }
+    }
+    fs::create_directories(p.parent_path(), ec);
+    fs::rename(tmp, p, ec);
+    if (ec) fs::remove(tmp, ec);
+}
+
+// fn(i) для i в [0, count) в threads потоках; false из fn останавливает остальных
+bool ParallelFor(size_t count, int threads, const std::function<bool(size_t)>& fn) {
+    std::atomic<size_t> next(0);
+    std::atomic<bool> ok(true);
+    auto worker = [&]() {
+        while (ok.load(std::memory_order_acquire)) {
+            size_t i = next.fetch_add(1);
+            if (i >= count) break;
+            if (!fn(i)) ok.store(false, std::memory_order_release);
+        }
+    };
+    int n = threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    n = (int)std::min<size_t>((size_t)n, count);
+    std::vector<std::thread> pool;
+    pool.reserve(n);
+    for (int t = 0; t < n; ++t) {
+        pool.emplace_back(worker);
+    }
+    for (auto& th : pool) {
+        th.join();
+    }
+    return ok.load(std::memory_order_acquire);
+}
+
+bool ReadManifest(const fs::path& path, json& doc) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    try {
+        doc = json::parse(in);
+    } catch (...) {
+        return false;
+    }
+    return doc.is_object() && doc.contains("files") && doc["files"].is_array();
+}
+
+} // namespace
+
+// Записи будущего манифеста; AddFile заполняет их из нескольких потоков
+struct SdkStore::ImportState {
+    struct File {
+        std::string path;
+        uint64_t size = 0;
+        std::string hash;
+        bool exec = false;
+        std::vector<std::string> chunks;
+    };
+    std::mutex mtx;
+    std::vector<File> files;
+    std::vector<std::string> dirs;
+    std::vector<std::pair<std::string, std::string>> links;   // путь → цель
+    SdkImportStats stats;
+};
+
+SdkStore::SdkStore(const SdkStoreConfig& config)
+    : config_(config)
+{
+    // Маски FastCDC считаются от степени двойки; границы держим упорядоченными
+    size_t avg = 256;
+    while (avg < config_.avgChunk && avg < (64u << 20)) avg <<= 1;
+    config_.avgChunk = avg;
+    config_.minChunk = std::clamp<size_t>(config_.minChunk, 64, avg);
+    config_.maxChunk = std::max(config_.maxChunk, avg * 2);
+}
+
+std::wstring SdkStore::ChunkPath(const std::string& hash) const {
+    std::wstring shard(hash.begin(), hash.begin() + 2);
+    return (fs::path(config_.root) / L"chunks" / shard / std::wstring(hash.begin(), hash.end())).wstring();
+}
+
+std::wstring SdkStore::BlobPath(const std::string& hash, bool exec) const {
+    std::wstring shard(hash.begin(), hash.begin() + 2);
+    std::wstring name(hash.begin(), hash.end());
+    if (exec) name += L".x";
+    return (fs::path(config_.root) / L"blobs" / shard / name).wstring();
+}
+
+std::wstring SdkStore::StampPath(const std::string& hash, bool exec) const {
+    std::wstring shard(hash.begin(), hash.begin() + 2);
+    std::wstring name(hash.begin(), hash.end());
+    if (exec) name += L".x";
+    return (fs::path(config_.root) / L"stamps" / shard / name).wstring();
+}
+
+std::wstring SdkStore::ManifestPath(const std::wstring& version) const {
+    return (fs::path(config_.root) / L"manifests" / (version + L".json")).wstring();
+}
+
+bool SdkStore::ValidVersion(const std::wstring& version) {
+    if (version.empty() || version.size() > 128 || version[0] == L'.') return false;
+    for (wchar_t c : version) {
+        bool ok = (c >= L'0' && c <= L'9') || (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') ||
+                  c == L'.' || c == L'-' || c == L'_' || c == L'+';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+bool SdkStore::Open() {
+    TRACE_SCOPE("sdk", "Open", config_.root);
+    std::error_code ec;
+    fs::path root(config_.root);
+    for (const wchar_t* sub : { L"chunks", L"blobs", L"stamps", L"manifests", L"tmp" }) {
+        fs::create_directories(root / sub, ec);
+        if (ec) return false;
+    }
+    // Недописанные чанки, blobs и распаковки прерванных импортов. Свежие не трогаем:
+    // это может быть импорт, который прямо сейчас идёт в другом процессе
+    const auto now = fs::file_time_type::clock::now();
+    for (auto& e : fs::directory_iterator(root / L"tmp", ec)) {
+        if (now - NewestWrite(e.path()) <= STALE_TMP_AGE) continue;
+        std::error_code ec2;
+        fs::remove_all(e.path(), ec2);
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    chunks_.clear();
+    chunkBytes_ = 0;
+    for (auto it = fs::recursive_directory_iterator(root / L"chunks", ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        std::error_code ec2;
+        if (!it->is_regular_file(ec2)) continue;
+        chunks_.insert(it->path().filename().string());
+        chunkBytes_ += it->file_size(ec2);
+    }
+    return !ec;
+}
+
+size_t SdkStore::CutPoint(const uint8_t* data, size_t size,
+                          size_t minChunk, size_t avgChunk, size_t maxChunk)
+{
+    if (size <= minChunk) return size;
+    if (size > maxChunk) size = maxChunk;
+    size_t normal = std::min(avgChunk, size);
+
+    // Нормализованное чанкование: до avgChunk условие строже (больше битов),
+    // после — мягче, так что размеры кучнее вокруг среднего.
+    // Берём старшие биты: в них входят последние 64 байта окна, а не 1–2 последних.
+    int bits = 0;
+    while (((size_t)1 << bits) < avgChunk) ++bits;
+    const uint64_t maskHard = ~0ull << (64 - std::min(bits + 2, 63));
+    const uint64_t maskEasy = ~0ull << (64 - std::max(bits - 2, 1));
+
+    uint64_t h = 0;
+    size_t i = minChunk;
+    for (; i < normal; ++i) {
+        h = (h << 1) + kGear.v[data[i]];
+        if ((h & maskHard) == 0) return i + 1;
+    }
+    for (; i < size; ++i) {
+        h = (h << 1) + kGear.v[data[i]];
+        if ((h & maskEasy) == 0) return i + 1;
+    }
+    return size;
+}
+
+bool SdkStore::WriteChunk(const std::string& hash, const uint8_t* data, size_t size, bool& added) {
+    added = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (chunks_.count(hash)) return true;
+    }
+    // Пишем во временный файл и переименовываем: в chunks/ не бывает обрубков
+    fs::path tmp = fs::path(config_.root) / L"tmp" / (hash + "-" + BuildCache::TempSuffix());
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write((const char*)data, (std::streamsize)size);
+        if (!out.good()) {
+            out.close();
+            std::error_code ec;
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+    fs::path dst = ChunkPath(hash);
+    std::error_code ec;
+    fs::create_directories(dst.parent_path(), ec);
+    fs::rename(tmp, dst, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    // Тот же чанк мог параллельно прийти из другого файла: считаем его один раз
+    if (chunks_.insert(hash).second) {
+        chunkBytes_ += size;
+        added = true;
+    }
+    return true;
+}
+
+bool SdkStore::AddFile(ImportState& state, const std::wstring& treeDir, const std::wstring& file,
+                       std::stop_token stop)
+{
+    fs::path rel = fs::path(file).lexically_relative(treeDir);
+    if (!SafeRelative(rel)) return false;
+
+    std::ifstream in(fs::path(file), std::ios::binary);
+    if (!in) return false;
+
+    ImportState::File rec;
+    rec.path = PathToUtf8(rel);
+#if !defined(_WIN32)
+    std::error_code ec;
+    auto perms = fs::status(file, ec).permissions();
+    rec.exec = !ec && (perms & fs::perms::owner_exec) != fs::perms::none;
+#endif
+
+    // Окно в два максимальных чанка: CutPoint всегда видит maxChunk байт, кроме хвоста файла
+    std::vector<uint8_t> buf(config_.maxChunk * 2);
+    size_t len = 0;
+    bool eof = false;
+    Sha256 fileHash;
+    Sha256 chunkHash;
+    uint64_t newChunks = 0;
+    uint64_t newBytes = 0;
+    while (true) {
+        while (!eof && len < buf.size()) {
+            in.read((char*)buf.data() + len, (std::streamsize)(buf.size() - len));
+            size_t got = (size_t)in.gcount();
+            len += got;
+            if (got == 0 || !in) eof = true;
+        }
+        if (len == 0) break;
+        if (stop.stop_requested()) return false;
+
+        size_t cut = CutPoint(buf.data(), len, config_.minChunk, config_.avgChunk, config_.maxChunk);
+        fileHash.Update(buf.data(), cut);
+        chunkHash.Update(buf.data(), cut);
+        std::string hash = chunkHash.FinalHex();
+        bool added = false;
+        if (!WriteChunk(hash, buf.data(), cut, added)) return false;
+        if (added) {
+            ++newChunks;
+            newBytes += cut;
+        }
+        rec.chunks.push_back(std::move(hash));
+        rec.size += cut;
+        std::memmove(buf.data(), buf.data() + cut, len - cut);
+        len -= cut;
+    }
+    if (in.bad()) return false;
+    rec.hash = fileHash.FinalHex();
+
+    std::lock_guard<std::mutex> lock(state.mtx);
+    state.stats.files += 1;
+    state.stats.bytes += rec.size;
+    state.stats.chunks += rec.chunks.size();
+    state.stats.newChunks += newChunks;
+    state.stats.newBytes += newBytes;
+    state.files.push_back(std::move(rec));
+    return true;
+}
+
+bool SdkStore::CommitManifest(const std::wstring& version, ImportState& state) {
+    std::sort(state.files.begin(), state.files.end(),
+              [](const ImportState::File& a, const ImportState::File& b) { return a.path < b.path; });
+    std::sort(state.dirs.begin(), state.dirs.end());
+    std::sort(state.links.begin(), state.links.end());
+
+    json files = json::array();
+    for (const auto& f : state.files) {
+        files.push_back({ {"path", f.path}, {"size", f.size}, {"sha256", f.hash},
+                          {"exec", f.exec}, {"chunks", f.chunks} });
+    }
+    json links = json::array();
+    for (const auto& [path, target] : state.links) {
+        links.push_back({ {"path", path}, {"target", target} });
+    }
+    json doc = { {"version", PathToUtf8(fs::path(version))}, {"files", std::move(files)},
+                 {"dirs", state.dirs}, {"links", std::move(links)} };
+
+    fs::path tmp = fs::path(config_.root) / L"tmp" / ("manifest-" + BuildCache::TempSuffix());
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << doc.dump(1);
+        if (!out.good()) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, ManifestPath(version), ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    lastImport_ = state.stats;
+    return true;
+}
+
+bool SdkStore::Import(const std::wstring& version, const std::wstring& treeDir, std::stop_token stop) {
+    TRACE_SCOPE("sdk", "Import", version);
+    if (!ValidVersion(version)) return false;
+    std::error_code ec;
+    fs::path tree = fs::weakly_canonical(treeDir, ec);
+    if (ec || !fs::is_directory(tree, ec)) return false;
+
+    ImportState state;
+    std::vector<std::wstring> files;
+    for (auto it = fs::recursive_directory_iterator(tree, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        std::error_code ec2;
+        fs::path rel = it->path().lexically_relative(tree);
+        if (it->is_symlink(ec2)) {
+            // Симлинк сохраняем как есть, если он остаётся внутри дерева
+            fs::path target = fs::read_symlink(it->path(), ec2);
+            if (ec2 || target.is_absolute() ||
+                !SafeRelative((rel.parent_path() / target).lexically_normal()))
+            {
+                return false;
+            }
+            state.links.emplace_back(PathToUtf8(rel), PathToUtf8(target));
+        } else if (it->is_directory(ec2)) {
+            state.dirs.push_back(PathToUtf8(rel));
+        } else if (it->is_regular_file(ec2)) {
+            files.push_back(it->path().wstring());
+        }
+    }
+    if (ec) return false;
+
+    const std::wstring treeW = tree.wstring();
+    bool ok = ParallelFor(files.size(), config_.threads, [&](size_t i) {
+        return !stop.stop_requested() && AddFile(state, treeW, files[i], stop);
+    });
+    if (!ok || stop.stop_requested()) return false;
+    return CommitManifest(version, state);
+}
+
+bool SdkStore::ImportZip(const std::wstring& version, const std::wstring& zipPath, std::stop_token stop) {
+    TRACE_SCOPE("sdk", "ImportZip", version);
+    if (!ValidVersion(version)) return false;
+
+    // Распаковка во временный каталог хранилища; каждый файл режется на чанки
+    // в потоке распаковки сразу после записи, не дожидаясь конца архива
+    fs::path tmp = fs::path(config_.root) / L"tmp" / ("import-" + BuildCache::TempSuffix());
+    std::error_code ec;
+    fs::create_directories(tmp, ec);
+    if (ec) return false;
+    fs::path tmpCan = fs::weakly_canonical(tmp, ec);
+    const std::wstring tmpW = tmpCan.wstring();
+
+    ImportState state;
+    std::atomic<bool> addFailed(false);
+    bool ok = Unzip(zipPath, tmpW, config_.threads, [&](const std::wstring& path) {
+        std::error_code ec2;
+        std::wstring full = fs::weakly_canonical(path, ec2).wstring();
+        if (ec2 || !AddFile(state, tmpW, full, stop)) {
+            addFailed.store(true, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }, stop);
+
+    if (ok && !addFailed.load(std::memory_order_acquire)) {
+        for (auto it = fs::recursive_directory_iterator(tmpCan, ec);
+             !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+        {
+            std::error_code ec2;
+            if (it->is_directory(ec2)) {
+                state.dirs.push_back(PathToUtf8(it->path().lexically_relative(tmpCan)));
+            }
+        }
+        ok = !ec;
+    } else {
+        ok = false;
+    }
+    std::error_code ec2;
+    fs::remove_all(tmp, ec2);
+    if (!ok || stop.stop_requested()) return false;
+    return CommitManifest(version, state);
+}
+
+bool SdkStore::BuildBlob(const std::string& fileHash, uint64_t size, bool exec,
+                         const std::vector<std::string>& chunks, std::wstring& outPath)
+{
+    outPath = BlobPath(fileHash, exec);
+    const fs::path stampPath = StampPath(fileHash, exec);
+    const fs::path stampTmp = fs::path(config_.root) / L"tmp" / ("stamp-" + fileHash + "-" + BuildCache::TempSuffix());
+    std::error_code ec;
+    BlobStamp current;
+    if (StatBlob(outPath, current)) {
+        // Дерево версии — жёсткие ссылки на blob: запись в файл дерева портит и blob.
+        // Штамп снят при публикации; пока он совпадает, blob не менялся и хеш не нужен.
+        // Иначе (запись, подмена, хранилище без штампов) blob сверяется по sha256,
+        // а испорченный собирается заново из чанков (старые деревья сохраняют свою копию)
+        BlobStamp saved;
+        if (current.size == size && ReadStamp(stampPath, saved) && saved == current) {
+            return true;
+        }
+        std::string actual;
+        if (current.size == size && Sha256::HashFile(outPath, actual) && actual == fileHash) {
+            WriteStamp(stampPath, stampTmp, current);
+            return true;
+        }
+        std::error_code ec2;
+        fs::permissions(outPath, fs::perms::owner_write, fs::perm_options::add, ec2);
+        fs::remove(outPath, ec2);
+    }
+
+    fs::path tmp = fs::path(config_.root) / L"tmp" / ("blob-" + fileHash + "-" + BuildCache::TempSuffix());
+    Sha256 h;
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        std::vector<char> buf;
+        for (const auto& c : chunks) {
+            std::ifstream in(fs::path(ChunkPath(c)), std::ios::binary | std::ios::ate);
+            if (!in) break;
+            buf.resize((size_t)in.tellg());
+            in.seekg(0);
+            in.read(buf.data(), (std::streamsize)buf.size());
+            if (!in) break;
+            h.Update(buf.data(), buf.size());
+            out.write(buf.data(), (std::streamsize)buf.size());
+        }
+        out.close();
+        if (!out.good()) {
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+    // Недостающий или повреждённый чанк даёт другой хеш — такой blob не публикуем
+    if (h.FinalHex() != fileHash) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    // Только чтение: деревья версий — жёсткие ссылки на blob
+    fs::perms perms = fs::perms::owner_read | fs::perms::group_read | fs::perms::others_read;
+    if (exec) {
+        perms |= fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec;
+    }
+    fs::permissions(tmp, perms, fs::perm_options::replace, ec);
+    fs::create_directories(fs::path(outPath).parent_path(), ec);
+    fs::rename(tmp, outPath, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return fs::exists(outPath);
+    }
+    if (StatBlob(outPath, current)) WriteStamp(stampPath, stampTmp, current);
+    return true;
+}
+
+bool SdkStore::Materialize(const std::wstring& version, const std::wstring& outDir, std::stop_token stop) {
+    TRACE_SCOPE("sdk", "Materialize", version);
+    if (!ValidVersion(version)) return false;
+    json doc;
+    if (!ReadManifest(ManifestPath(version), doc)) return false;
+
+    fs::path out = fs::path(outDir).lexically_normal();
+    if (out.filename().empty()) out = out.parent_path();
+    fs::path staging = out;
+    staging += L".sdk-new";
+    std::error_code ec;
+    fs::remove_all(staging, ec);
+    fs::create_directories(staging, ec);
+    if (ec) return false;
+
+    bool ok = true;
+    try {
+        for (const auto& d : doc.value("dirs", json::array())) {
+            fs::path rel = Utf8ToPath(d.get<std::string>());
+            if (!SafeRelative(rel)) {
+                ok = false;
+                break;
+            }
+            fs::create_directories(staging / rel, ec);
+        }
+        const json& files = doc["files"];
+        ok = ok && ParallelFor(files.size(), config_.threads, [&](size_t i) {
+            if (stop.stop_requested()) return false;
+            const json& f = files[i];
+            fs::path rel = Utf8ToPath(f.at("path").get<std::string>());
+            if (!SafeRelative(rel)) return false;
+            std::wstring blob;
+            return BuildBlob(f.at("sha256").get<std::string>(), f.at("size").get<uint64_t>(),
+                             f.value("exec", false),
+                             f.at("chunks").get<std::vector<std::string>>(), blob) &&
+                   BuildCache::Materialize(blob, (staging / rel).wstring());
+        });
+        for (const auto& l : doc.value("links", json::array())) {
+            if (!ok) break;
+            fs::path rel = Utf8ToPath(l.at("path").get<std::string>());
+            if (!SafeRelative(rel)) {
+                ok = false;
+                break;
+            }
+            std::error_code ec2;
+            fs::create_directories((staging / rel).parent_path(), ec2);
+            fs::create_symlink(Utf8ToPath(l.at("target").get<std::string>()), staging / rel, ec2);
+            ok = !ec2;
+        }
+    } catch (...) {
+        ok = false;
+    }
+    if (!ok || stop.stop_requested()) {
+        fs::remove_all(staging, ec);
+        return false;
+    }
+
+    // Подмена целиком: старое дерево отодвигается, новое встаёт на его место
+    fs::path old = out;
+    old += L".sdk-old";
+    fs::remove_all(old, ec);
+    bool hadOld = fs::exists(out, ec);
+    if (hadOld) {
+        fs::rename(out, old, ec);
+        if (ec) {
+            fs::remove_all(staging, ec);
+            return false;
+        }
+    }
+    fs::rename(staging, out, ec);
+    if (ec) {
+        std::error_code ec2;
+        if (hadOld) fs::rename(old, out, ec2);
+        fs::remove_all(staging, ec2);
+        return false;
+    }
+    if (hadOld) fs::remove_all(old, ec);
+    return true;
+}
+
+bool SdkStore::Has(const std::wstring& version) const {
+    std::error_code ec;
+    return ValidVersion(version) && fs::exists(ManifestPath(version), ec);
+}
+
+std::vector<std::wstring> SdkStore::Versions() const {
+    std::vector<std::wstring> out;
+    std::error_code ec;
+    for (auto& e : fs::directory_iterator(fs::path(config_.root) / L"manifests", ec)) {
+        if (e.path().extension() == L".json") {
+            out.push_back(e.path().stem().wstring());
+        }
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+bool SdkStore::Remove(const std::wstring& version) {
+    if (!ValidVersion(version)) return false;
+    std::error_code ec;
+    return fs::remove(ManifestPath(version), ec) && !ec;
+}
+
+uint64_t SdkStore::CollectGarbage() {
+    TRACE_SCOPE("sdk", "CollectGarbage", config_.root);
+    fs::path root(config_.root);
+    std::error_code ec;
+
+    // Пометка: чанки всех манифестов. Нечитаемый манифест — не собираем ничего,
+    // иначе удалили бы содержимое версии из-за одной испорченной записи.
+    std::unordered_set<std::string> live;
+    for (auto& e : fs::directory_iterator(root / L"manifests", ec)) {
+        if (e.path().extension() != L".json") continue;
+        json doc;
+        if (!ReadManifest(e.path(), doc)) return 0;
+        try {
+            for (const auto& f : doc["files"]) {
+                for (const auto& c : f.at("chunks")) {
+                    live.insert(c.get<std::string>());
+                }
+            }
+        } catch (...) {
+            return 0;
+        }
+    }
+    if (ec) return 0;
+
+    uint64_t freed = 0;
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto it = fs::recursive_directory_iterator(root / L"chunks", ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        std::error_code ec2;
+        if (!it->is_regular_file(ec2)) continue;
+        std::string hash = it->path().filename().string();
+        if (live.count(hash)) continue;
+        uint64_t size = it->file_size(ec2);
+        if (fs::remove(it->path(), ec2)) {
+            freed += size;
+            chunkBytes_ -= std::min(chunkBytes_, size);
+            chunks_.erase(hash);
+        }
+    }
+
+    // Blob без других жёстких ссылок не нужен ни одному дереву: его всегда можно
+    // собрать заново из чанков. Reflink-деревья на blob не ссылаются вовсе.
+    std::error_code ecBlobs;
+    for (auto it = fs::recursive_directory_iterator(root / L"blobs", ecBlobs);
+         !ecBlobs && it != fs::recursive_directory_iterator(); it.increment(ecBlobs))
+    {
+        std::error_code ec2;
+        if (!it->is_regular_file(ec2)) continue;
+        if (fs::hard_link_count(it->path(), ec2) > 1 || ec2) continue;
+        uint64_t size = it->file_size(ec2);
+        fs::permissions(it->path(), fs::perms::owner_write, fs::perm_options::add, ec2);
+        if (fs::remove(it->path(), ec2)) freed += size;
+    }
+
+    // Штамп без blob больше ничего не подтверждает
+    std::error_code ecStamps;
+    for (auto it = fs::recursive_directory_iterator(root / L"stamps", ecStamps);
+         !ecStamps && it != fs::recursive_directory_iterator(); it.increment(ecStamps))
+    {
+        std::error_code ec2;
+        if (!it->is_regular_file(ec2)) continue;
+        fs::path blob = root / L"blobs" / it->path().lexically_relative(root / L"stamps");
+        if (!fs::exists(blob, ec2) && !ec2) fs::remove(it->path(), ec2);
+    }
+    return freed;
+}
+
+SdkImportStats SdkStore::LastImport() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return lastImport_;
+}
+
+SdkStoreStats SdkStore::Stats() const {
+    SdkStoreStats s;
+    s.versions = Versions().size();
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(fs::path(config_.root) / L"blobs", ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        std::error_code ec2;
+        if (!it->is_regular_file(ec2)) continue;
+        ++s.blobs;
+        s.blobBytes += it->file_size(ec2);
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    s.chunks = chunks_.size();
+    s.chunkBytes = chunkBytes_;
+    return s;
+}
@@ -0,0 +1,189 @@
+// src/trace.cpp
+#include "trace.h"
+#include "utf8.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
+
+using namespace std::chrono;
+namespace fs = std::filesystem;
+
+std::atomic<bool> Tracer::enabled_{false};
+
+namespace {
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    uint64_t startUs;
+    uint64_t durUs;
+    std::string detail;
+};
+
+// Буфер одного потока. Мьютекс берёт только сам поток и Write, так что он почти всегда свободен.
+struct ThreadBuffer {
+    std::mutex mtx;
+    std::vector<TraceEvent> events;
+    std::string threadName;
+    uint32_t tid = 0;
+    uint64_t dropped = 0;
+};
+
+// Ограничение на поток, чтобы забытая трассировка не съела память
+constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+std::mutex& RegistryMutex() {
+    static std::mutex m;
+    return m;
+}
+
+std::vector<std::shared_ptr<ThreadBuffer>>& Registry() {
+    static std::vector<std::shared_ptr<ThreadBuffer>> r;
+    return r;
+}
+
+ThreadBuffer& LocalBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buf = []() {
+        auto b = std::make_shared<ThreadBuffer>();
+        b->events.reserve(1024);
+        std::lock_guard<std::mutex> lock(RegistryMutex());
+        b->tid = (uint32_t)Registry().size() + 1;
+        Registry().push_back(b);
+        return b;
+    }();
+    return *buf;
+}
+
+void AppendJsonString(std::string& out, const char* s) {
+    out.push_back('"');
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out.push_back((char)c);
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+} // namespace
+
+void Tracer::Enable() {
+    NowUs();   // фиксируем нулевую точку трассы
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::Disable() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+uint64_t Tracer::NowUs() {
+    static const steady_clock::time_point base = steady_clock::now();
+    // +1: ноль в TraceSpan означает «трассировка была выключена»
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now() - base).count() + 1;
+}
+
+void Tracer::Record(const char* category, const char* name,
+                    uint64_t startUs, uint64_t durUs, std::string detail)
+{
+    ThreadBuffer& b = LocalBuffer();
+    std::lock_guard<std::mutex> lock(b.mtx);
+    if (b.events.size() >= MAX_EVENTS_PER_THREAD) {
+        ++b.dropped;
+        return;
+    }
+    b.events.push_back({ category, name, startUs, durUs, std::move(detail) });
+}
+
+void Tracer::SetThreadName(const char* name) {
+    ThreadBuffer& b = LocalBuffer();
+    std::lock_guard<std::mutex> lock(b.mtx);
+    b.threadName = name;
+}
+
+TraceSpan::TraceSpan(const char* category, const char* name, const std::wstring& detail)
+    : category_(category), name_(name), start_(0)
+{
+    if (Tracer::Enabled()) {
+        detail_ = WStringToUtf8(detail);
+        start_  = Tracer::NowUs();
+    }
+}
+
+bool Tracer::Write(const std::wstring& path) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(RegistryMutex());
+        buffers = Registry();
+    }
+
+    std::ofstream ofs(fs::path(path), std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) return false;
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto sep = [&]() {
+        if (!first) out += ",\n";
+        first = false;
+    };
+    uint64_t dropped = 0;
+
+    for (auto& b : buffers) {
+        // Забираем события и сразу отпускаем поток, форматируем уже без блокировки
+        std::vector<TraceEvent> events;
+        std::string threadName;
+        {
+            std::lock_guard<std::mutex> lock(b->mtx);
+            events.swap(b->events);
+            threadName = b->threadName;
+            dropped += b->dropped;
+            b->dropped = 0;
+        }
+        const std::string tid = std::to_string(b->tid);
+        if (!threadName.empty()) {
+            sep();
+            out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid +
+                   ",\"args\":{\"name\":";
+            AppendJsonString(out, threadName.c_str());
+            out += "}}";
+        }
+        for (const auto& e : events) {
+            sep();
+            out += "{\"name\":";
+            AppendJsonString(out, e.name);
+            out += ",\"cat\":";
+            AppendJsonString(out, e.category);
+            out += ",\"ph\":\"X\",\"ts\":" + std::to_string(e.startUs) +
+                   ",\"dur\":" + std::to_string(e.durUs) +
+                   ",\"pid\":1,\"tid\":" + tid;
+            if (!e.detail.empty()) {
+                out += ",\"args\":{\"detail\":";
+                AppendJsonString(out, e.detail.c_str());
+                out += "}";
+            }
+            out += "}";
+        }
+        if (out.size() > (1u << 20)) {
+            ofs.write(out.data(), (std::streamsize)out.size());
+            out.clear();
+        }
+    }
+    out += "\n],\"otherData\":{\"droppedEvents\":" + std::to_string(dropped) + "}}\n";
+    ofs.write(out.data(), (std::streamsize)out.size());
+    return ofs.good();
+}
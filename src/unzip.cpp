@@ -1,43 +1,22 @@
 // src/unzip.cpp
 #include "unzip.h"
+#include "trace.h"
+#include "arena.h"
+#include "resource_governor.h"
+#include "metrics.h"
+#include "utf8.h"
 #include <filesystem>
 #include <vector>
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <zip.h>
-#include <windows.h>
 
 namespace fs = std::filesystem;
 
-// UTF-8 → UTF-16 (MB_ERR_INVALID_CHARS)
-static bool Utf8ToWStringSafe(const std::string& utf8, std::wstring& out) {
-    if (utf8.empty()) {
-        out.clear();
-        return true;
-    }
-    int needed = MultiByteToWideChar(
-        CP_UTF8, MB_ERR_INVALID_CHARS,
-        utf8.data(), (int)utf8.size(),
-        nullptr, 0
-    );
-    if (needed <= 0) {
-        out.clear();
-        return false;
-    }
-    out.resize(needed);
-    int ret = MultiByteToWideChar(
-        CP_UTF8, MB_ERR_INVALID_CHARS,
-        utf8.data(), (int)utf8.size(),
-        &out[0], needed
-    );
-    if (ret <= 0) {
-        out.clear();
-        return false;
-    }
-    return true;
-}
-
 // Проверка, что child лежит внутри base (canonical), учитывая любую регистронезависимость на Windows
 static bool IsSubPath(const fs::path& base, const fs::path& child) {
     std::error_code ec;
@@ -63,8 +42,11 @@ static bool IsSubPath(const fs::path& base, const fs::path& child) {
 
 bool Unzip(const std::wstring& zipPath,
            const std::wstring& outDir,
-           int maxThreads)
+           int maxThreads,
+           UnzipFileCallback onFile,
+           std::stop_token stop)
 {
+    TRACE_SCOPE("unzip", "Unzip", zipPath);
     std::error_code ec;
     fs::path z = fs::weakly_canonical(zipPath, ec);
     if (ec || !fs::exists(z)) {
@@ -76,7 +58,8 @@ bool Unzip(const std::wstring& zipPath,
     if (ec) return false;
 
     int err = 0;
-    zip_t* za = zip_open(std::string(z.u8string()).c_str(), ZIP_RDONLY, &err);
+    const std::u8string zU8 = z.u8string();
+    zip_t* za = zip_open(reinterpret_cast<const char*>(zU8.c_str()), ZIP_RDONLY, &err);
     if (!za) {
         return false;
     }
@@ -110,10 +93,47 @@ bool Unzip(const std::wstring& zipPath,
     std::atomic<int> idx(0);
     std::atomic<bool> anyExtracted(false);
     std::atomic<bool> sawSymlink(false);
+    std::atomic<bool> stopped(false);
     std::mutex dirMutex;
 
+    const std::wstring outDirW = fs::path(outDir).wstring();
+
+    // Резервация на одну запись: состояние inflate + буферы libzip и файла,
+    // полоса — грубая оценка одного потока записи. Сколько потоков реально пишут
+    // одновременно, решает общий ResourceGovernor, а не maxThreads.
+    // Если Unzip вызван работой, которая уже держит резервацию (узел планировщика),
+    // записи берутся из неё: иначе узел ждал бы в Acquire ресурсов, которые держит сам.
+    ResourceGovernor& governor = ResourceGovernor::Shared();
+    const ResourceRequest entryRequest{ 256 * 1024, 32ull << 20 };
+    std::shared_ptr<LeaseNest> parentNest = ResourceLease::CurrentNest();
+
+    static MetricCounter& entriesTotal = Metrics::Counter(
+        "x360_unzip_entries_total", "Files extracted from archives");
+    static MetricCounter& bytesTotal = Metrics::Counter(
+        "x360_unzip_bytes_total", "Bytes written by archive extraction");
+    static MetricHistogram& entrySeconds = Metrics::Histogram(
+        "x360_unzip_entry_seconds", "Time to extract one file, after admission", 1e-6);
+
     auto worker = [&]() {
-        while (true) {
+        if (Tracer::Enabled()) Tracer::SetThreadName("unzip worker");
+        AllocScope allocScope(AllocSite::Unzip);
+        ResourceLease::Scope leaseScope(parentNest);
+
+        // Всё, что раньше создавалось на каждую запись, живёт на весь поток:
+        // буфер чтения из общего пула, имена — в арене (сброс на каждой записи),
+        // путь и поток файла переиспользуются, каталог проверяется только при смене.
+        PooledBuffer buffer = BufferPool::Shared64K().Acquire();
+        BumpArena arena(4 * 1024);
+        fs::path destPath;
+        std::wstring lastParent;
+        bool lastParentOk = false;
+        std::ofstream ofs;
+
+        while (!stopped.load(std::memory_order_acquire)) {
+            if (stop.stop_requested()) {
+                stopped.store(true, std::memory_order_release);
+                break;
+            }
             int i = idx.fetch_add(1);
             if (i >= (int)entries.size()) break;
             auto& ent = entries[i];
@@ -123,6 +143,15 @@ bool Unzip(const std::wstring& zipPath,
                 continue;
             }
 
+            ResourceLease lease = governor.Acquire(entryRequest, stop, [&]() {
+                return stopped.load(std::memory_order_acquire);
+            });
+            if (!lease) {
+                stopped.store(true, std::memory_order_release);
+                break;
+            }
+
+            auto entryStart = std::chrono::steady_clock::now();
             zip_file_t* zf = zip_fopen_index(za, ent.idx, 0);
             if (!zf) continue;
 
@@ -132,50 +161,89 @@ bool Unzip(const std::wstring& zipPath,
                 zip_fclose(zf);
                 continue;
             }
-            std::string nameUtf8(st.name);
-            std::wstring nameW;
-            if (!Utf8ToWStringSafe(nameUtf8, nameW)) {
+            arena.Reset();
+            std::pmr::wstring nameW(&arena);
+            if (!Utf8ToWStringStrict(std::string_view(st.name), nameW)) {
                 zip_fclose(zf);
                 continue;
             }
-            fs::path destPath = fs::path(outDir) / nameW;
-            fs::path parent = destPath.parent_path();
+            TRACE_SCOPE("unzip", "entry", Tracer::Enabled() ? std::wstring(nameW) : std::wstring());
+            std::pmr::wstring fullW(&arena);
+            fullW.reserve(outDirW.size() + 1 + nameW.size());
+            fullW.append(outDirW);
+            fullW.push_back(L'/');
+            fullW.append(nameW);
+            destPath.assign(std::wstring_view(fullW));
 
-            {
-                std::lock_guard<std::mutex> lock(dirMutex);
-                std::error_code ec2;
-                fs::create_directories(parent, ec2);
-                if (ec2) {
-                    zip_fclose(zf);
-                    continue;
+            // Каталог записи: создаём и проверяем на выход за outDir только при смене каталога
+            size_t slash = fullW.find_last_of(L"/\\");
+            std::wstring_view parentW(fullW.data(), slash == std::pmr::wstring::npos ? 0 : slash);
+            if (parentW != lastParent) {
+                lastParent.assign(parentW);
+                fs::path parent = destPath.parent_path();
+                lastParentOk = false;
+                {
+                    std::lock_guard<std::mutex> lock(dirMutex);
+                    std::error_code ec2;
+                    fs::create_directories(parent, ec2);
+                    lastParentOk = !ec2;
                 }
+                lastParentOk = lastParentOk && IsSubPath(outCan, parent);
             }
-            if (!IsSubPath(outCan, parent)) {
+            if (!lastParentOk) {
                 zip_fclose(zf);
                 continue;
             }
 
-            std::ofstream ofs(destPath, std::ios::binary);
+            // Без внутреннего буфера потока: пишем сразу блоками по 64 КБ
+            ofs.rdbuf()->pubsetbuf(nullptr, 0);
+            ofs.open(destPath, std::ios::binary | std::ios::trunc);
             if (!ofs.is_open()) {
+                ofs.clear();
                 zip_fclose(zf);
                 continue;
             }
-            const size_t BUF_SIZE = 64 * 1024;
-            std::vector<char> buffer(BUF_SIZE);
             zip_int64_t bytesRead = 0;
-            while ((bytesRead = zip_fread(zf, buffer.data(), BUF_SIZE)) > 0) {
-                ofs.write(buffer.data(), (std::streamsize)bytesRead);
+            uint64_t entryBytes = 0;
+            bool cancelled = false;
+            while ((bytesRead = zip_fread(zf, buffer.Data(), buffer.Size())) > 0) {
+                ofs.write(buffer.Data(), (std::streamsize)bytesRead);
+                entryBytes += (uint64_t)bytesRead;
                 if (!ofs.good()) {
                     break;
                 }
+                if (stop.stop_requested()) {
+                    cancelled = true;
+                    break;
+                }
             }
+            bool written = ofs.good();
             ofs.close();
+            ofs.clear();
             zip_fclose(zf);
+            if (cancelled) {
+                // Обрубок файла не оставляем: следующая сборка не должна принять его за готовый
+                std::error_code ec2;
+                fs::remove(destPath, ec2);
+                stopped.store(true, std::memory_order_release);
+                break;
+            }
+            lease.Release();
+            entriesTotal.Add();
+            bytesTotal.Add(entryBytes);
+            entrySeconds.Record((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - entryStart).count());
             anyExtracted.store(true, std::memory_order_release);
+            allocScope.Unit();
+
+            // Отдаём файл следующей стадии, не дожидаясь конца архива
+            if (onFile && written && !onFile(destPath.wstring())) {
+                stopped.store(true, std::memory_order_release);
+            }
         }
     };
 
-    int threadsCount = (maxThreads > 0 ? maxThreads : 4);
+    int threadsCount = maxThreads > 0 ? maxThreads : (int)std::max(1u, std::thread::hardware_concurrency());
     threadsCount = std::min(threadsCount, (int)entries.size());
     std::vector<std::thread> threads;
     threads.reserve(threadsCount);
@@ -187,6 +255,9 @@ bool Unzip(const std::wstring& zipPath,
     }
 
     zip_close(za);
+    if (stopped.load(std::memory_order_acquire)) {
+        return false;
+    }
     if (sawSymlink.load(std::memory_order_acquire)) {
         return false;
     }
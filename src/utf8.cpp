@@ -0,0 +1,118 @@
+// src/utf8.cpp
+#include "utf8.h"
+#include <cstdint>
+
+std::string WStringToUtf8(const std::wstring& in) {
+    std::string out;
+    WStringToUtf8(in, out);
+    return out;
+}
+
+void WStringToUtf8(std::wstring_view in, std::string& out) {
+    out.clear();
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+        uint32_t c = (uint32_t)in[i];
+        if (sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDBFF && i + 1 < in.size()) {
+            uint32_t lo = (uint32_t)in[i + 1];
+            if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                ++i;
+            }
+        }
+        if (c >= 0xD800 && c <= 0xDFFF) c = 0xFFFD;   // одиночный суррогат
+        if (c < 0x80) {
+            out.push_back((char)c);
+        } else if (c < 0x800) {
+            out.push_back((char)(0xC0 | (c >> 6)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.push_back((char)(0xE0 | (c >> 12)));
+            out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back((char)(0xF0 | (c >> 18)));
+            out.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        }
+    }
+}
+
+std::wstring Utf8ToWString(const std::string& in) {
+    std::wstring out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size();) {
+        unsigned char b = (unsigned char)in[i];
+        uint32_t c = 0;
+        size_t n = 0;
+        if (b < 0x80)              { c = b;        n = 1; }
+        else if ((b >> 5) == 0x6)  { c = b & 0x1F; n = 2; }
+        else if ((b >> 4) == 0xE)  { c = b & 0x0F; n = 3; }
+        else if ((b >> 3) == 0x1E) { c = b & 0x07; n = 4; }
+        else                       { ++i; continue; }
+        if (i + n > in.size()) break;
+        for (size_t k = 1; k < n; ++k) {
+            c = (c << 6) | ((unsigned char)in[i + k] & 0x3F);
+        }
+        if (sizeof(wchar_t) == 2 && c >= 0x10000) {
+            c -= 0x10000;
+            out.push_back((wchar_t)(0xD800 + (c >> 10)));
+            out.push_back((wchar_t)(0xDC00 + (c & 0x3FF)));
+        } else {
+            out.push_back((wchar_t)c);
+        }
+        i += n;
+    }
+    return out;
+}
+
+template <typename WString>
+static bool DecodeStrict(std::string_view in, WString& out) {
+    out.clear();
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size();) {
+        unsigned char b = (unsigned char)in[i];
+        uint32_t c = 0;
+        size_t n = 0;
+        uint32_t min = 0;
+        if (b < 0x80)              { c = b;        n = 1; }
+        else if ((b >> 5) == 0x6)  { c = b & 0x1F; n = 2; min = 0x80; }
+        else if ((b >> 4) == 0xE)  { c = b & 0x0F; n = 3; min = 0x800; }
+        else if ((b >> 3) == 0x1E) { c = b & 0x07; n = 4; min = 0x10000; }
+        else                       { out.clear(); return false; }
+        if (i + n > in.size()) {
+            out.clear();
+            return false;
+        }
+        for (size_t k = 1; k < n; ++k) {
+            unsigned char cont = (unsigned char)in[i + k];
+            if ((cont & 0xC0) != 0x80) {
+                out.clear();
+                return false;
+            }
+            c = (c << 6) | (cont & 0x3F);
+        }
+        if (c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+            out.clear();
+            return false;
+        }
+        if (sizeof(wchar_t) == 2 && c >= 0x10000) {
+            c -= 0x10000;
+            out.push_back((wchar_t)(0xD800 + (c >> 10)));
+            out.push_back((wchar_t)(0xDC00 + (c & 0x3FF)));
+        } else {
+            out.push_back((wchar_t)c);
+        }
+        i += n;
+    }
+    return true;
+}
+
+bool Utf8ToWStringStrict(std::string_view in, std::wstring& out) {
+    return DecodeStrict(in, out);
+}
+
+bool Utf8ToWStringStrict(std::string_view in, std::pmr::wstring& out) {
+    return DecodeStrict(in, out);
+}
@@ -0,0 +1,257 @@
+// tests/build_cache_test.cpp
+// Кеш сборки: стабильность ключа, попадание с восстановлением выходов,
+// двухуровневый поиск через манифест depfile и LRU-вытеснение.
+//
+// Сборка:
+//   g++ -std=c++20 -O2 -pthread -iquote include -o build_cache_test tests/build_cache_test.cpp
+//       src/build_cache.cpp src/sha256.cpp src/metrics.cpp src/utf8.cpp
+// Код возврата 0 — все проверки прошли.
+#include "build_cache.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+namespace fs = std::filesystem;
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+static fs::path g_dir;
+
+static void WriteFile(const fs::path& p, const std::string& text) {
+    fs::create_directories(p.parent_path());
+    std::ofstream(p, std::ios::binary | std::ios::trunc) << text;
+}
+
+static std::string ReadFile(const fs::path& p) {
+    std::ifstream in(p, std::ios::binary);
+    std::stringstream s;
+    s << in.rdbuf();
+    return s.str();
+}
+
+// «Компилятор»: объект — склейка исходника и заголовков, depfile — список заголовков
+static void FakeCompile(const fs::path& src, const std::vector<fs::path>& headers,
+                        const fs::path& obj, const fs::path& dep)
+{
+    std::string text = ReadFile(src);
+    std::string rule = obj.string() + ": " + src.string();
+    for (const auto& h : headers) {
+        text += ReadFile(h);
+        rule += " \\\n " + h.string();
+    }
+    BuildCache::RemoveOutputs({ obj.wstring(), dep.wstring() });
+    WriteFile(obj, text);
+    WriteFile(dep, rule + "\n");
+}
+
+static ActionDesc Action(const fs::path& src, const fs::path& obj, const fs::path& dep) {
+    ActionDesc a;
+    a.tool = (g_dir / "cc").wstring();
+    a.args = { L"-O2", L"-MD" };
+    a.inputs = { src.wstring() };
+    a.outputs = { obj.wstring() };
+    if (!dep.empty()) {
+        a.outputs.push_back(dep.wstring());   // depfile — тоже выход: восстанавливается вместе с объектом
+        a.depFile = dep.wstring();
+    }
+    return a;
+}
+
+static void TestKeyStability() {
+    BuildCacheConfig cfg;
+    cfg.root = (g_dir / "cache-key").wstring();
+    BuildCache cache(cfg);
+    CHECK(cache.Open());
+    fs::path src = g_dir / "key" / "a.c";
+    WriteFile(src, "int a;\n");
+    ActionDesc a = Action(src, g_dir / "key" / "a.o", {});
+
+    std::string k1, k2, k3;
+    CHECK(cache.ComputeKey(a, k1));
+    CHECK(cache.ComputeKey(a, k2));
+    CHECK(k1 == k2 && k1.size() == 64);
+
+    // Другой экземпляр (новый процесс) даёт тот же ключ
+    BuildCache other(cfg);
+    CHECK(other.ComputeKey(a, k3) && k3 == k1);
+
+    // Перезапись тем же содержимым ключ не меняет, другое содержимое — меняет
+    WriteFile(src, "int a;\n");
+    CHECK(cache.ComputeKey(a, k2) && k2 == k1);
+    WriteFile(src, "int b;\n");
+    CHECK(cache.ComputeKey(a, k2) && k2 != k1);
+
+    ActionDesc flags = a;
+    flags.args = { L"-O0", L"-MD" };
+    CHECK(cache.ComputeKey(flags, k3) && k3 != k2);
+
+    ActionDesc renamed = a;
+    renamed.outputs = { (g_dir / "key" / "b.o").wstring() };
+    CHECK(cache.ComputeKey(renamed, k3) && k3 != k2);
+
+    ActionDesc missing = a;
+    missing.inputs = { (g_dir / "key" / "nope.c").wstring() };
+    CHECK(!cache.ComputeKey(missing, k3));
+}
+
+static void TestRestore() {
+    BuildCacheConfig cfg;
+    cfg.root = (g_dir / "cache-restore").wstring();
+    BuildCache cache(cfg);
+    CHECK(cache.Open());
+    fs::path src = g_dir / "restore" / "a.c";
+    fs::path obj = g_dir / "restore" / "a.o";
+    WriteFile(src, "int a;\n");
+    ActionDesc a = Action(src, obj, {});
+
+    std::string key;
+    CHECK(cache.ComputeKey(a, key));
+    CHECK(!cache.Restore(key, a.outputs));
+    WriteFile(obj, "object-a");
+    CHECK(cache.Store(a, a.outputs));
+
+    fs::remove(obj);
+    CHECK(cache.Restore(key, a.outputs));
+    CHECK(ReadFile(obj) == "object-a");
+
+    // Запись переживает перезапуск: новый экземпляр находит её через Open
+    BuildCache reopened(cfg);
+    CHECK(reopened.Open());
+    BuildCache::RemoveOutputs(a.outputs);
+    CHECK(reopened.Restore(key, a.outputs));
+    CHECK(ReadFile(obj) == "object-a");
+
+    BuildCacheStats st = cache.Stats();
+    CHECK(st.hits == 1 && st.misses == 1 && st.stores == 1);
+}
+
+// Чистый checkout: depfile ещё нет, но манифест от прошлой сборки даёт попадание
+static void TestDepfileManifest() {
+    BuildCacheConfig cfg;
+    cfg.root = (g_dir / "cache-dep").wstring();
+    BuildCache cache(cfg);
+    CHECK(cache.Open());
+
+    fs::path src = g_dir / "dep" / "a.c";
+    fs::path hdr = g_dir / "dep" / "a.h";
+    fs::path hdr2 = g_dir / "dep" / "b.h";
+    fs::path obj = g_dir / "dep" / "a.o";
+    fs::path dep = g_dir / "dep" / "a.d";
+    WriteFile(src, "#include \"a.h\"\n");
+    WriteFile(hdr, "int a;\n");
+    WriteFile(hdr2, "int b;\n");
+    ActionDesc a = Action(src, obj, dep);
+
+    // Первая сборка: depfile нет, ключ всё равно считается, Restore промахивается
+    std::string key, stored;
+    CHECK(!fs::exists(dep));
+    CHECK(cache.ComputeKey(a, key));
+    CHECK(!cache.Restore(key, a.outputs));
+    FakeCompile(src, { hdr }, obj, dep);
+    CHECK(cache.Store(a, a.outputs, &stored));
+    CHECK(stored != key);
+
+    // Чистый checkout той же версии
+    BuildCache::RemoveOutputs(a.outputs);
+    CHECK(cache.ComputeKey(a, key) && key == stored);
+    CHECK(cache.Restore(key, a.outputs));
+    CHECK(ReadFile(obj) == "#include \"a.h\"\nint a;\n");
+
+    // Правка заголовка: промах, а не старый объект
+    WriteFile(hdr, "int a2;\n");
+    BuildCache::RemoveOutputs(a.outputs);
+    CHECK(cache.ComputeKey(a, key));
+    CHECK(!cache.Restore(key, a.outputs));
+    FakeCompile(src, { hdr }, obj, dep);
+    CHECK(cache.Store(a, a.outputs, &stored));
+
+    // Новый #include: ключ прошлого списка не должен подойти к новому набору заголовков
+    WriteFile(src, "#include \"a.h\"\n#include \"b.h\"\n");
+    BuildCache::RemoveOutputs(a.outputs);
+    CHECK(cache.ComputeKey(a, key));
+    CHECK(!cache.Restore(key, a.outputs));
+    FakeCompile(src, { hdr, hdr2 }, obj, dep);
+    std::string withB;
+    CHECK(cache.Store(a, a.outputs, &withB));
+    BuildCache::RemoveOutputs(a.outputs);
+    CHECK(cache.ComputeKey(a, key) && key == withB);
+    CHECK(cache.Restore(key, a.outputs));
+    CHECK(ReadFile(obj) == "#include \"a.h\"\n#include \"b.h\"\nint a2;\nint b;\n");
+
+    // Правка второго заголовка тоже промахивается
+    WriteFile(hdr2, "int b2;\n");
+    CHECK(cache.ComputeKey(a, key) && key != withB);
+    CHECK(!cache.Restore(key, a.outputs));
+}
+
+static void TestTrim() {
+    BuildCacheConfig cfg;
+    cfg.root = (g_dir / "cache-trim").wstring();
+    cfg.maxBytes = 250;
+    BuildCache cache(cfg);
+    CHECK(cache.Open());
+
+    std::vector<std::string> keys;
+    std::vector<std::vector<std::wstring>> outs;
+    for (int i = 0; i < 3; ++i) {
+        fs::path src = g_dir / "trim" / ("s" + std::to_string(i) + ".c");
+        fs::path obj = g_dir / "trim" / ("s" + std::to_string(i) + ".o");
+        WriteFile(src, "int v" + std::to_string(i) + ";\n");
+        WriteFile(obj, std::string(100, (char)('a' + i)));
+        ActionDesc a = Action(src, obj, {});
+        std::string key;
+        CHECK(cache.Store(a, a.outputs, &key));
+        keys.push_back(key);
+        outs.push_back(a.outputs);
+        // Первая запись использована после второй: вытесняться должна вторая
+        if (i == 1) CHECK(cache.Restore(keys[0], outs[0]));
+    }
+    BuildCacheStats st = cache.Stats();
+    CHECK(st.evictions == 1);
+    CHECK(st.bytes == 200);
+    CHECK(cache.Restore(keys[0], outs[0]));
+    CHECK(!cache.Restore(keys[1], outs[1]));
+    CHECK(cache.Restore(keys[2], outs[2]));
+
+    // LRU переживает перезапуск: порядок восстанавливается по mtime записей
+    BuildCache reopened(cfg);
+    CHECK(reopened.Open());
+    CHECK(reopened.Stats().bytes == 200);
+}
+
+int main() {
+    g_dir = fs::temp_directory_path() / ("x360make-cache-test-" + BuildCache::TempSuffix());
+    fs::create_directories(g_dir);
+    WriteFile(g_dir / "cc", "fake compiler v1");
+
+    TestKeyStability();
+    TestRestore();
+    TestDepfileManifest();
+    TestTrim();
+
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(g_dir, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        std::error_code ec2;
+        fs::permissions(it->path(), fs::perms::owner_write, fs::perm_options::add, ec2);
+    }
+    fs::remove_all(g_dir, ec);
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("build_cache_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,143 @@
+// tests/build_daemon_test.cpp
+// Демон сборки на локальном Unix-сокете: первая сборка, повтор без изменений,
+// пересборка после правки, параллельные запросы, присоединяющиеся к одной сборке,
+// провал сборки для всех присоединившихся и права 0600 на сокет.
+//
+// Сборка (только Linux):
+//   g++ -std=c++20 -O2 -pthread -iquote include -o build_daemon_test tests/build_daemon_test.cpp
+//       src/build_daemon.cpp src/utf8.cpp
+// Код возврата 0 — все проверки прошли.
+#include "build_daemon.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+// Подставная сборка: считает запуски, может ждать разрешения и проваливаться
+struct FakeBuild {
+    std::atomic<int> runs{0};
+    std::atomic<bool> fail{false};
+    std::atomic<bool> hold{false};
+
+    bool operator()(const DaemonRequest&, const std::function<void(const std::wstring&)>& log) {
+        ++runs;
+        log(L"building");
+        while (hold) std::this_thread::sleep_for(5ms);
+        return !fail;
+    }
+};
+
+static int Submit(const std::string& sock, const fs::path& src, bool force = false, bool* upToDate = nullptr) {
+    DaemonRequest request;
+    request.input = src.wstring();
+    request.force = force;
+    bool joined = false;
+    int rc = DaemonSubmit(sock, request, [&](const std::wstring& line) {
+        if (line.find(L"up-to-date") != std::wstring::npos) joined = true;
+    });
+    if (upToDate) *upToDate = joined;
+    return rc;
+}
+
+// count запросов одновременно, пока сборка удерживается; затем сборка отпускается
+static std::vector<int> SubmitConcurrently(const std::string& sock, const fs::path& src,
+                                           FakeBuild& fake, int count) {
+    fake.hold = true;
+    std::vector<std::future<int>> futures;
+    futures.push_back(std::async(std::launch::async, [&] { return Submit(sock, src); }));
+    while (fake.runs == 0) std::this_thread::sleep_for(5ms);
+    for (int i = 1; i < count; ++i) {
+        futures.push_back(std::async(std::launch::async, [&] { return Submit(sock, src); }));
+    }
+    std::this_thread::sleep_for(200ms);      // присоединившиеся успевают встать в ожидание
+    fake.hold = false;
+    std::vector<int> rcs;
+    for (auto& f : futures) rcs.push_back(f.get());
+    return rcs;
+}
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / ("build_daemon_test-" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    const fs::path src = dir / "src";
+    fs::create_directories(src / "sub");
+    std::ofstream(src / "main.cpp") << "int main() {}\n";
+    const std::string sock = (dir / "daemon.sock").string();
+
+    FakeBuild fake;
+    BuildDaemonConfig cfg;
+    cfg.socketPath = sock;
+    cfg.build = [&fake](const DaemonRequest& r, const std::function<void(const std::wstring&)>& log) {
+        return fake(r, log);
+    };
+    BuildDaemon daemon(cfg);
+    CHECK(daemon.Start());
+
+    struct stat st{};
+    CHECK(::stat(sock.c_str(), &st) == 0);
+    CHECK((st.st_mode & 0777) == 0600);
+
+    // Первая сборка
+    CHECK(Submit(sock, src) == 0);
+    CHECK(fake.runs == 1);
+
+    // Дерево не менялось — ответ без сборки
+    bool upToDate = false;
+    CHECK(Submit(sock, src, false, &upToDate) == 0);
+    CHECK(upToDate);
+    CHECK(fake.runs == 1);
+
+    // --force собирает всегда
+    CHECK(Submit(sock, src, true) == 0);
+    CHECK(fake.runs == 2);
+
+    // Правка в подкаталоге — пересборка, затем снова up-to-date
+    std::ofstream(src / "sub" / "util.h") << "#pragma once\n";
+    CHECK(Submit(sock, src, false, &upToDate) == 0);
+    CHECK(!upToDate);
+    CHECK(fake.runs == 3);
+    CHECK(Submit(sock, src) == 0);
+    CHECK(fake.runs == 3);
+
+    // Параллельные запросы к изменённому дереву присоединяются к одной сборке
+    std::ofstream(src / "main.cpp") << "int main() { return 0; }\n";
+    for (int rc : SubmitConcurrently(sock, src, fake, 4)) CHECK(rc == 0);
+    CHECK(fake.runs == 4);
+
+    // Провал виден всем присоединившимся, а дерево остаётся грязным
+    std::ofstream(src / "main.cpp") << "int main() { return 1 }\n";
+    fake.fail = true;
+    for (int rc : SubmitConcurrently(sock, src, fake, 3)) CHECK(rc == 1);
+    CHECK(fake.runs == 5);
+    fake.fail = false;
+    CHECK(Submit(sock, src) == 0);
+    CHECK(fake.runs == 6);
+    CHECK(Submit(sock, src) == 0);
+    CHECK(fake.runs == 6);
+
+    daemon.Stop();
+    CHECK(Submit(sock, src) == 2);
+    fs::remove_all(dir);
+
+    if (g_failures == 0) std::printf("build_daemon_test: OK\n");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// tests/cancel_latency_test.cpp
+// Задержка отмены по std::stop_token: от request_stop до возврата из Unzip,
+// BuildScheduler::Run, Pipeline::Run и ResourceGovernor::Acquire.
+//
+// Сборка (Linux, libzip):
+//   g++ -std=c++20 -O2 -pthread -iquote include -o cancel_latency_test tests/cancel_latency_test.cpp
+//       src/unzip.cpp src/build_graph.cpp src/pipeline.cpp src/resource_governor.cpp
+//       src/metrics.cpp src/trace.cpp src/arena.cpp src/utf8.cpp -lzip
+// Код возврата 0 — все проверки прошли.
+#include "unzip.h"
+#include "build_graph.h"
+#include "pipeline.h"
+#include "resource_governor.h"
+#include <zip.h>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <filesystem>
+#include <cstdio>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+using namespace std::chrono;
+
+// Запас на планировщик ОС поверх того, что обещает документация каждой функции
+static const milliseconds MAX_LATENCY(100);
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+// Запускает run(token) в потоке, через delay просит остановку и меряет время до возврата
+template <typename Fn>
+static milliseconds MeasureCancel(Fn run, milliseconds delay, bool& result) {
+    std::stop_source source;
+    std::thread th([&]() { result = run(source.get_token()); });
+    std::this_thread::sleep_for(delay);
+    auto requested = steady_clock::now();
+    source.request_stop();
+    th.join();
+    return duration_cast<milliseconds>(steady_clock::now() - requested);
+}
+
+static void TestUnzip() {
+    fs::path dir = fs::temp_directory_path() / ("x360make-cancel-" + std::to_string(steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(dir);
+    fs::path zipPath = dir / "big.zip";
+    fs::path outDir = dir / "out";
+
+    // 8 × 64 МБ без сжатия: распаковка заведомо дольше задержки перед отменой
+    const size_t FILE_SIZE = 64u << 20;
+    const int FILES = 8;
+    std::vector<uint8_t> data(FILE_SIZE);
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (auto& b : data) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        b = (uint8_t)x;
+    }
+    int err = 0;
+    zip_t* za = zip_open(zipPath.string().c_str(), ZIP_CREATE | ZIP_TRUNCATE, &err);
+    CHECK(za != nullptr);
+    if (!za) return;
+    for (int i = 0; i < FILES; ++i) {
+        zip_source_t* src = zip_source_buffer(za, data.data(), data.size(), 0);
+        zip_int64_t idx = zip_file_add(za, ("f" + std::to_string(i) + ".bin").c_str(), src, ZIP_FL_OVERWRITE);
+        CHECK(idx >= 0);
+        zip_set_file_compression(za, (zip_uint64_t)idx, ZIP_CM_STORE, 0);
+    }
+    CHECK(zip_close(za) == 0);
+
+    bool ok = true;
+    milliseconds latency = MeasureCancel([&](std::stop_token stop) {
+        return Unzip(zipPath.wstring(), outDir.wstring(), 2, nullptr, stop);
+    }, milliseconds(30), ok);
+    std::printf("unzip: cancel latency %lld ms\n", (long long)latency.count());
+    CHECK(!ok);
+    CHECK(latency <= MAX_LATENCY);
+
+    // Недописанные файлы удаляются: всё, что осталось, должно быть целым
+    std::error_code ec;
+    for (auto& e : fs::recursive_directory_iterator(outDir, ec)) {
+        if (e.is_regular_file()) CHECK(e.file_size() == FILE_SIZE);
+    }
+    fs::remove_all(dir, ec);
+}
+
+static void TestScheduler() {
+    BuildGraph graph;
+    for (int i = 0; i < 2000; ++i) {
+        graph.AddNode(BuildStage::Compile, L"n" + std::to_wstring(i), []() {
+            std::this_thread::sleep_for(milliseconds(5));
+            return true;
+        });
+    }
+    CHECK(graph.Finalize());
+    SchedulerConfig cfg;
+    cfg.maxJobs = 4;
+    BuildScheduler scheduler(cfg);
+
+    bool ok = true;
+    milliseconds latency = MeasureCancel([&](std::stop_token stop) {
+        return scheduler.Run(graph, stop);
+    }, milliseconds(20), ok);
+    std::printf("scheduler: cancel latency %lld ms, skipped %zu\n",
+                (long long)latency.count(), scheduler.Stats().skipped);
+    CHECK(!ok);
+    CHECK(latency <= MAX_LATENCY);
+    CHECK(scheduler.Stats().skipped > 0);
+}
+
+static void TestPipeline() {
+    // Источник бесконечный: остановить конвейер может только токен
+    Pipeline pipeline([](const PipelineEmit& emit) {
+        for (uint64_t i = 0;; ++i) {
+            if (!emit(std::to_wstring(i))) return false;
+        }
+    });
+    PipelineStage stage;
+    stage.name = L"slow";
+    stage.workers = 2;
+    stage.queueCapacity = 4;
+    stage.process = [](const std::wstring&, const PipelineEmit&) {
+        std::this_thread::sleep_for(milliseconds(5));
+        return true;
+    };
+    pipeline.AddStage(std::move(stage));
+
+    bool ok = true;
+    milliseconds latency = MeasureCancel([&](std::stop_token stop) {
+        return pipeline.Run(stop);
+    }, milliseconds(20), ok);
+    std::printf("pipeline: cancel latency %lld ms\n", (long long)latency.count());
+    CHECK(!ok);
+    CHECK(latency <= MAX_LATENCY);
+}
+
+static void TestGovernor() {
+    ResourceGovernorConfig cfg;
+    cfg.memoryBudget = 1u << 20;
+    ResourceGovernor governor(cfg);
+    // Весь бюджет занят, следующий Acquire ждёт до отмены
+    ResourceLease held = governor.Acquire({ 1u << 20, 0 });
+    CHECK((bool)held);
+
+    bool got = true;
+    milliseconds latency = MeasureCancel([&](std::stop_token stop) {
+        ResourceLease lease = governor.Acquire({ 1u << 20, 0 }, stop);
+        return (bool)lease;
+    }, milliseconds(20), got);
+    std::printf("governor: cancel latency %lld ms\n", (long long)latency.count());
+    CHECK(!got);
+    CHECK(latency <= MAX_LATENCY);
+}
+
+int main() {
+    TestUnzip();
+    TestScheduler();
+    TestPipeline();
+    TestGovernor();
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all cancel latency checks passed\n");
+    return 0;
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+# tests/crt/run.sh — собирает crt_test под 32-битный big-endian PowerPC и гоняет его в qemu-ppc.
+#
+# Переменные окружения:
+#   CROSS        префикс кросс-тулчейна            (по умолчанию powerpc-linux-gnu-)
+#   QEMU         эмулятор linux-user               (по умолчанию qemu-ppc)
+#   QEMU_CPU     модель CPU для -cpu               (по умолчанию не задаётся)
+#   INSN_PLUGIN  путь к libinsn.so из qemu/contrib/plugins; если задан, печатается
+#                число выполненных инструкций старых и новых процедур по размерам
+#
+# crt0.S собирается как есть. _start переименовывается, чтобы не спорить с _start libc,
+# а локальные __crt_copy/__crt_zero делаются глобальными; символы линкер-скрипта
+# подставляются нулями — код _start в тесте не вызывается.
+set -eu
+
+CROSS=${CROSS:-powerpc-linux-gnu-}
+QEMU=${QEMU:-qemu-ppc}
+HERE=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$HERE/../.." && pwd)
+OUT=$(mktemp -d "${TMPDIR:-/tmp}/crt-test.XXXXXX")
+trap 'rm -rf "$OUT"' EXIT
+
+CPU_ARGS=
+if [ -n "${QEMU_CPU:-}" ]; then CPU_ARGS="-cpu $QEMU_CPU"; fi
+
+"${CROSS}gcc" -c "$ROOT/crt/crt0.S" -o "$OUT/crt0.o"
+"${CROSS}objcopy" --redefine-sym _start=__crt_start \
+    --globalize-symbol=__crt_copy --globalize-symbol=__crt_zero "$OUT/crt0.o"
+"${CROSS}gcc" -c "$HERE/crt_old.S" -o "$OUT/crt_old.o"
+
+DEFSYMS=
+for s in _sdata _sdata_end _data_rom _data _data_end _sbss _sbss_end _bss _bss_end STACK_TOP; do
+    DEFSYMS="$DEFSYMS -Wl,--defsym,$s=0"
+done
+# shellcheck disable=SC2086
+"${CROSS}gcc" -O2 -static -o "$OUT/crt_test" "$HERE/crt_test.c" "$OUT/crt0.o" "$OUT/crt_old.o" $DEFSYMS
+
+# shellcheck disable=SC2086
+$QEMU $CPU_ARGS "$OUT/crt_test"
+# shellcheck disable=SC2086
+$QEMU $CPU_ARGS "$OUT/crt_test" ticks
+
+if [ -n "${INSN_PLUGIN:-}" ]; then
+    REPEATS=1000
+    # Пустой прогон даёт постоянную часть (старт libc, разбор аргументов), её вычитаем
+    insns() {
+        # shellcheck disable=SC2086
+        $QEMU $CPU_ARGS -plugin "$INSN_PLUGIN" -d plugin "$OUT/crt_test" run "$1" "$2" "$3" 2>&1 |
+            sed -n 's/^insns: *\([0-9]*\).*/\1/p'
+    }
+    printf '%-6s %8s %14s %14s\n' op size old_insn/call new_insn/call
+    for op in copy zero; do
+        for size in 16 64 256 1024 4096; do
+            base_old=$(insns "${op}_old" "$size" 0)
+            base_new=$(insns "$op" "$size" 0)
+            old=$(( ($(insns "${op}_old" "$size" $REPEATS) - base_old) / REPEATS ))
+            new=$(( ($(insns "$op" "$size" $REPEATS) - base_new) / REPEATS ))
+            printf '%-6s %8s %14s %14s\n' "$op" "$size" "$old" "$new"
+        done
+    done
+fi
@@ -0,0 +1,185 @@
+// tests/log_model_test.cpp
+// Модель лога без окна: кольцевой буфер, Clear, схлопывание уведомлений
+// и нагрузка в 1M строк из нескольких потоков при читающем «представлении».
+//
+// Сборка:
+//   g++ -std=c++20 -O2 -pthread -iquote include -o log_model_test tests/log_model_test.cpp src/log_model.cpp
+// Код возврата 0 — все проверки прошли.
+#include "log_model.h"
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+
+using namespace std::chrono;
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+static void TestRing() {
+    LogModel model(3);
+    std::wstring s;
+    CHECK(model.Size() == 0);
+    CHECK(!model.Line(0, s));
+
+    model.Append(L"a");
+    model.Append(L"b");
+    CHECK(model.Size() == 2);
+    CHECK(model.Line(0, s) && s == L"a");
+    CHECK(model.Line(1, s) && s == L"b");
+
+    // Четвёртая строка вытесняет самую старую, индекс 0 — снова самая старая из хранимых
+    model.Append(L"c");
+    model.Append(L"d");
+    CHECK(model.Size() == 3);
+    CHECK(model.TotalAppended() == 4);
+    CHECK(model.Line(0, s) && s == L"b");
+    CHECK(model.Line(2, s) && s == L"d");
+    CHECK(!model.Line(3, s));
+
+    // Вызов с нулевой ёмкостью не должен давать деление на ноль
+    LogModel tiny(0);
+    tiny.Append(L"x");
+    tiny.Append(L"y");
+    CHECK(tiny.Size() == 1);
+    CHECK(tiny.Line(0, s) && s == L"y");
+}
+
+static void TestClear() {
+    LogModel model(4);
+    for (int i = 0; i < 10; ++i) model.Append(std::to_wstring(i));
+    model.SetProgress(40);
+    uint64_t gen = model.Generation();
+
+    model.Clear();
+    std::wstring s;
+    CHECK(model.Size() == 0);
+    CHECK(model.TotalAppended() == 0);
+    CHECK(model.Progress() == 0);
+    CHECK(!model.Line(0, s));
+    CHECK(model.Generation() > gen);
+
+    model.Append(L"after");
+    CHECK(model.TotalAppended() == 1);
+    CHECK(model.Line(0, s) && s == L"after");
+}
+
+static void TestNotifier() {
+    LogModel model(16);
+    int signals = 0;
+    model.SetNotifier([&signals]() { ++signals; });
+
+    // Без Acknowledge сколько угодно изменений дают один сигнал
+    for (int i = 0; i < 100; ++i) model.Append(L"line");
+    model.SetProgress(10);
+    CHECK(signals == 1);
+
+    model.Acknowledge();
+    model.Append(L"next");
+    CHECK(signals == 2);
+
+    // Тот же процент — не изменение
+    model.Acknowledge();
+    model.SetProgress(10);
+    CHECK(signals == 2);
+    model.SetProgress(250);
+    CHECK(model.Progress() == 100);
+    CHECK(signals == 3);
+}
+
+// 1M строк от четырёх производителей, «представление» подтверждает сигналы и читает хвост,
+// как WM_BUILD_UPDATE в GUI
+static void TestStress() {
+    const int PRODUCERS = 4;
+    const int PER_PRODUCER = 250000;
+    const size_t CAPACITY = 10000;
+    LogModel model(CAPACITY);
+
+    std::atomic<uint64_t> signals(0);
+    std::atomic<bool> pending(false);
+    model.SetNotifier([&]() {
+        signals.fetch_add(1, std::memory_order_relaxed);
+        pending.store(true, std::memory_order_release);
+    });
+
+    std::atomic<bool> producing(true);
+    uint64_t frames = 0;
+    std::thread view([&]() {
+        std::wstring s;
+        while (producing.load(std::memory_order_acquire) || pending.load(std::memory_order_acquire)) {
+            if (!pending.exchange(false, std::memory_order_acq_rel)) {
+                std::this_thread::sleep_for(microseconds(500));
+                continue;
+            }
+            model.Acknowledge();
+            ++frames;
+            size_t size = model.Size();
+            // Видимая часть ListView — несколько десятков последних строк
+            for (size_t i = size > 40 ? size - 40 : 0; i < size; ++i) {
+                model.Line(i, s);
+            }
+        }
+    });
+
+    auto t0 = steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&model, p]() {
+            for (int i = 0; i < PER_PRODUCER; ++i) {
+                model.Append(std::to_wstring(p) + L":" + std::to_wstring(i));
+            }
+        });
+    }
+    for (auto& th : producers) th.join();
+    auto appendMs = duration_cast<milliseconds>(steady_clock::now() - t0).count();
+    producing.store(false, std::memory_order_release);
+    view.join();
+
+    CHECK(model.TotalAppended() == (uint64_t)PRODUCERS * PER_PRODUCER);
+    CHECK(model.Size() == CAPACITY);
+    // Сигналов не больше, чем кадров представления плюс последний неподтверждённый
+    CHECK(signals.load() <= frames + 1);
+    CHECK(signals.load() < (uint64_t)PRODUCERS * PER_PRODUCER / 10);
+
+    // В хранимом хвосте строки каждого производителя идут по возрастанию
+    std::vector<long long> last(PRODUCERS, -1);
+    std::wstring s;
+    for (size_t i = 0; i < model.Size(); ++i) {
+        CHECK(model.Line(i, s));
+        size_t colon = s.find(L':');
+        int p = std::stoi(s.substr(0, colon));
+        long long n = std::stoll(s.substr(colon + 1));
+        CHECK(n > last[p]);
+        last[p] = n;
+    }
+    // Самая новая строка — последняя строка того производителя, что закончил позже всех
+    CHECK(model.Line(model.Size() - 1, s));
+    CHECK(s.substr(s.find(L':') + 1) == std::to_wstring(PER_PRODUCER - 1));
+
+    std::printf("stress: %d lines in %lld ms, %llu signals, %llu frames\n",
+                PRODUCERS * PER_PRODUCER, (long long)appendMs,
+                (unsigned long long)signals.load(), (unsigned long long)frames);
+}
+
+int main() {
+    TestRing();
+    TestClear();
+    TestNotifier();
+    TestStress();
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all log model checks passed\n");
+    return 0;
+}
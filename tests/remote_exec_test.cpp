@@ -0,0 +1,311 @@
+// tests/remote_exec_test.cpp
+// Удалённое исполнение на 127.0.0.1: несколько RemoteWorker и один RemoteExecutor.
+// Проверяются докачка только недостающих входов, кеш действий, проверка выходов по хешу
+// (подставной воркер с испорченным выходом), отмена долгого действия и возврат
+// воркера в ротацию после паузы, если он был недоступен.
+//
+// Сборка (только Linux):
+//   g++ -std=c++20 -O2 -pthread -iquote include -o remote_exec_test tests/remote_exec_test.cpp
+//       src/remote_exec.cpp src/build_cache.cpp src/sha256.cpp src/trace.cpp src/metrics.cpp src/utf8.cpp
+// Код возврата 0 — все проверки прошли.
+#include "remote_exec.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+using namespace std::chrono;
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+static const char* SECRET = "remote-exec-test";
+static fs::path g_dir;
+
+static fs::path WriteFile(const std::string& name, const std::string& content) {
+    fs::path p = g_dir / "src" / name;
+    std::ofstream(p, std::ios::binary) << content;
+    return p;
+}
+
+static std::string ReadFile(const fs::path& p) {
+    std::ifstream in(p, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static std::unique_ptr<RemoteWorker> StartWorker(int index, uint16_t port = 0) {
+    RemoteWorkerConfig cfg;
+    cfg.port = port;
+    cfg.root = (g_dir / ("worker" + std::to_string(index))).wstring();
+    cfg.slots = 2;
+    cfg.secret = SECRET;
+    cfg.tools = { "cp", "cat", "sleep" };
+    auto w = std::make_unique<RemoteWorker>(cfg);
+    if (!w->Start()) return nullptr;
+    return w;
+}
+
+static std::string Address(uint16_t port) {
+    return "127.0.0.1:" + std::to_string(port);
+}
+
+// Подставной воркер: отвечает на hello, «выполняет» действие и отдаёт выход,
+// содержимое которого не совпадает с объявленным хешем
+class TamperingWorker {
+public:
+    TamperingWorker() {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd_, (sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(fd_, (sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+        listen(fd_, 8);
+        thread_ = std::thread([this]() { Serve(); });
+    }
+
+    ~TamperingWorker() {
+        shutdown(fd_, SHUT_RDWR);
+        close(fd_);
+        thread_.join();
+    }
+
+    uint16_t Port() const { return port_; }
+
+private:
+    static bool ReadLine(int fd, std::string& line) {
+        line.clear();
+        char c;
+        while (recv(fd, &c, 1, 0) == 1) {
+            if (c == '\n') return true;
+            line.push_back(c);
+        }
+        return false;
+    }
+
+    static void Send(int fd, const std::string& s) {
+        send(fd, s.data(), s.size(), MSG_NOSIGNAL);
+    }
+
+    void Serve() {
+        while (true) {
+            int c = accept(fd_, nullptr, nullptr);
+            if (c < 0) return;
+            std::string line;
+            Send(c, json({ {"nonce", "1"} }).dump() + "\n");
+            if (ReadLine(c, line)) Send(c, json({ {"slots", 1}, {"running", 0} }).dump() + "\n");
+            if (ReadLine(c, line)) {
+                json req = json::parse(line, nullptr, false);
+                if (req.value("op", std::string()) == "exec") {
+                    Send(c, json({ {"missing", json::array()} }).dump() + "\n");
+                    const std::string body = "tampered";
+                    json done = { {"done", true}, {"exit", 0}, {"cached", false}, {"running", 0},
+                                  {"outputs", json::array({ { {"name", "out.txt"},
+                                      {"hash", std::string(64, '0')}, {"size", body.size()} } })} };
+                    Send(c, done.dump() + "\n" + body);
+                }
+            }
+            close(c);
+        }
+    }
+
+    int fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread thread_;
+};
+
+static RemoteAction CopyAction(const std::vector<std::pair<std::string, fs::path>>& inputs,
+                               const std::string& from, const fs::path& out)
+{
+    RemoteAction a;
+    a.argv = { "cp", from, "out.txt" };
+    for (const auto& [name, path] : inputs) a.inputs.push_back({ name, path.wstring() });
+    a.outputs.push_back({ "out.txt", out.wstring() });
+    return a;
+}
+
+static void TestUploadsAndCache(RemoteExecutor& ex) {
+    const std::string a(64 * 1024, 'a');
+    const std::string b(3000, 'b');
+    fs::path pa = WriteFile("a.txt", a);
+    fs::path pb = WriteFile("b.txt", b);
+
+    // Первое действие: вход у воркера отсутствует и передаётся целиком
+    RemoteResult r1;
+    CHECK(ex.Execute(CopyAction({ { "a.txt", pa } }, "a.txt", g_dir / "out1.txt"), r1));
+    CHECK(r1.ok && r1.exitCode == 0 && !r1.cached);
+    CHECK(r1.uploadedBytes == a.size());
+    CHECK(ReadFile(g_dir / "out1.txt") == a);
+
+    // То же действие: результат из кеша воркера, ничего не передаётся
+    RemoteResult r2;
+    CHECK(ex.Execute(CopyAction({ { "a.txt", pa } }, "a.txt", g_dir / "out2.txt"), r2));
+    CHECK(r2.cached);
+    CHECK(r2.worker == r1.worker);
+    CHECK(r2.uploadedBytes == 0);
+    CHECK(ReadFile(g_dir / "out2.txt") == a);
+
+    // Новое действие с известным и новым входом: передаётся только новый
+    RemoteResult r3;
+    CHECK(ex.Execute(CopyAction({ { "a.txt", pa }, { "b.txt", pb } }, "b.txt", g_dir / "out3.txt"), r3));
+    CHECK(r3.ok && !r3.cached);
+    CHECK(r3.worker == r1.worker);
+    CHECK(r3.uploadedBytes == b.size());
+    CHECK(ReadFile(g_dir / "out3.txt") == b);
+}
+
+static void TestLoadSpread(RemoteExecutor& ex, size_t workers, size_t actions) {
+    // Параллельные долгие действия расходятся по всем воркерам
+    std::vector<std::thread> threads;
+    std::vector<RemoteResult> results(actions);
+    std::atomic<int> ok(0);
+    for (size_t i = 0; i < actions; ++i) {
+        threads.emplace_back([&, i]() {
+            // "0.3", "0.30", ... — одна длительность, но разные ключи: кеш действий не срабатывает
+            RemoteAction act;
+            act.argv = { "sleep", "0.3" + std::string(i, '0') };
+            if (ex.Execute(act, results[i])) ok.fetch_add(1);
+        });
+    }
+    for (auto& t : threads) t.join();
+    CHECK(ok.load() == (int)actions);
+    std::vector<std::string> seen;
+    for (const auto& r : results) {
+        if (std::find(seen.begin(), seen.end(), r.worker) == seen.end()) seen.push_back(r.worker);
+    }
+    CHECK(seen.size() == workers);
+}
+
+static void TestTamperedOutput() {
+    TamperingWorker fake;
+    RemoteExecConfig cfg;
+    cfg.workers = { Address(fake.Port()) };
+    cfg.retries = 0;
+    cfg.secret = SECRET;
+    RemoteExecutor ex(cfg);
+    CHECK(ex.Connect());
+    fs::path pa = WriteFile("t.txt", "tamper me");
+    fs::path out = g_dir / "tampered.txt";
+    RemoteResult r;
+    CHECK(!ex.Execute(CopyAction({ { "t.txt", pa } }, "t.txt", out), r));
+    CHECK(!r.ok);
+    CHECK(!fs::exists(out));
+    fs::path tmp = out;
+    tmp += L".remote-tmp";
+    CHECK(!fs::exists(tmp));
+}
+
+static void TestCancel(RemoteExecutor& ex) {
+    RemoteAction act;
+    act.argv = { "sleep", "10" };
+    std::stop_source source;
+    RemoteResult r;
+    bool ok = true;
+    auto t0 = steady_clock::now();
+    std::thread th([&]() { ok = ex.Execute(act, r, nullptr, source.get_token()); });
+    std::this_thread::sleep_for(milliseconds(200));
+    auto requested = steady_clock::now();
+    source.request_stop();
+    th.join();
+    auto latency = duration_cast<milliseconds>(steady_clock::now() - requested);
+    std::printf("remote: cancel latency %lld ms\n", (long long)latency.count());
+    CHECK(!ok);
+    CHECK(latency < milliseconds(1000));
+    CHECK(steady_clock::now() - t0 < seconds(5));
+    // Отмена не выводит воркер из ротации
+    CHECK(ex.WorkerCount() > 0);
+}
+
+static void TestReprobe() {
+    // Порт воркера, которого пока нет
+    uint16_t port;
+    {
+        auto probe = StartWorker(90);
+        CHECK(probe != nullptr);
+        if (!probe) return;
+        port = probe->Port();
+        probe->Stop();
+    }
+    RemoteExecConfig cfg;
+    cfg.workers = { Address(port) };
+    cfg.retries = 0;
+    cfg.secret = SECRET;
+    RemoteExecutor ex(cfg);
+    CHECK(!ex.Connect());
+    CHECK(ex.WorkerCount() == 0);
+
+    fs::path pa = WriteFile("r.txt", "reprobe");
+    RemoteResult r;
+    CHECK(!ex.Execute(CopyAction({ { "r.txt", pa } }, "r.txt", g_dir / "r-out.txt"), r));
+
+    // Воркер поднялся: после паузы Execute опрашивает его снова и отправляет действие
+    auto worker = StartWorker(91, port);
+    CHECK(worker != nullptr);
+    if (!worker) return;
+    std::this_thread::sleep_for(milliseconds(700));
+    CHECK(ex.Execute(CopyAction({ { "r.txt", pa } }, "r.txt", g_dir / "r-out.txt"), r));
+    CHECK(ex.WorkerCount() == 1);
+    CHECK(ReadFile(g_dir / "r-out.txt") == "reprobe");
+    worker->Stop();
+}
+
+int main() {
+    g_dir = fs::temp_directory_path() / ("remote_exec_test-" + std::to_string(::getpid()));
+    fs::remove_all(g_dir);
+    fs::create_directories(g_dir / "src");
+
+    const int WORKERS = 3;
+    std::vector<std::unique_ptr<RemoteWorker>> workers;
+    RemoteExecConfig cfg;
+    cfg.secret = SECRET;
+    for (int i = 0; i < WORKERS; ++i) {
+        workers.push_back(StartWorker(i));
+        CHECK(workers.back() != nullptr);
+        if (!workers.back()) return 1;
+        cfg.workers.push_back(Address(workers.back()->Port()));
+    }
+    RemoteExecutor ex(cfg);
+    CHECK(ex.Connect());
+    CHECK(ex.WorkerCount() == WORKERS);
+    CHECK(ex.TotalSlots() == WORKERS * 2);
+
+    TestUploadsAndCache(ex);
+    TestLoadSpread(ex, WORKERS, WORKERS * 2);
+    TestTamperedOutput();
+    TestCancel(ex);
+    TestReprobe();
+
+    for (auto& w : workers) w->Stop();
+    fs::remove_all(g_dir);
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all remote exec checks passed\n");
+    return 0;
+}